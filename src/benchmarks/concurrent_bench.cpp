@@ -0,0 +1,190 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Multi-threaded benchmark for BTreeIndex. For each thread count, builds a fresh index by inserting
+ * keys in random order from every thread at once, then measures point lookups from every thread, then
+ * a mixed phase where half the threads insert a second batch of keys while the other half look up keys
+ * from the first batch, every one of which must be found. The finished index is checked with a full scan.
+ *
+ * Build and run:
+ *   $ make bench
+ *   $ ./src/concurrent_bench [keys]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "btree.h"
+#include "filescan.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+using namespace badgerdb;
+
+static const std::string RELATION = "concurrent_bench_rel";
+
+/**
+ * Big enough to hold the whole index, so the benchmark measures the tree and not the disk.
+ */
+static const std::uint32_t POOL_FRAMES = 16384;
+
+static void removeFile(const std::string &name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (const FileNotFoundException &)
+	{
+	}
+}
+
+static RecordId ridFor(const int key)
+{
+	RecordId rid;
+	rid.page_number = key / 100 + 1;
+	rid.slot_number = key % 100 + 1;
+	return rid;
+}
+
+static double secondsSince(const std::chrono::steady_clock::time_point &start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Runs body(t) on threads t = 0 .. threads - 1 and returns the wall clock time taken.
+ */
+template <class Body>
+static double runThreads(const int threads, Body body)
+{
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; t++)
+		workers.push_back(std::thread(body, t));
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+	return secondsSince(start);
+}
+
+static void report(const char *phase, const size_t ops, const double seconds)
+{
+	std::cout << "  " << std::left << std::setw(8) << phase << std::right << std::setw(10) << std::fixed
+			<< std::setprecision(3) << ops / seconds / 1e6 << " Mops/s" << std::endl;
+}
+
+static bool benchThreads(const int threads, const std::vector<int> &keys)
+{
+	const size_t half = keys.size() / 2;
+	removeFile(RELATION + ".0");
+	BufMgr bufMgr(POOL_FRAMES);
+	std::string indexName;
+	BTreeIndex index(RELATION, indexName, &bufMgr, 0, INTEGER, INSERT_BUILD);
+
+	std::cout << threads << " thread(s)" << std::endl;
+
+	// every thread inserts its share of the first half of the keys
+	double seconds = runThreads(threads, [&](int t) {
+		for (size_t i = t; i < half; i += threads)
+			index.insertEntry(&keys[i], ridFor(keys[i]));
+	});
+	report("insert", half, seconds);
+
+	// every thread looks up its share of the first half
+	std::atomic<size_t> missing(0);
+	seconds = runThreads(threads, [&](int t) {
+		for (size_t i = t; i < half; i += threads)
+			if (!index.containsKey(&keys[i]))
+				missing++;
+	});
+	report("lookup", half, seconds);
+
+	// writers insert the second half while readers keep finding the first half
+	const int writers = std::max(1, threads / 2);
+	const int readers = std::max(1, threads - writers);
+	seconds = runThreads(writers + readers, [&](int t) {
+		if (t < writers)
+		{
+			for (size_t i = half + t; i < keys.size(); i += writers)
+				index.insertEntry(&keys[i], ridFor(keys[i]));
+		}
+		else
+		{
+			for (size_t i = t - writers; i < half; i += readers)
+				if (!index.containsKey(&keys[i]))
+					missing++;
+		}
+	});
+	report("mixed", keys.size(), seconds);
+
+	if (missing != 0)
+	{
+		std::cout << missing << " inserted keys were not found" << std::endl;
+		return false;
+	}
+
+	// the finished tree must hold every key exactly once, in order
+	int low = 0;
+	int high = (int) keys.size();
+	int expect = 0;
+	RecordId rid;
+	index.startScan(&low, GTE, &high, LT);
+	try
+	{
+		while (true)
+		{
+			index.scanNext(rid);
+			if (rid.page_number != ridFor(expect).page_number || rid.slot_number != ridFor(expect).slot_number)
+				break;
+			expect++;
+		}
+	}
+	catch (const IndexScanCompletedException &)
+	{
+	}
+	index.endScan();
+	if (expect != (int) keys.size())
+	{
+		std::cout << "scan found " << expect << " of " << keys.size() << " entries in order" << std::endl;
+		return false;
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const int count = argc > 1 ? atoi(argv[1]) : 1000000;
+	const int cores = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << cores << " hardware thread(s), " << count << " keys" << std::endl << std::endl;
+
+	std::vector<int> keys(count);
+	for (int i = 0; i < count; i++)
+		keys[i] = i;
+	srandom(42);
+	std::random_shuffle(keys.begin(), keys.end(), [](int n) { return (int) (random() % n); });
+
+	// an empty base relation: every entry comes from the benchmark threads
+	removeFile(RELATION);
+	{
+		PageFile relation = PageFile::create(RELATION);
+	}
+
+	bool ok = true;
+	for (int threads = 1; ok && threads <= std::max(4, cores); threads *= 2)
+		ok = benchThreads(threads, keys);
+
+	removeFile(RELATION);
+	removeFile(RELATION + ".0");
+	return ok ? 0 : 1;
+}
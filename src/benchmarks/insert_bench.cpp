@@ -0,0 +1,162 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Insert benchmark for BTreeIndex. Builds a fresh index from one thread for each key order: increasing keys,
+ * clustered keys (runs of consecutive keys, the runs in random order) and random keys, once with one insertEntry()
+ * call per key and once with insertEntries() batches, and checks with a full scan that every key came back in order.
+ *
+ * Build and run:
+ *   $ make bench
+ *   $ ./src/insert_bench [keys]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include "btree.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+using namespace badgerdb;
+
+static const std::string RELATION = "insert_bench_rel";
+
+/**
+ * Big enough to hold the whole index, so the benchmark measures the tree and not the disk.
+ */
+static const std::uint32_t POOL_FRAMES = 16384;
+
+/**
+ * Number of consecutive keys in each run of the clustered order.
+ */
+static const int RUN_LENGTH = 1000;
+
+/**
+ * Entries passed to each insertEntries() call.
+ */
+static const size_t BATCH_SIZE = 100000;
+
+static void removeFile(const std::string &name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (const FileNotFoundException &)
+	{
+	}
+}
+
+/**
+ * Scans the whole index in batches and returns the number of entries, or -1 if a key is out of order.
+ */
+static long scanInOrder(BTreeIndex &index, const int count)
+{
+	const size_t batchSize = 4096;
+	std::vector<RecordId> rids(batchSize);
+	std::vector<int> keys(batchSize);
+	const int low = 0;
+	long entries = 0;
+	int last = low;
+	size_t got;
+	index.startScan(&low, GTE, &count, LT);
+	do
+	{
+		got = index.scanNextBatch(&rids[0], &keys[0], batchSize);
+		for (size_t i = 0; i < got; i++)
+		{
+			if (keys[i] < last)
+				entries = -1;
+			last = keys[i];
+		}
+		if (entries >= 0)
+			entries += got;
+	} while (got == batchSize);
+	index.endScan();
+	return entries;
+}
+
+static bool benchOrder(const char *order, const std::vector<int> &keys, const bool batched)
+{
+	removeFile(RELATION + ".0");
+	BufMgr bufMgr(POOL_FRAMES);
+	std::string indexName;
+	BTreeIndex index(RELATION, indexName, &bufMgr, 0, INTEGER, INSERT_BUILD);
+
+	std::vector<RecordId> rids(keys.size());
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		rids[i].page_number = keys[i] / 100 + 1;
+		rids[i].slot_number = keys[i] % 100 + 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (batched)
+	{
+		for (size_t i = 0; i < keys.size(); i += BATCH_SIZE)
+			index.insertEntries(&keys[i], &rids[i], std::min(BATCH_SIZE, keys.size() - i));
+	}
+	else
+	{
+		for (size_t i = 0; i < keys.size(); i++)
+			index.insertEntry(&keys[i], rids[i]);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	IndexStatistics stats = index.getStatistics();
+	std::string method = std::string(order) + (batched ? " batch" : "");
+	std::cout << "  " << std::left << std::setw(18) << method << std::right << std::setw(10) << std::fixed
+			<< std::setprecision(3) << keys.size() / seconds / 1e6 << " Minserts/s   leaf fill "
+			<< std::setprecision(2) << stats.leafFillFactor << std::endl;
+
+	long scanned = scanInOrder(index, (int) keys.size());
+	if (scanned != (long) keys.size())
+	{
+		std::cout << "scan found " << scanned << " of " << keys.size() << " entries in order" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const int count = argc > 1 ? atoi(argv[1]) : 1000000;
+	std::cout << count << " keys" << std::endl;
+
+	// an empty base relation: every entry is inserted by the benchmark
+	removeFile(RELATION);
+	{
+		PageFile relation = PageFile::create(RELATION);
+	}
+
+	std::vector<int> keys(count);
+	for (int i = 0; i < count; i++)
+		keys[i] = i;
+	bool ok = benchOrder("increasing", keys, false) && benchOrder("increasing", keys, true);
+
+	srandom(42);
+	std::vector<int> runs;
+	for (int i = 0; i < count; i += RUN_LENGTH)
+		runs.push_back(i);
+	std::random_shuffle(runs.begin(), runs.end(), [](int n) { return (int) (random() % n); });
+	keys.clear();
+	for (size_t r = 0; r < runs.size(); r++)
+		for (int i = runs[r]; i < std::min(runs[r] + RUN_LENGTH, count); i++)
+			keys.push_back(i);
+	ok = ok && benchOrder("clustered", keys, false) && benchOrder("clustered", keys, true);
+
+	std::random_shuffle(keys.begin(), keys.end(), [](int n) { return (int) (random() % n); });
+	ok = ok && benchOrder("random", keys, false) && benchOrder("random", keys, true);
+
+	removeFile(RELATION);
+	removeFile(RELATION + ".0");
+	return ok ? 0 : 1;
+}
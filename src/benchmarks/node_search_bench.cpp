@@ -0,0 +1,390 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Microbenchmark for the key search inside a B+Tree node. Compares the two-pass backwards scan the
+ * insert and scan code used to do (find the last occupied slot by its zero page number, then walk the
+ * keys) against every node search kernel the CPU supports, on full and half full leaf and non-leaf
+ * nodes, and the 16-bit delta search of packed leaves. Double keys are searched with every kernel, as normalized
+ * integers, against the binary search over double compares; string keys with the word compares of StringKey against
+ * a binary search calling strncmp. Every kernel is first checked against std::lower_bound and std::upper_bound, and
+ * its decoding of packed leaves against the deltas added up one by one.
+ *
+ * Build and run:
+ *   $ make bench
+ *   $ ./src/node_search_bench
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include "btree.h"
+#include "node_search.h"
+
+using namespace badgerdb;
+
+static const int PROBES = 1 << 16;
+static const int ROUNDS = 40;
+
+/**
+ * The search the leaf code did before the node search layer: walk back from the end of the node past
+ * empty slots, then past every key greater than the probe.
+ */
+static int legacyUpperBound(const int *keys, const PageId *pages, const int occupancy, const int key)
+{
+	int endIdx = occupancy - 1;
+	for (int i = endIdx; i >= 0 && pages[i] == 0; i--)
+	{
+		endIdx--;
+	}
+	for (int i = endIdx; i >= 0 && keys[i] > key; i--)
+	{
+		endIdx--;
+	}
+	return endIdx + 1;
+}
+
+/**
+ * Sorted keys with runs of duplicates, the first `fill` of `occupancy` slots occupied.
+ */
+static void makeNode(const int occupancy, const int fill, std::vector<int> &keys, std::vector<PageId> &pages)
+{
+	keys.assign(occupancy, 0);
+	pages.assign(occupancy, 0);
+	int key = -(fill * 2);
+	for (int i = 0; i < fill; i++)
+	{
+		key += random() % 4;
+		keys[i] = key;
+		pages[i] = i + 1;
+	}
+}
+
+static bool verify(const std::vector<int> &keys, const int fill, const std::vector<int> &probes)
+{
+	for (int k = SEARCH_LINEAR; k <= SEARCH_AVX2; k++)
+	{
+		SearchKernel kernel = (SearchKernel) k;
+		if (!searchKernelSupported(kernel))
+			continue;
+		for (size_t i = 0; i < probes.size(); i++)
+		{
+			int expectLower = std::lower_bound(keys.begin(), keys.begin() + fill, probes[i]) - keys.begin();
+			int expectUpper = std::upper_bound(keys.begin(), keys.begin() + fill, probes[i]) - keys.begin();
+			if (lowerBoundInt(&keys[0], fill, probes[i], kernel) != expectLower ||
+					upperBoundInt(&keys[0], fill, probes[i], kernel) != expectUpper)
+			{
+				std::cout << searchKernelName(kernel) << " returned a wrong position for key " << probes[i] << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Key deltas of a full packed leaf with runs of duplicates, page deltas and slots, and probes around its keys.
+ */
+static void makePackedLeaf(std::vector<std::uint16_t> &deltas, std::vector<std::uint16_t> &pageDeltas,
+		std::vector<std::uint16_t> &slots, std::vector<std::uint16_t> &probes)
+{
+	deltas.resize(PACKED_LEAF_SIZE);
+	pageDeltas.resize(PACKED_LEAF_SIZE);
+	slots.resize(PACKED_LEAF_SIZE);
+	int delta = 0;
+	for (int i = 0; i < PACKED_LEAF_SIZE; i++)
+	{
+		delta += random() % 4;
+		deltas[i] = (std::uint16_t) delta;
+		pageDeltas[i] = (std::uint16_t) (random() % 0x10000);
+		slots[i] = (std::uint16_t) (random() % 0x10000);
+	}
+	deltas.back() = 0xffff;
+	probes.resize(PROBES);
+	for (int i = 0; i < PROBES; i++)
+	{
+		probes[i] = (std::uint16_t) (deltas[random() % PACKED_LEAF_SIZE] + (int) (random() % 3) - 1);
+	}
+}
+
+static bool verifyPacked(const std::vector<std::uint16_t> &deltas, const std::vector<std::uint16_t> &pageDeltas,
+		const std::vector<std::uint16_t> &slots, const std::vector<std::uint16_t> &probes)
+{
+	const int base = -1000;
+	const PageId pageBase = 70000;
+	std::vector<int> keys(PACKED_LEAF_SIZE);
+	std::vector<RecordId> rids(PACKED_LEAF_SIZE);
+	for (int k = SEARCH_LINEAR; k <= SEARCH_AVX2; k++)
+	{
+		SearchKernel kernel = (SearchKernel) k;
+		if (!searchKernelSupported(kernel))
+			continue;
+		for (size_t i = 0; i < probes.size(); i++)
+		{
+			int expectLower = std::lower_bound(deltas.begin(), deltas.end(), probes[i]) - deltas.begin();
+			int expectUpper = std::upper_bound(deltas.begin(), deltas.end(), probes[i]) - deltas.begin();
+			if (lowerBoundU16(&deltas[0], PACKED_LEAF_SIZE, probes[i], kernel) != expectLower ||
+					upperBoundU16(&deltas[0], PACKED_LEAF_SIZE, probes[i], kernel) != expectUpper)
+			{
+				std::cout << searchKernelName(kernel) << " returned a wrong position for delta " << probes[i] << std::endl;
+				return false;
+			}
+		}
+		// odd lengths and offsets leave a tail for the scalar code after the vector loop
+		for (int from = 0; from < 3; from++)
+		{
+			int count = PACKED_LEAF_SIZE - from - 2;
+			decodeDeltas(&deltas[from], count, base, &keys[0], kernel);
+			decodeRids(&pageDeltas[from], &slots[from], count, pageBase, &rids[0], kernel);
+			for (int i = 0; i < count; i++)
+			{
+				if (keys[i] != base + deltas[from + i] || rids[i].page_number != pageBase + pageDeltas[from + i]
+						|| rids[i].slot_number != slots[from + i] || rids[i].padding != 0)
+				{
+					std::cout << searchKernelName(kernel) << " decoded entry " << from + i << " wrongly" << std::endl;
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Sorted doubles of both signs with runs of duplicates, and probes on and between them, some beyond both ends.
+ */
+static void makeDoubleNode(const int fill, std::vector<double> &keys, std::vector<double> &probes)
+{
+	keys.resize(fill);
+	double key = -(fill * 1.5);
+	for (int i = 0; i < fill; i++)
+	{
+		key += (random() % 4) * 0.75;
+		keys[i] = key;
+	}
+	probes.resize(PROBES);
+	for (int i = 0; i < PROBES; i++)
+	{
+		probes[i] = keys[random() % fill] + ((int) (random() % 3) - 1) * 0.25 * (random() % 8);
+	}
+	probes[0] = -1e300;
+	probes[1] = 1e300;
+}
+
+static bool verifyDouble(const std::vector<double> &keys, const std::vector<double> &probes)
+{
+	const int fill = keys.size();
+	for (int k = SEARCH_LINEAR; k <= SEARCH_AVX2; k++)
+	{
+		SearchKernel kernel = (SearchKernel) k;
+		if (!searchKernelSupported(kernel))
+			continue;
+		// every length, for the tail after the vector loop
+		for (int count = 0; count <= fill; count += (count < 16 ? 1 : 37))
+		{
+			for (size_t i = 0; i < probes.size(); i += (count == fill ? 1 : 97))
+			{
+				int expectLower = std::lower_bound(keys.begin(), keys.begin() + count, probes[i]) - keys.begin();
+				int expectUpper = std::upper_bound(keys.begin(), keys.begin() + count, probes[i]) - keys.begin();
+				if (lowerBoundDouble(&keys[0], count, probes[i], kernel) != expectLower ||
+						upperBoundDouble(&keys[0], count, probes[i], kernel) != expectUpper)
+				{
+					std::cout << searchKernelName(kernel) << " returned a wrong position for double " << probes[i]
+							<< std::endl;
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * The search of string keys before they were compared a word at a time.
+ */
+static bool strncmpLess(const StringKey &a, const StringKey &b)
+{
+	return strncmp(a.data, b.data, STRINGSIZE) < 0;
+}
+
+/**
+ * Full non-leaf of sorted string keys sharing prefixes, as the keys of RECORD.s do, and probes on and between them.
+ */
+static void makeStringNode(std::vector<StringKey> &keys, std::vector<StringKey> &probes)
+{
+	keys.resize(STRINGARRAYNONLEAFSIZE);
+	char s[64];
+	for (int i = 0; i < STRINGARRAYNONLEAFSIZE; i++)
+	{
+		sprintf(s, "%05d string record", 20000 + i * 3);
+		keys[i].set(s);
+	}
+	probes.resize(PROBES);
+	for (int i = 0; i < PROBES; i++)
+	{
+		sprintf(s, "%05d string record", 20000 + (int) (random() % (STRINGARRAYNONLEAFSIZE * 3)));
+		probes[i].set(s);
+	}
+}
+
+static void report(const char *name, const std::chrono::steady_clock::time_point &start, long checksum)
+{
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "  " << std::left << std::setw(8) << name << std::right << std::setw(10) << std::fixed
+			<< std::setprecision(2) << ns / ((double) PROBES * ROUNDS) << " ns/search"
+			<< "   (checksum " << checksum << ")" << std::endl;
+}
+
+static bool benchNode(const char *label, const int occupancy, const int fill)
+{
+	std::vector<int> keys;
+	std::vector<PageId> pages;
+	makeNode(occupancy, fill, keys, pages);
+
+	std::vector<int> probes(PROBES);
+	for (int i = 0; i < PROBES; i++)
+	{
+		probes[i] = keys[random() % fill] + (int) (random() % 3) - 1;
+	}
+
+	if (!verify(keys, fill, probes))
+		return false;
+
+	std::cout << label << ": " << fill << " of " << occupancy << " slots used" << std::endl;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	long checksum = 0;
+	for (int r = 0; r < ROUNDS; r++)
+		for (int i = 0; i < PROBES; i++)
+			checksum += legacyUpperBound(&keys[0], &pages[0], occupancy, probes[i]);
+	report("legacy", start, checksum);
+
+	for (int k = SEARCH_LINEAR; k <= SEARCH_AVX2; k++)
+	{
+		SearchKernel kernel = (SearchKernel) k;
+		if (!searchKernelSupported(kernel))
+			continue;
+		start = std::chrono::steady_clock::now();
+		checksum = 0;
+		for (int r = 0; r < ROUNDS; r++)
+			for (int i = 0; i < PROBES; i++)
+				checksum += upperBoundInt(&keys[0], fill, probes[i], kernel);
+		report(searchKernelName(kernel), start, checksum);
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+static bool benchPacked()
+{
+	std::vector<std::uint16_t> deltas;
+	std::vector<std::uint16_t> pageDeltas;
+	std::vector<std::uint16_t> slots;
+	std::vector<std::uint16_t> probes;
+	makePackedLeaf(deltas, pageDeltas, slots, probes);
+	if (!verifyPacked(deltas, pageDeltas, slots, probes))
+		return false;
+
+	std::cout << "Packed leaf, full: " << PACKED_LEAF_SIZE << " 16-bit deltas" << std::endl;
+	for (int k = SEARCH_LINEAR; k <= SEARCH_AVX2; k++)
+	{
+		SearchKernel kernel = (SearchKernel) k;
+		if (!searchKernelSupported(kernel))
+			continue;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		long checksum = 0;
+		for (int r = 0; r < ROUNDS; r++)
+			for (int i = 0; i < PROBES; i++)
+				checksum += upperBoundU16(&deltas[0], PACKED_LEAF_SIZE, probes[i], kernel);
+		report(searchKernelName(kernel), start, checksum);
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+static bool benchDouble()
+{
+	std::vector<double> keys;
+	std::vector<double> probes;
+	makeDoubleNode(DOUBLEARRAYNONLEAFSIZE, keys, probes);
+	if (!verifyDouble(keys, probes))
+		return false;
+
+	std::cout << "Non-leaf of doubles, full: " << DOUBLEARRAYNONLEAFSIZE << " keys" << std::endl;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	long checksum = 0;
+	for (int r = 0; r < ROUNDS; r++)
+		for (int i = 0; i < PROBES; i++)
+			checksum += upperBound<double>(&keys[0], DOUBLEARRAYNONLEAFSIZE, probes[i]);
+	report("double", start, checksum);
+
+	for (int k = SEARCH_LINEAR; k <= SEARCH_AVX2; k++)
+	{
+		SearchKernel kernel = (SearchKernel) k;
+		if (!searchKernelSupported(kernel))
+			continue;
+		start = std::chrono::steady_clock::now();
+		checksum = 0;
+		for (int r = 0; r < ROUNDS; r++)
+			for (int i = 0; i < PROBES; i++)
+				checksum += upperBoundDouble(&keys[0], DOUBLEARRAYNONLEAFSIZE, probes[i], kernel);
+		report(searchKernelName(kernel), start, checksum);
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+static bool benchString()
+{
+	std::vector<StringKey> keys;
+	std::vector<StringKey> probes;
+	makeStringNode(keys, probes);
+	for (int i = 0; i < PROBES; i++)
+	{
+		if (lowerBound(&keys[0], STRINGARRAYNONLEAFSIZE, probes[i])
+				!= std::lower_bound(keys.begin(), keys.end(), probes[i], strncmpLess) - keys.begin())
+		{
+			std::cout << "string search returned a wrong position for " << probes[i].data << std::endl;
+			return false;
+		}
+	}
+
+	std::cout << "Non-leaf of strings, full: " << STRINGARRAYNONLEAFSIZE << " keys" << std::endl;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	long checksum = 0;
+	for (int r = 0; r < ROUNDS; r++)
+		for (int i = 0; i < PROBES; i++)
+			checksum += std::upper_bound(keys.begin(), keys.end(), probes[i], strncmpLess) - keys.begin();
+	report("strncmp", start, checksum);
+
+	start = std::chrono::steady_clock::now();
+	checksum = 0;
+	for (int r = 0; r < ROUNDS; r++)
+		for (int i = 0; i < PROBES; i++)
+			checksum += upperBound(&keys[0], STRINGARRAYNONLEAFSIZE, probes[i]);
+	report("words", start, checksum);
+	std::cout << std::endl;
+	return true;
+}
+
+int main()
+{
+	std::cout << "Active node search kernel: " << searchKernelName(activeSearchKernel()) << std::endl << std::endl;
+
+	bool ok = benchNode("Leaf, full", INTARRAYLEAFSIZE, INTARRAYLEAFSIZE)
+			&& benchNode("Leaf, half full", INTARRAYLEAFSIZE, INTARRAYLEAFSIZE / 2)
+			&& benchNode("Non-leaf, full", INTARRAYNONLEAFSIZE, INTARRAYNONLEAFSIZE)
+			&& benchNode("Non-leaf, 8 keys", INTARRAYNONLEAFSIZE, 8)
+			&& benchPacked()
+			&& benchDouble()
+			&& benchString();
+
+	return ok ? 0 : 1;
+}
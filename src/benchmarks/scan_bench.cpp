@@ -0,0 +1,253 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/*
+ * Range scan benchmark for BTreeIndex. Builds an index of consecutive integer keys, then scans
+ * the whole range with one scanNext() call per entry and with scanNextBatch() at a few batch sizes, in
+ * ascending order and at the largest batch size in descending order, and with parallelScan() on a few thread
+ * counts, checking every method returns the same number of entries. Last, the index is built again from keys in
+ * random order, so its leaves are not in file order and the operating system's own readahead does not find them; the
+ * file is dropped from the operating system's cache and scanned cold through a small pool, once with readahead and
+ * once as a multi-range scan of the one range, which does not read ahead.
+ *
+ * Build and run:
+ *   $ make bench
+ *   $ ./src/scan_bench [keys]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include "btree.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+using namespace badgerdb;
+
+static const std::string RELATION = "scan_bench_rel";
+
+/**
+ * Big enough to hold the whole index, so the benchmark measures the scan and not the disk.
+ */
+static const std::uint32_t POOL_FRAMES = 16384;
+
+static const int ROUNDS = 5;
+
+/**
+ * Small enough that a cold scan reads every leaf from the file.
+ */
+static const std::uint32_t COLD_POOL_FRAMES = 64;
+
+static void removeFile(const std::string &name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch (const FileNotFoundException &)
+	{
+	}
+}
+
+/**
+ * Writes back what the operating system holds of the file and drops it from its cache.
+ */
+static void dropFromCache(const std::string &name)
+{
+	int fd = open(name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+static void report(const char *method, const size_t entries, const std::chrono::steady_clock::time_point &start,
+		long checksum)
+{
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "  " << std::left << std::setw(16) << method << std::right << std::setw(10) << std::fixed
+			<< std::setprecision(2) << entries * (double) ROUNDS / seconds / 1e6 << " M entries/s"
+			<< "   (checksum " << checksum << ")" << std::endl;
+}
+
+static size_t scanOneByOne(BTreeIndex &index, const int low, const int high, long &checksum)
+{
+	RecordId rid;
+	size_t entries = 0;
+	index.startScan(&low, GTE, &high, LT);
+	try
+	{
+		while (true)
+		{
+			index.scanNext(rid);
+			checksum += rid.slot_number;
+			entries++;
+		}
+	}
+	catch (const IndexScanCompletedException &)
+	{
+	}
+	index.endScan();
+	return entries;
+}
+
+static size_t scanBatched(BTreeIndex &index, const int low, const int high, const size_t batchSize, bool withKeys,
+		long &checksum, const ScanOrder order = ASCENDING)
+{
+	std::vector<RecordId> rids(batchSize);
+	std::vector<int> keys(batchSize);
+	size_t entries = 0;
+	size_t count;
+	index.startScan(&low, GTE, &high, LT, order);
+	do
+	{
+		count = index.scanNextBatch(&rids[0], withKeys ? &keys[0] : NULL, batchSize);
+		for (size_t i = 0; i < count; i++)
+			checksum += rids[i].slot_number;
+		entries += count;
+	} while (count == batchSize);
+	index.endScan();
+	return entries;
+}
+
+int main(int argc, char **argv)
+{
+	const int count = argc > 1 ? atoi(argv[1]) : 1000000;
+
+	// an empty base relation: every entry is inserted by the benchmark
+	removeFile(RELATION);
+	removeFile(RELATION + ".0");
+	{
+		PageFile relation = PageFile::create(RELATION);
+	}
+
+	bool ok = true;
+	std::string indexName;
+	{
+		BufMgr bufMgr(POOL_FRAMES);
+		BTreeIndex index(RELATION, indexName, &bufMgr, 0, INTEGER, INSERT_BUILD);
+		for (int key = 0; key < count; key++)
+		{
+			RecordId rid;
+			rid.page_number = key / 100 + 1;
+			rid.slot_number = key % 100 + 1;
+			index.insertEntry(&key, rid);
+		}
+
+		std::cout << "Full scan of " << count << " entries" << std::endl;
+		const int low = 0;
+		const int high = count;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		long checksum = 0;
+		for (int r = 0; r < ROUNDS; r++)
+			ok = ok && scanOneByOne(index, low, high, checksum) == (size_t) count;
+		report("scanNext", count, start, checksum);
+
+		const size_t batchSizes[] = { 16, 256, 4096 };
+		for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++)
+		{
+			for (int withKeys = 0; withKeys <= 1; withKeys++)
+			{
+				start = std::chrono::steady_clock::now();
+				checksum = 0;
+				for (int r = 0; r < ROUNDS; r++)
+					ok = ok && scanBatched(index, low, high, batchSizes[b], withKeys, checksum) == (size_t) count;
+				std::ostringstream method;
+				method << "batch " << batchSizes[b] << (withKeys ? "+keys" : "");
+				report(method.str().c_str(), count, start, checksum);
+			}
+		}
+
+		start = std::chrono::steady_clock::now();
+		checksum = 0;
+		for (int r = 0; r < ROUNDS; r++)
+			ok = ok && scanBatched(index, low, high, 4096, true, checksum, DESCENDING) == (size_t) count;
+		report("desc 4096+keys", count, start, checksum);
+
+		const unsigned threadCounts[] = { 1, 2, 4, 8 };
+		for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++)
+		{
+			start = std::chrono::steady_clock::now();
+			checksum = 0;
+			for (int r = 0; r < ROUNDS; r++)
+			{
+				std::vector<RecordId> rids;
+				ok = ok && index.parallelScan(&low, GTE, &high, LT, rids, threadCounts[t]) == (size_t) count;
+				for (size_t i = 0; i < rids.size(); i++)
+					checksum += rids[i].slot_number;
+			}
+			std::ostringstream method;
+			method << "parallel " << threadCounts[t];
+			report(method.str().c_str(), count, start, checksum);
+		}
+	}
+
+	removeFile(indexName);
+	{
+		std::vector<int> shuffled(count);
+		for (int key = 0; key < count; key++)
+			shuffled[key] = key;
+		srandom(42);
+		std::random_shuffle(shuffled.begin(), shuffled.end(), [](int n) { return (int) (random() % n); });
+		BufMgr bufMgr(POOL_FRAMES);
+		BTreeIndex index(RELATION, indexName, &bufMgr, 0, INTEGER, INSERT_BUILD);
+		for (int i = 0; i < count; i++)
+		{
+			RecordId rid;
+			rid.page_number = shuffled[i] / 100 + 1;
+			rid.slot_number = shuffled[i] % 100 + 1;
+			index.insertEntry(&shuffled[i], rid);
+		}
+	}
+
+	std::cout << "Cold scan of " << count << " entries, batch 256+keys, " << COLD_POOL_FRAMES << " frames" << std::endl;
+	for (int readahead = 1; readahead >= 0; readahead--)
+	{
+		BufMgr bufMgr(COLD_POOL_FRAMES);
+		BTreeIndex index(RELATION, indexName, &bufMgr, 0, INTEGER, INSERT_BUILD);
+		const int low = 0;
+		const int high = count;
+		std::vector<RecordId> rids(256);
+		std::vector<int> keys(256);
+		long checksum = 0;
+		size_t entries = 0;
+		dropFromCache(indexName);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (readahead)
+			index.startScan(&low, GTE, &high, LT);
+		else
+			index.startMultiScan(&low, GTE, &high, LT, 1);
+		size_t got;
+		do
+		{
+			got = index.scanNextBatch(&rids[0], &keys[0], rids.size());
+			for (size_t i = 0; i < got; i++)
+				checksum += rids[i].slot_number;
+			entries += got;
+		} while (got == rids.size());
+		index.endScan();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		ok = ok && entries == (size_t) count;
+		std::cout << "  " << std::left << std::setw(16) << (readahead ? "readahead" : "no readahead") << std::right
+				<< std::setw(10) << std::fixed << std::setprecision(2) << entries / seconds / 1e6 << " M entries/s"
+				<< "   (checksum " << checksum << ")" << std::endl;
+	}
+
+	removeFile(RELATION);
+	removeFile(RELATION + ".0");
+	if (!ok)
+		std::cout << "a scan returned the wrong number of entries" << std::endl;
+	return ok ? 0 : 1;
+}
@@ -7,11 +7,19 @@
 
 #include <stdio.h>
 #include "btree.h"
+#include "node_search.h"
+#include "optimistic_latch.h"
 #include "filescan.h"
 #include "types.h"
 #include <climits>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <exception>
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
@@ -25,437 +33,3949 @@
 namespace badgerdb
 {
 
+/// storage for the node sizes, which std::min and std::max take by reference
+const int KeyTraits<int>::LEAF_SIZE;
+const int KeyTraits<int>::NONLEAF_SIZE;
+const int KeyTraits<double>::LEAF_SIZE;
+const int KeyTraits<double>::NONLEAF_SIZE;
+const int KeyTraits<StringKey>::LEAF_SIZE;
+const int KeyTraits<StringKey>::NONLEAF_SIZE;
+const int KeyTraits<CompositeKey>::LEAF_SIZE;
+const int KeyTraits<CompositeKey>::NONLEAF_SIZE;
+
+template <> LeafFinger<int> &BTreeIndex::finger<int>() { return fingerInt; }
+template <> LeafFinger<double> &BTreeIndex::finger<double>() { return fingerDouble; }
+template <> LeafFinger<StringKey> &BTreeIndex::finger<StringKey>() { return fingerString; }
+template <> LeafFinger<CompositeKey> &BTreeIndex::finger<CompositeKey>() { return fingerComposite; }
+
 // -----------------------------------------------------------------------------
-// BTreeIndex::BTreeIndex -- Constructor
+// Node initialization
 // -----------------------------------------------------------------------------
 
-BTreeIndex::BTreeIndex(const std::string & relationName,
-		std::string & outIndexName,
-		BufMgr *bufMgrIn,
-		const int attrByteOffset,
-		const Datatype attrType)
+/**
+ * Version a node gets when a page is made into a node: higher than any the page had before, unlocked and not
+ * obsolete, so a reader still holding a version of the page from before it was freed cannot validate against it.
+ */
+static std::uint64_t nextLife(const Page *page)
 {
+    return (((const NodeHeader *) page)->version | OptimisticLatch::LOCKED_BIT | OptimisticLatch::OBSOLETE_BIT) + 1;
+}
 
-    this -> rootPageNum = (PageId) -1;
-    this -> initRootPageNo = (PageId) -1;
-    this -> currentPageNum =   (PageId) -1;
+/**
+ * Clears a freshly allocated page and makes it an empty leaf.
+ */
+template <class T>
+static LeafNode<T> *initLeaf(Page *page)
+{
+    std::uint64_t version = nextLife(page);
+    memset((void *) page, 0, Page::SIZE);
+    LeafNode<T> *leaf = (LeafNode<T> *) page;
+    leaf->header.version = version;
+    leaf->header.nodeType = LEAF_NODE;
+    leaf->header.level = 0;
+    leaf->header.keyCount = 0;
+    return leaf;
+}
 
-    /// variables used for scanning
-    this-> scanExecuting = false;
-    this-> highValInt = 0;
-    this-> lowValInt = 0;
-    this-> lowOp = GT;
-    this-> highOp = LT;
+/**
+ * Number of pairs at the start of a sorted run whose key is no greater than high.
+ */
+template <class T>
+static size_t runUpTo(const RIDKeyPair<T> *run, const size_t count, const T &high)
+{
+    size_t low = 0;
+    size_t end = count;
+    while (low < end) {
+        size_t mid = low + (end - low) / 2;
+        if (high < run[mid].key) {
+            end = mid;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
 
-    /// node and leaf occupancy
-    leafOccupancy = INTARRAYLEAFSIZE;
-    nodeOccupancy = INTARRAYNONLEAFSIZE;
+/**
+ * Clears a freshly allocated page and makes it a non-leaf node with no keys at the given level.
+ */
+template <class T>
+static NonLeafNode<T> *initNonLeaf(Page *page, const int level)
+{
+    std::uint64_t version = nextLife(page);
+    memset((void *) page, 0, Page::SIZE);
+    NonLeafNode<T> *node = (NonLeafNode<T> *) page;
+    node->header.version = version;
+    node->header.nodeType = NON_LEAF_NODE;
+    node->header.level = level;
+    node->header.keyCount = 0;
+    return node;
+}
 
-    /// get buffer manager
-    bufMgr = bufMgrIn;
+/**
+ * True if the record id of a leaf entry stands for a posting list.
+ */
+static inline bool isPosting(const RecordId &rid)
+{
+    return rid.slot_number == Page::INVALID_SLOT;
+}
 
-    Page *pageHead;
+/**
+ * Number of entries a leaf entry stands for: the length of its posting list, or 1.
+ */
+static inline std::uint64_t entryWeight(const RecordId &rid)
+{
+    return isPosting(rid) ? rid.padding : 1;
+}
 
-    /// create meta index
-    IndexMetaInfo *index_meta;
+// -----------------------------------------------------------------------------
+// Packed leaves
+// -----------------------------------------------------------------------------
 
-    /// get and output the name of the index from the relationName passed in
-    std::ostringstream index_string;
-    index_string << relationName << '.' << attrByteOffset;
-    outIndexName = index_string.str();
+/**
+ * True if a node page is a leaf, plain or packed.
+ */
+static inline bool isLeaf(const Page *page)
+{
+    std::uint16_t type = ((const NodeHeader *) page)->nodeType;
+    return type == LEAF_NODE || type == PACKED_LEAF_NODE;
+}
 
-    /// try to access file and if it does not exist create a new one
-    try {
-        /// access file and create meta index
-        file = new BlobFile(index_string.str(), false);
+/**
+ * Operations on a packed leaf with keys of type T. Only INTEGER and STRING indexes have packed leaves: for other key
+ * types is() is always false and nothing else is ever called.
+ */
+template <class T>
+struct PackedLeaf
+{
+    static bool is(const Page *page) { return false; }
+    static int capacity(const Page *page) { return 0; }
+    static int capacity(const T *keys, const int n) { return 0; }
+    static T key(const Page *page, const int i) { return T(); }
+    static RecordId rid(const Page *page, const int i) { return RecordId(); }
+    static int lowerBound(const Page *page, const int size, const T &key) { return 0; }
+    static int upperBound(const Page *page, const int size, const T &key) { return 0; }
+    static void copy(const Page *page, const int from, const int n, T *keys, RecordId *rids) { }
+    static bool fits(const Page *page, const RIDKeyPair<T> *run, const size_t count) { return false; }
+    static void merge(Page *page, const RIDKeyPair<T> *run, const size_t count) { }
+    static void remove(Page *page, const int pos) { }
+    static int run(const T *keys, const RecordId *rids, const int n) { return 0; }
+    static void write(Page *page, const T *keys, const RecordId *rids, const int n) { }
+};
 
-        headerPageNum = file->getFirstPageNo();
-        bufMgr->readPage(file, headerPageNum, pageHead);
+/**
+ * The bases of a leaf move down when entries below them are merged in, and are only raised when the leaf is written
+ * again. Readers without a latch may find a leaf half changed: positions are clamped to the leaf by the caller, the
+ * bases are read once per call, and everything read is validated against the leaf's version before it is used.
+ */
+template <>
+struct PackedLeaf<int>
+{
+    static const PackedLeafNode *node(const Page *page) { return (const PackedLeafNode *) page; }
+    static PackedLeafNode *node(Page *page) { return (PackedLeafNode *) page; }
 
-        index_meta = (IndexMetaInfo *) pageHead;
+    static bool is(const Page *page)
+    {
+        return ((const NodeHeader *) page)->nodeType == PACKED_LEAF_NODE;
+    }
 
-        rootPageNum = index_meta->rootPageNo;
-        this -> initRootPageNo = rootPageNum;
+    /// most entries the leaf holds, and a leaf holding the n sorted keys would hold
+    static int capacity(const Page *page) { return PACKED_LEAF_SIZE; }
+    static int capacity(const int *keys, const int n) { return PACKED_LEAF_SIZE; }
 
-        // unpin the page
-        bufMgr->unPinPage(file, headerPageNum, false);
+    static int key(const Page *page, const int i)
+    {
+        return (int) ((unsigned) node(page)->keyBase + node(page)->keyDelta[i]);
+    }
 
+    static RecordId rid(const Page *page, const int i)
+    {
+        RecordId rid;
+        rid.page_number = node(page)->pageBase + node(page)->pageDelta[i];
+        rid.slot_number = node(page)->slotArray[i];
+        rid.padding = 0;
+        return rid;
     }
-    catch(FileNotFoundException err) { /// catch exception if file not found, make new file
-        /// variables used in function
-        RecordId r_id;
-        std::string r;
-        /// make new file and create a header and root page
-        file = new BlobFile(index_string.str(), true);
-        bufMgr->allocPage(file, headerPageNum, pageHead);
 
-        index_meta = (IndexMetaInfo *) pageHead;
+    /// a key below the base sorts before every entry, and one more than 65535 above it after all of them
+    static int lowerBound(const Page *page, const int size, const int &key)
+    {
+        std::int64_t offset = (std::int64_t) key - node(page)->keyBase;
+        if (offset <= 0) {
+            return 0;
+        }
+        return offset > 0xffff ? size : lowerBoundU16(node(page)->keyDelta, size, (std::uint16_t) offset);
+    }
 
-        Page *pageRoot;
-        bufMgr->allocPage(file, rootPageNum, pageRoot);
+    static int upperBound(const Page *page, const int size, const int &key)
+    {
+        std::int64_t offset = (std::int64_t) key - node(page)->keyBase;
+        if (offset < 0) {
+            return 0;
+        }
+        return offset > 0xffff ? size : upperBoundU16(node(page)->keyDelta, size, (std::uint16_t) offset);
+    }
 
-        this -> initRootPageNo = rootPageNum;
-        /// create leaf node with root info
-        LeafNodeInt *rootNode = (LeafNodeInt *) pageRoot;
-        rootNode->rightSibPageNo = 0;
+    static void copy(const Page *page, const int from, const int n, int *keys, RecordId *rids)
+    {
+        const PackedLeafNode *leaf = node(page);
+        decodeDeltas(leaf->keyDelta + from, n, leaf->keyBase, keys);
+        decodeRids(leaf->pageDelta + from, leaf->slotArray + from, n, leaf->pageBase, rids);
+    }
 
-        index_meta->attrType = attrType; /// fill attribute details from what was passed in
-        index_meta->attrByteOffset = attrByteOffset;
-        strcpy(index_meta->relationName, relationName.c_str());
+    /// true if every pair of the run has a key and page number the bases of the leaf reach as they are
+    static bool inWindow(const PackedLeafNode *leaf, const RIDKeyPair<int> *run, const size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            std::int64_t key = (std::int64_t) run[i].key - leaf->keyBase;
+            std::int64_t page = (std::int64_t) run[i].rid.page_number - leaf->pageBase;
+            if (key < 0 || key > 0xffff || page < 0 || page > 0xffff) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-        index_meta->rootPageNo = rootPageNum;
+    /// lowest and highest key and page number among the first size entries of the leaf and the run
+    static void extents(const PackedLeafNode *leaf, const int size, const RIDKeyPair<int> *run, const size_t count,
+            std::int64_t &keyLow, std::int64_t &keyHigh, std::int64_t &pageLow, std::int64_t &pageHigh)
+    {
+        keyLow = pageLow = INT64_MAX;
+        keyHigh = pageHigh = INT64_MIN;
+        for (size_t i = 0; i < count; i++) {
+            keyLow = std::min(keyLow, (std::int64_t) run[i].key);
+            keyHigh = std::max(keyHigh, (std::int64_t) run[i].key);
+            pageLow = std::min(pageLow, (std::int64_t) run[i].rid.page_number);
+            pageHigh = std::max(pageHigh, (std::int64_t) run[i].rid.page_number);
+        }
+        if (size > 0) {
+            int lowDelta = 0xffff;
+            int highDelta = 0;
+            for (int i = 0; i < size; i++) {
+                lowDelta = std::min(lowDelta, (int) leaf->pageDelta[i]);
+                highDelta = std::max(highDelta, (int) leaf->pageDelta[i]);
+            }
+            keyLow = std::min(keyLow, (std::int64_t) leaf->keyBase + leaf->keyDelta[0]);
+            keyHigh = std::max(keyHigh, (std::int64_t) leaf->keyBase + leaf->keyDelta[size - 1]);
+            pageLow = std::min(pageLow, (std::int64_t) leaf->pageBase + lowDelta);
+            pageHigh = std::max(pageHigh, (std::int64_t) leaf->pageBase + highDelta);
+        }
+    }
 
-        /// instantiate a filescan to insert into new file
-        FileScan scan(relationName, bufMgr);
+    static bool fits(const Page *page, const RIDKeyPair<int> *run, const size_t count)
+    {
+        const PackedLeafNode *leaf = node(page);
+        int size = std::min(std::max((int) leaf->header.keyCount, 0), PACKED_LEAF_SIZE);
+        if ((size_t) size + count > (size_t) PACKED_LEAF_SIZE) {
+            return false;
+        }
+        if (inWindow(leaf, run, count)) {
+            return true;
+        }
+        std::int64_t keyLow, keyHigh, pageLow, pageHigh;
+        extents(leaf, size, run, count, keyLow, keyHigh, pageLow, pageHigh);
+        return keyHigh - keyLow <= 0xffff && pageHigh - pageLow <= 0xffff;
+    }
 
-        /// scan file until reaching EOF
-        try {
-            while (true) {
-                scan.scanNext(r_id);
-                r = scan.getRecord();
-                insertEntry(r.c_str() + attrByteOffset, r_id);
+    /// the bases drop to the lowest key and page number first if the run goes below them, or past their reach
+    static void merge(Page *page, const RIDKeyPair<int> *run, const size_t count)
+    {
+        PackedLeafNode *leaf = node(page);
+        int size = leaf->header.keyCount;
+        if (!inWindow(leaf, run, count)) {
+            std::int64_t keyLow, keyHigh, pageLow, pageHigh;
+            extents(leaf, size, run, count, keyLow, keyHigh, pageLow, pageHigh);
+            int keyShift = (int) (leaf->keyBase - keyLow);
+            int pageShift = (int) (leaf->pageBase - pageLow);
+            for (int i = 0; i < size; i++) {
+                leaf->keyDelta[i] = (std::uint16_t) (leaf->keyDelta[i] + keyShift);
+                leaf->pageDelta[i] = (std::uint16_t) (leaf->pageDelta[i] + pageShift);
             }
+            leaf->keyBase = (std::int32_t) keyLow;
+            leaf->pageBase = (PageId) pageLow;
         }
-        catch (EndOfFileException err) { }
+
+        int i = size - 1;
+        int j = count - 1;
+        for (int w = size + count - 1; j >= 0; w--) {
+            if (i >= 0 && (std::int64_t) run[j].key - leaf->keyBase < leaf->keyDelta[i]) {
+                leaf->keyDelta[w] = leaf->keyDelta[i];
+                leaf->pageDelta[w] = leaf->pageDelta[i];
+                leaf->slotArray[w] = leaf->slotArray[i];
+                i--;
+            }
+            else {
+                leaf->keyDelta[w] = (std::uint16_t) (run[j].key - leaf->keyBase);
+                leaf->pageDelta[w] = (std::uint16_t) (run[j].rid.page_number - leaf->pageBase);
+                leaf->slotArray[w] = run[j].rid.slot_number;
+                j--;
+            }
+        }
+        leaf->header.keyCount = size + count;
     }
-}
 
+    static void remove(Page *page, const int pos)
+    {
+        PackedLeafNode *leaf = node(page);
+        int moved = leaf->header.keyCount - pos - 1;
+        memmove(&leaf->keyDelta[pos], &leaf->keyDelta[pos + 1], moved * sizeof(std::uint16_t));
+        memmove(&leaf->pageDelta[pos], &leaf->pageDelta[pos + 1], moved * sizeof(std::uint16_t));
+        memmove(&leaf->slotArray[pos], &leaf->slotArray[pos + 1], moved * sizeof(std::uint16_t));
+        leaf->header.keyCount--;
+    }
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::~BTreeIndex -- destructor
-// -----------------------------------------------------------------------------
+    /// number of entries at the start of n sorted ones that pack into one leaf
+    static int run(const int *keys, const RecordId *rids, const int n)
+    {
+        int limit = std::min(n, PACKED_LEAF_SIZE);
+        std::int64_t pageLow = limit > 0 ? rids[0].page_number : 0;
+        std::int64_t pageHigh = pageLow;
+        int i = 0;
+        for (; i < limit; i++) {
+            pageLow = std::min(pageLow, (std::int64_t) rids[i].page_number);
+            pageHigh = std::max(pageHigh, (std::int64_t) rids[i].page_number);
+            if (isPosting(rids[i]) || (std::int64_t) keys[i] - keys[0] > 0xffff || pageHigh - pageLow > 0xffff) {
+                break;
+            }
+        }
+        return i;
+    }
 
-badgerdb::BTreeIndex::~BTreeIndex()
-{
-}
+    /// the entries must pack; the bases are the lowest key and page number
+    static void write(Page *page, const int *keys, const RecordId *rids, const int n)
+    {
+        PackedLeafNode *leaf = node(page);
+        PageId pageBase = n > 0 ? rids[0].page_number : 0;
+        for (int i = 1; i < n; i++) {
+            pageBase = std::min(pageBase, rids[i].page_number);
+        }
+        leaf->header.nodeType = PACKED_LEAF_NODE;
+        leaf->header.level = 0;
+        leaf->keyBase = n > 0 ? keys[0] : 0;
+        leaf->pageBase = pageBase;
+        for (int i = 0; i < n; i++) {
+            leaf->keyDelta[i] = (std::uint16_t) ((unsigned) keys[i] - (unsigned) leaf->keyBase);
+            leaf->pageDelta[i] = (std::uint16_t) (rids[i].page_number - pageBase);
+            leaf->slotArray[i] = rids[i].slot_number;
+        }
+        leaf->header.keyCount = n;
+    }
+};
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::insertEntry
-// -----------------------------------------------------------------------------
 /**
- * This method inserts a new entry into the index using the pair <key, rid>
- *
- * @param key :  A pointer to the value (integer) we want to insert.
- * @param rid : The corresponding record id of the tuple in the base relation.
+ * A packed STRING leaf keeps the bytes its keys all start with once. Merging in a key that does not start with all of
+ * them shortens the prefix, which widens every entry, so that the leaf holds fewer; removing entries leaves it as it
+ * is. Readers without a latch clamp the prefix length and every position to what the leaf can hold, so that nothing
+ * they read is outside the page, and validate it against the leaf's version before it is used.
  */
-void BTreeIndex::insertEntry(const void *key, const RecordId rid)
+template <>
+struct PackedLeaf<StringKey>
 {
-    RIDKeyPair<int> newPair;
-    newPair.set(rid, *((int *)key)); // create new key-rid pair and set its values
-    Page* root; // root of our tree
-    bufMgr->readPage(this->file, this->rootPageNum, root);
-    PageKeyPair<int> *newChild = NULL;
-    // call insert helper method
-    if (*((int *)key) < 700){
+    static const PackedStringLeafNode *node(const Page *page) { return (const PackedStringLeafNode *) page; }
+    static PackedStringLeafNode *node(Page *page) { return (PackedStringLeafNode *) page; }
+
+    static bool is(const Page *page)
+    {
+        return ((const NodeHeader *) page)->nodeType == PACKED_LEAF_NODE;
     }
-    if (this->rootPageNum == initRootPageNo){
-        insertHelper(root, this->rootPageNum, newPair, newChild, true);
-    } else {
-        insertHelper(root, this->rootPageNum, newPair, newChild, false);
+
+    static int prefixLength(const PackedStringLeafNode *leaf)
+    {
+        return std::min((int) leaf->prefixLength, STRINGSIZE);
     }
 
-}
+    /// bytes an entry takes, and most entries a leaf holds, with a prefix of length p
+    static int stride(const int p) { return STRINGSIZE - p + (int) sizeof(RecordId); }
+    static int capacityFor(const int p) { return std::min(PACKED_STRING_LEAF_BYTES / stride(p), PACKED_STRING_LEAF_SIZE); }
 
-/**
- *  This is the main helper function for the insertEntry function above. We created this function because we want to be able to make
- *  recursive calls if necessary and make those calls easily manageable.
- *
- * @param currPage : the current page we're dealing with
- * @param currPageNo : the page number of the page in question
- * @param newPair : the RIDKeyPair corresponding to the new child we're inserting
- * @param newChild : the PageKeyPair corresponding to the new child we're inserting
- * @param isLeaf : boolean that specifies if we're inserting at a leaf or not
- */
-void BTreeIndex::insertHelper(Page *currPage, PageId currPageNo, const RIDKeyPair<int> newPair, PageKeyPair<int> *&newChild, bool isLeaf)
-{
-    NonLeafNodeInt *currNode = (NonLeafNodeInt *)currPage;
-    Page *nextPage;
-    PageId nextNodeNo;
-    // case when we're about to insert at a leaf
-    if (isLeaf) {
-      LeafNodeInt *leaf = (LeafNodeInt *)currPage;
-      // if we have space at a certain existing leaf to insert the child, we do it straight away
-      if (leaf->ridArray[this->leafOccupancy - 1].page_number == 0) {
-        insertLeaf(leaf, newPair);
-        bufMgr->unPinPage(this->file, currPageNo, true);
-        newChild = NULL;
-      } // otherwise, we create a new leaf before inserting the new child
-      else {
-          // step 1: create a new page and allocate it to buffer
-          PageId newPageNum;
-          Page *newPage;
-          bufMgr->allocPage(this->file, newPageNum, newPage);
-          LeafNodeInt *newLeafNode = (LeafNodeInt *)newPage;
+    static int capacity(const Page *page) { return capacityFor(prefixLength(node(page))); }
 
-          // step 2: find the point at which any shifts will be necessary. We start at the midpoint.
-          int midpoint = this->leafOccupancy / 2;
-          if (this->leafOccupancy % 2 == 1 && newPair.key > leaf->keyArray[midpoint]) {
-              midpoint++;
-          }
-          // step 3: we transfer half of the existing key and RID entries into newLeafNode by
-          // copying them and then setting the original entries in the respective arrays to zero
-          for(int i = midpoint; i < this->leafOccupancy; i++) {
-            newLeafNode->keyArray[i-midpoint] = leaf->keyArray[i];
-            newLeafNode->ridArray[i-midpoint] = leaf->ridArray[i];
-            leaf->keyArray[i] = 0;
-            leaf->ridArray[i].page_number = 0;
-          }
+    static int capacity(const StringKey *keys, const int n)
+    {
+        return capacityFor(n > 0 ? commonPrefix(keys[0].data, keys[n - 1].data, STRINGSIZE) : STRINGSIZE);
+    }
 
-          // step 4: perform actual inserting. If we have to insert beyond the midpoint..
-          if (newPair.key > leaf->keyArray[midpoint - 1]) {
-              // pass newLeafNode
-            insertLeaf(newLeafNode, newPair);
-          }
-          else {
-              // otherwise, pass leaf
-            insertLeaf(leaf, newPair);
-          }
+    /// number of the first limit bytes of a and b that are the same
+    static int commonPrefix(const char *a, const char *b, const int limit)
+    {
+        int p = 0;
+        while (p < limit && a[p] == b[p]) {
+            p++;
+        }
+        return p;
+    }
 
-          // step 5: make necessary changes to sibling pointer upon insertion of new child
-          newLeafNode->rightSibPageNo = leaf->rightSibPageNo;
-          leaf->rightSibPageNo = newPageNum;
+    /// entry i of a leaf with a prefix of length p, clamped to the entries it can hold
+    static const unsigned char *entry(const PackedStringLeafNode *leaf, const int p, const int i)
+    {
+        return leaf->data + std::min(i, capacityFor(p) - 1) * stride(p);
+    }
 
-          // step 6: specify new child entry
-          newChild = new PageKeyPair<int>();
-          PageKeyPair<int> newKeyPair;
-          newKeyPair.set(newPageNum, newLeafNode->keyArray[0]);
-          newChild = &newKeyPair;
+    static StringKey key(const Page *page, const int i)
+    {
+        const PackedStringLeafNode *leaf = node(page);
+        int p = prefixLength(leaf);
+        StringKey key;
+        memcpy(key.data, leaf->prefix, p);
+        memcpy(key.data + p, entry(leaf, p, i), STRINGSIZE - p);
+        return key;
+    }
 
-          // step 7: unpin pages in question
-          bufMgr->unPinPage(this->file, currPageNo, true);
-          bufMgr->unPinPage(this->file, newPageNum, true);
+    static RecordId rid(const Page *page, const int i)
+    {
+        const PackedStringLeafNode *leaf = node(page);
+        int p = prefixLength(leaf);
+        RecordId rid;
+        memcpy(&rid, entry(leaf, p, i) + STRINGSIZE - p, sizeof(RecordId));
+        return rid;
+    }
 
-          // if the current page is the root, we make modifications to the root and the tree
-          if (currPageNo == this->rootPageNum) {
-              rootMods(currPageNo, newChild);
-          }
-      }
+    /// a key that does not start with the prefix sorts before or after every entry; otherwise only the rest of it is
+    /// compared, bytewise as keys compare
+    static int search(const Page *page, const int size, const StringKey &key, const bool upper)
+    {
+        const PackedStringLeafNode *leaf = node(page);
+        int p = prefixLength(leaf);
+        int c = memcmp(key.data, leaf->prefix, p);
+        if (c != 0) {
+            return c < 0 ? 0 : size;
+        }
+        int low = 0;
+        int high = std::min(size, capacityFor(p));
+        while (low < high) {
+            int mid = (low + high) / 2;
+            c = memcmp(leaf->data + mid * stride(p), key.data + p, STRINGSIZE - p);
+            if (c < 0 || (upper && c == 0)) {
+                low = mid + 1;
+            }
+            else {
+                high = mid;
+            }
+        }
+        return low;
     }
-    // case when we're about to insert anywhere but a leaf
-    else {
-        // now, we search for the next non leaf node in the process of finding the right key
-        int nextIdx = this->nodeOccupancy;
 
-        for(int i = nextIdx; i >= 0 && (currNode->pageNoArray[i] == 0); i--)
-        {
-            nextIdx--;
+    static int lowerBound(const Page *page, const int size, const StringKey &key)
+    {
+        return search(page, size, key, false);
+    }
+
+    static int upperBound(const Page *page, const int size, const StringKey &key)
+    {
+        return search(page, size, key, true);
+    }
+
+    static void copy(const Page *page, const int from, const int n, StringKey *keys, RecordId *rids)
+    {
+        const PackedStringLeafNode *leaf = node(page);
+        int p = prefixLength(leaf);
+        for (int i = 0; i < n; i++) {
+            const unsigned char *e = entry(leaf, p, from + i);
+            memcpy(keys[i].data, leaf->prefix, p);
+            memcpy(keys[i].data + p, e, STRINGSIZE - p);
+            memcpy(&rids[i], e + STRINGSIZE - p, sizeof(RecordId));
         }
+    }
 
-        for(int i = nextIdx; i > 0 && (currNode->keyArray[i-1] >= newPair.key); i--)
-        {
-            nextIdx--;
+    /// length of the prefix of the leaf once the run is merged in; an empty leaf takes the prefix of the run
+    static int mergedPrefix(const PackedStringLeafNode *leaf, const int size, const RIDKeyPair<StringKey> *run,
+            const size_t count)
+    {
+        if (count == 0) {
+            return prefixLength(leaf);
         }
-        // assign the newly found index of the next non leaf node to the nextNodeNo variable
-        nextNodeNo = currNode->pageNoArray[nextIdx];
+        const char *prefix = size > 0 ? leaf->prefix : run[0].key.data;
+        int p = size > 0 ? prefixLength(leaf) : STRINGSIZE;
+        for (size_t i = 0; i < count; i++) {
+            p = commonPrefix(prefix, run[i].key.data, p);
+        }
+        return p;
+    }
 
-        bufMgr->readPage(this->file, nextNodeNo, nextPage);
+    static bool fits(const Page *page, const RIDKeyPair<StringKey> *run, const size_t count)
+    {
+        const PackedStringLeafNode *leaf = node(page);
+        int size = std::min(std::max((int) leaf->header.keyCount, 0), capacity(page));
+        return (size_t) size + count <= (size_t) capacityFor(mergedPrefix(leaf, size, run, count));
+    }
 
-        // change isLeaf according to changes in currNode's level
-        if(currNode->level == 1) {
-            isLeaf = true;
-        } else {
-            isLeaf = false;
+    /// the prefix is shortened first if the run does not start with all of it: every entry is moved out to its new
+    /// place, last one first, with the bytes that leave the prefix put in front of it
+    static void merge(Page *page, const RIDKeyPair<StringKey> *run, const size_t count)
+    {
+        PackedStringLeafNode *leaf = node(page);
+        int size = leaf->header.keyCount;
+        int p = size > 0 ? leaf->prefixLength : STRINGSIZE;
+        int q = mergedPrefix(leaf, size, run, count);
+        if (size == 0 && count > 0) {
+            memcpy(leaf->prefix, run[0].key.data, STRINGSIZE);
         }
-        // recursive call to insert function with updated values of the variables
-        insertHelper(nextPage, nextNodeNo, newPair, newChild, isLeaf);
-
-         // if the child points to NULL and there is no split...
-            if (newChild == NULL)
-            {
-                // ... we unpin the current page from the buffer
-                //this->bufMgr->unPinPage(this->file, currPageNo, false);
-            } // split is needed
-            else
-              {
-              // if there exists a free non leaf node...
-              if (currNode->pageNoArray[this->nodeOccupancy] == 0)
-              {
-                // ...we insert the new child there and unpin the current page from the buffer
-                insertNonLeaf(currNode, newChild);
-                newChild = NULL;
-               // bufMgr->unPinPage(file, currPageNo, true);
-              }
-              // otherwise, we will have to create a new non leaf node
-              else
-              {
-                  PageId newPageNum;
-                  Page *newPage;
-                  bufMgr->allocPage(file, newPageNum, newPage);
-                  NonLeafNodeInt *newNode = (NonLeafNodeInt *)newPage;
-
-                  // here, we start to search for the right place to insert this new non leaf node
-                  int midpoint = this->nodeOccupancy / 2;
-                  int startIndex = midpoint; // default case is midpoint
-                  PageKeyPair<int> newPageKeyPair; // pair that we might have to add
-
-                  // if the number of nodes in the tree is even
-                  if (this->nodeOccupancy % 2 == 0)
-                  {
-                      // if the new child's key is less than the key of the midpoint...
-                      if (newChild->key < currNode->keyArray[midpoint]) {
-                          // ... we start the insertion process at midpoint
-                          startIndex = midpoint - 1;
-                      } else {
-                          // otherwise we start right at the midpoint + 1
-                          // (remember that indices start at 0 so we subtract above rather than adding here)
-                          startIndex = midpoint;
-                      }
-                  }
-                  newPageKeyPair.set(newPageNum, currNode->keyArray[startIndex]);
-
-                  midpoint = startIndex + 1;
-
-                  // here, we start the transfer process by moving half of the entries towards the newly created node
-                  for(int i = midpoint; i < this->nodeOccupancy; i++)
-                  {
-                      newNode->keyArray[i - midpoint] = currNode->keyArray[i];
-                      newNode->pageNoArray[i - midpoint] = currNode->pageNoArray[i + 1];
-                      currNode->pageNoArray[i + 1] = (PageId) 0;
-                      currNode->keyArray[i + 1] = 0;
-                  }
-
-                  // copy current node data into new node and remove current node's records from the tree
-                  newNode->level = currNode->level;
-                  currNode->keyArray[startIndex] = 0;
-                  currNode->pageNoArray[startIndex] = (PageId) 0;
-
-                  // here, we do the actual insertion process of the new child into the newly created non leaf node
-                  if(newChild->key < newNode->keyArray[0]) {
-                      insertNonLeaf(currNode, newChild);
-                  } else {
-                      insertNonLeaf(newNode, newChild);
-                  }
-                  newChild = &newPageKeyPair;
-
-                  // unpin pages in question
-                  //bufMgr->unPinPage(file, currPageNo, true);
-                  bufMgr->unPinPage(file, newPageNum, true);
-
-                  // if the current page is the root, we make modifications to the root and the tree
-                  if (currPageNo == this->rootPageNum)
-                  {
-                      rootMods(currPageNo, newChild);
-                  }
-              }
+        for (int i = size - 1; i >= 0 && q < p; i--) {
+            unsigned char *to = leaf->data + i * stride(q);
+            memmove(to + p - q, leaf->data + i * stride(p), stride(p));
+            memcpy(to, leaf->prefix + q, p - q);
+        }
+        leaf->prefixLength = (std::uint16_t) q;
+
+        int width = stride(q);
+        int suffix = STRINGSIZE - q;
+        int i = size - 1;
+        int j = count - 1;
+        for (int w = size + count - 1; j >= 0; w--) {
+            unsigned char *to = leaf->data + w * width;
+            if (i >= 0 && memcmp(run[j].key.data + q, leaf->data + i * width, suffix) < 0) {
+                memmove(to, leaf->data + i * width, width);
+                i--;
             }
-      }
-  }
+            else {
+                memcpy(to, run[j].key.data + q, suffix);
+                memcpy(to + suffix, &run[j].rid, sizeof(RecordId));
+                j--;
+            }
+        }
+        leaf->header.keyCount = size + count;
+    }
 
+    static void remove(Page *page, const int pos)
+    {
+        PackedStringLeafNode *leaf = node(page);
+        int width = stride(leaf->prefixLength);
+        int moved = leaf->header.keyCount - pos - 1;
+        memmove(leaf->data + pos * width, leaf->data + (pos + 1) * width, moved * width);
+        leaf->header.keyCount--;
+    }
+
+    /// number of entries at the start of n sorted ones that pack into one leaf. Keys with no first byte in common
+    /// would take more room than in a plain leaf, so at least one byte is always shared
+    static int run(const StringKey *keys, const RecordId *rids, const int n)
+    {
+        int p = STRINGSIZE;
+        int i = 0;
+        for (; i < n; i++) {
+            p = commonPrefix(keys[0].data, keys[i].data, p);
+            if (isPosting(rids[i]) || p == 0 || i >= capacityFor(p)) {
+                break;
+            }
+        }
+        return i;
+    }
+
+    /// the entries must pack; the prefix is what the first and last key have in common
+    static void write(Page *page, const StringKey *keys, const RecordId *rids, const int n)
+    {
+        PackedStringLeafNode *leaf = node(page);
+        int p = n > 0 ? commonPrefix(keys[0].data, keys[n - 1].data, STRINGSIZE) : 0;
+        leaf->header.nodeType = PACKED_LEAF_NODE;
+        leaf->header.level = 0;
+        leaf->prefixLength = (std::uint16_t) p;
+        if (n > 0) {
+            memcpy(leaf->prefix, keys[0].data, STRINGSIZE);
+        }
+        for (int i = 0; i < n; i++) {
+            unsigned char *e = leaf->data + i * stride(p);
+            memcpy(e, keys[i].data + p, STRINGSIZE - p);
+            memcpy(e + STRINGSIZE - p, &rids[i], sizeof(RecordId));
+        }
+        leaf->header.keyCount = n;
+    }
+};
 
 /**
- * This is a secondary helper function that we created to modify the tree's data as we intend to inser a new root into the page.
- * In an instance as such, we'll hace to create a new root, update the metadata, and change the page number of the root
- * to know how to reference this new root.
- *
- * @param pageId : The page number of the root
- * @param newChild : PageKeyPair corresponding to the child we're trying to insert in the root
+ * Most entries a leaf holds: what a packed one holds as its entries are packed, occupancy for a plain one.
  */
-void badgerdb::BTreeIndex::rootMods(PageId pageId, PageKeyPair<int> *newChild)
+template <class T>
+static inline int leafCapacity(const Page *page, const int occupancy)
 {
-  // step 1: in order to split, first we create a new root
-  PageId newRootNum;
-  Page *newRoot;
-  bufMgr->allocPage(file, newRootNum, newRoot);
-  NonLeafNodeInt *pageNew = (NonLeafNodeInt *) newRoot;
-  // step 2: as we have a new root, we need to update the metadata as necessary
-    if(this->rootPageNum == this->initRootPageNo) {
-        pageNew->level = 1;
-    } else {
-        pageNew->level = 0;
-    }
-    pageNew->keyArray[0] = newChild->key;
-    pageNew->pageNoArray[0] = pageId;
-    pageNew->pageNoArray[1] = newChild->pageNo;
-
+    return PackedLeaf<T>::is(page) ? PackedLeaf<T>::capacity(page) : occupancy;
+}
 
-  // step 3: getting the new meta info to change the rootPageNum and rootPageNo values in the metadata itself
-  Page *meta;
-  bufMgr->readPage(file, headerPageNum, meta);
-  IndexMetaInfo *newMetaInfo = (IndexMetaInfo *) meta;
+/**
+ * Number of entries in a leaf, clamped to what it holds, as readers that have not validated it yet need.
+ */
+template <class T>
+static inline int leafSize(const Page *page, const int occupancy)
+{
+    return std::min(std::max((int) ((const NodeHeader *) page)->keyCount, 0), leafCapacity<T>(page, occupancy));
+}
 
-  // step 4: change the page number of the root in the metadata to that of the new root
-  this->rootPageNum = newRootNum;
-  newMetaInfo->rootPageNo = newRootNum;
+/**
+ * Key and record id of entry i of a leaf, plain or packed.
+ */
+template <class T>
+static inline T leafKey(const Page *page, const int i)
+{
+    return PackedLeaf<T>::is(page) ? PackedLeaf<T>::key(page, i) : ((const LeafNode<T> *) page)->keyArray[i];
+}
 
-  // step 5: unpin pages in question
-  bufMgr->unPinPage(file, headerPageNum, true);
-  bufMgr->unPinPage(file, newRootNum, true);
+template <class T>
+static inline RecordId leafRid(const Page *page, const int i)
+{
+    return PackedLeaf<T>::is(page) ? PackedLeaf<T>::rid(page, i) : ((const LeafNode<T> *) page)->ridArray[i];
 }
 
 /**
- * This is a secondary helper function we created to perform the actual insertion process into the tree.
- * In this case, we're inserting into a leaf of the tree
- *
- * @param leaf : the pointer to the leaf node we're inserting the child to
- * @param newPair : The RIDKeyPair that corresponds to the new child we're about to insert
+ * lowerBound() and upperBound() over the first size keys of a leaf, plain or packed.
  */
-void badgerdb::BTreeIndex::insertLeaf(LeafNodeInt *leaf, RIDKeyPair<int> newPair)
+template <class T>
+static inline int leafLowerBound(const Page *page, const int size, const T &key)
 {
-  // if empty just insert new child straight away
-  if (leaf->ridArray[0].page_number == 0)
-  {
-    leaf->keyArray[0] = newPair.key;
-    leaf->ridArray[0] = newPair.rid;
-  }
-    // otherwise, work our way towards...
-  else
-  {
-    int endIdx = this->leafOccupancy - 1;
-    // 1) finding the end
-    for(int i = endIdx; i >= 0 && (leaf->ridArray[i].page_number == 0); i--) {
-        endIdx--;
-    }
-    // 2) shifting the rest of the tree to make space for the new child
-    for(int i = endIdx; i >= 0 && (leaf->keyArray[i] > newPair.key); i--) {
-        leaf->keyArray[endIdx+1] = leaf->keyArray[endIdx];
-        leaf->ridArray[endIdx+1] = leaf->ridArray[endIdx];
-        endIdx--;
-    }
-    // 3) putting the new child in the tree
-    leaf->keyArray[endIdx+1] = newPair.key;
-    leaf->ridArray[endIdx+1] = newPair.rid;
-  }
+    return PackedLeaf<T>::is(page) ? PackedLeaf<T>::lowerBound(page, size, key)
+                                   : lowerBound(((const LeafNode<T> *) page)->keyArray, size, key);
+}
+
+template <class T>
+static inline int leafUpperBound(const Page *page, const int size, const T &key)
+{
+    return PackedLeaf<T>::is(page) ? PackedLeaf<T>::upperBound(page, size, key)
+                                   : upperBound(((const LeafNode<T> *) page)->keyArray, size, key);
 }
 
 /**
- * This is a secondary helper function we created to perform the actual insertion process into the tree.
- * In this case, we're inserting into a non leaf of the tree
- *
+ * Copy n entries of a leaf from position from to keys and rids, decoding them if the leaf is packed.
+ */
+template <class T>
+static void leafEntries(const Page *page, const int from, const int n, T *keys, RecordId *rids)
+{
+    if (PackedLeaf<T>::is(page)) {
+        PackedLeaf<T>::copy(page, from, n, keys, rids);
+        return;
+    }
+    const LeafNode<T> *leaf = (const LeafNode<T> *) page;
+    memcpy(keys, &leaf->keyArray[from], n * sizeof(T));
+    memcpy(rids, &leaf->ridArray[from], n * sizeof(RecordId));
+}
+
+/**
+ * Number of entries in the leaves under a node page: the entries its keys stand for in a leaf, the sum of its entry
+ * counts otherwise.
+ */
+template <class T>
+static std::uint64_t nodeEntries(const Page *page)
+{
+    const NonLeafNode<T> *node = (const NonLeafNode<T> *) page;
+    if (PackedLeaf<T>::is(page)) {
+        return node->header.keyCount;
+    }
+    if (node->header.nodeType == LEAF_NODE) {
+        const LeafNode<T> *leaf = (const LeafNode<T> *) page;
+        std::uint64_t entries = 0;
+        for (int i = 0; i < leaf->header.keyCount; i++) {
+            entries += entryWeight(leaf->ridArray[i]);
+        }
+        return entries;
+    }
+    std::uint64_t entries = 0;
+    for (int i = 0; i <= node->header.keyCount; i++) {
+        entries += node->countArray[i];
+    }
+    return entries;
+}
+
+// -----------------------------------------------------------------------------
+// Posting list pages
+// -----------------------------------------------------------------------------
+
+/**
+ * A record id as one number that orders ids by page and then slot, and that consecutive records differ little in.
+ */
+static inline std::uint64_t packRid(const RecordId &rid)
+{
+    return ((std::uint64_t) rid.page_number << 16) | rid.slot_number;
+}
+
+static inline RecordId unpackRid(const std::uint64_t packed)
+{
+    RecordId rid;
+    rid.page_number = (PageId) (packed >> 16);
+    rid.slot_number = (SlotId) (packed & 0xffff);
+    rid.padding = 0;
+    return rid;
+}
+
+static bool ridOrder(const RecordId &a, const RecordId &b)
+{
+    return packRid(a) < packRid(b);
+}
+
+/**
+ * Clears a freshly allocated page and makes it an empty posting list page.
+ */
+static PostingNode *initPosting(Page *page)
+{
+    std::uint64_t version = nextLife(page);
+    memset((void *) page, 0, Page::SIZE);
+    PostingNode *node = (PostingNode *) page;
+    node->header.version = version;
+    node->header.nodeType = POSTING_NODE;
+    node->header.level = 0;
+    node->header.keyCount = 0;
+    return node;
+}
+
+/**
+ * Encodes as many of n sorted record ids as fit on a posting list page, replacing what the page held. The link to
+ * the next page is left as it is.
+ *
+ * @return Number of record ids written.
+ */
+static size_t encodePosting(PostingNode *node, const RecordId *rids, const size_t n)
+{
+    unsigned char *out = node->data;
+    unsigned char *end = node->data + sizeof(node->data);
+    std::uint64_t prev = 0;
+    size_t i = 0;
+    for (; i < n; i++) {
+        std::uint64_t value = packRid(rids[i]);
+        std::uint64_t delta = value - prev;
+        unsigned char bytes[10];
+        int length = 0;
+        do {
+            bytes[length] = (unsigned char) (delta & 0x7f);
+            delta >>= 7;
+            if (delta != 0) {
+                bytes[length] |= 0x80;
+            }
+            length++;
+        } while (delta != 0);
+        if (length > end - out) {
+            break;
+        }
+        memcpy(out, bytes, length);
+        out += length;
+        prev = value;
+    }
+    node->header.keyCount = i;
+    node->usedBytes = out - node->data;
+    node->lastRid = prev;
+    return i;
+}
+
+/**
+ * Appends the record ids of a posting list page to out. The byte count is clamped to the page, so a page read while
+ * it changes decodes to garbage but is never read past.
+ */
+static void decodePosting(const PostingNode *node, std::vector<RecordId> &out)
+{
+    int used = std::min(std::max((int) node->usedBytes, 0), (int) sizeof(node->data));
+    const unsigned char *in = node->data;
+    const unsigned char *end = node->data + used;
+    std::uint64_t value = 0;
+    while (in < end) {
+        std::uint64_t delta = 0;
+        for (int shift = 0; in < end && shift < 64; shift += 7) {
+            unsigned char byte = *in++;
+            delta |= (std::uint64_t) (byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        value += delta;
+        out.push_back(unpackRid(value));
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Composite keys
+// -----------------------------------------------------------------------------
+
+/**
+ * Number of bytes a key column of the given type takes in a CompositeKey, 0 for a type a column cannot have.
+ */
+static int columnSize(const Datatype type)
+{
+    switch (type) {
+        case INTEGER:
+            return sizeof(int);
+        case DOUBLE:
+            return sizeof(double);
+        case STRING:
+            return STRINGSIZE;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Writes the integer, double or char string value points to into out, in the byte-comparable form of
+ * key_normalize.h, so that the bytes of two values compare with memcmp as the values do.
+ */
+static void encodeColumn(const Datatype type, const void *value, unsigned char *out)
+{
+    if (type == INTEGER) {
+        encodeInt(KeyTraits<int>::load(value), out);
+    }
+    else if (type == DOUBLE) {
+        encodeDouble(KeyTraits<double>::load(value), out);
+    }
+    else {
+        encodeString((const char *) value, STRINGSIZE, out);
+    }
+}
+
+void BTreeIndex::makeKey(const void * const *values, const int numColumns, void *out, const bool high) const
+{
+    if (numColumns < 1 || numColumns > (int) keyColumns.size()) {
+        throw BadScanParamException();
+    }
+    if (attributeType != COMPOSITE) {
+        if (attributeType == STRING) {
+            strncpy((char *) out, (const char *) values[0], STRINGSIZE);
+        }
+        else {
+            memcpy(out, values[0], columnSize(attributeType));
+        }
+        return;
+    }
+
+    unsigned char *key = (unsigned char *) out;
+    memset(key, high ? 0xff : 0, COMPOSITESIZE);
+    int pos = 0;
+    for (int i = 0; i < numColumns; i++) {
+        encodeColumn(keyColumns[i].type, values[i], key + pos);
+        pos += columnSize(keyColumns[i].type);
+    }
+    /// a key of every column has zeros past them, as the keys of the records do
+    if (numColumns == (int) keyColumns.size()) {
+        memset(key + pos, 0, COMPOSITESIZE - pos);
+    }
+}
+
+void BTreeIndex::loadKey(const char *record, void *out) const
+{
+    const void *values[MAX_KEY_COLUMNS];
+    for (size_t i = 0; i < keyColumns.size(); i++) {
+        values[i] = record + keyColumns[i].byteOffset;
+    }
+    makeKey(values, keyColumns.size(), out);
+}
+
+template <class T>
+T BTreeIndex::recordKey(const char *record) const
+{
+    return KeyTraits<T>::load(record + attrByteOffset);
+}
+
+template <>
+CompositeKey BTreeIndex::recordKey<CompositeKey>(const char *record) const
+{
+    CompositeKey key;
+    loadKey(record, &key);
+    return key;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::BTreeIndex -- Constructor
+// -----------------------------------------------------------------------------
+
+BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const int attrByteOffset,
+		const Datatype attrType,
+		const BuildMode buildMode,
+		const double fillFactor,
+		const double appendSplitRatio,
+		const std::vector<IncludeColumn> &includeColumns,
+		const LeafFormat leafFormat)
+    : BTreeIndex(relationName, outIndexName, bufMgrIn, std::vector<KeyColumn>(1, KeyColumn{attrByteOffset, attrType}),
+            buildMode, fillFactor, appendSplitRatio, includeColumns, leafFormat)
+{
+}
+
+BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const std::vector<KeyColumn> &keyColumns,
+		const BuildMode buildMode,
+		const double fillFactor,
+		const double appendSplitRatio,
+		const std::vector<IncludeColumn> &includeColumns,
+		const LeafFormat leafFormat)
+    : scanCursor(this)
+{
+
+    this -> rootPageNum = (PageId) -1;
+    this -> structureVersion = 0;
+    this -> countUpdaters = 0;
+    this -> freeListHead = 0;
+    memset(&fingerInt, 0, sizeof(fingerInt));
+    memset(&fingerDouble, 0, sizeof(fingerDouble));
+    memset(&fingerString, 0, sizeof(fingerString));
+    memset(&fingerComposite, 0, sizeof(fingerComposite));
+
+    /// one key column keys the index on that attribute, several on a CompositeKey encoding them all
+    if (keyColumns.empty() || keyColumns.size() > (size_t) MAX_KEY_COLUMNS) {
+        throw BadIndexInfoException("bad number of key columns");
+    }
+    int keySize = 0;
+    for (size_t i = 0; i < keyColumns.size(); i++) {
+        if (keyColumns[i].byteOffset < 0 || columnSize(keyColumns[i].type) == 0) {
+            throw BadIndexInfoException("bad key column");
+        }
+        keySize += columnSize(keyColumns[i].type);
+    }
+    if (keySize > COMPOSITESIZE) {
+        throw BadIndexInfoException("key columns too wide");
+    }
+    const Datatype attrType = keyColumns.size() > 1 ? COMPOSITE : keyColumns[0].type;
+    const int attrByteOffset = keyColumns[0].byteOffset;
+
+    this -> attributeType = attrType;
+    this -> attrByteOffset = attrByteOffset;
+    this -> keyColumns = keyColumns;
+
+    /// INCLUDE columns take room in the leaves, so they are known before the key type sets the leaf occupancy
+    this -> includeColumns = includeColumns;
+    this -> includeSize = 0;
+    if (includeColumns.size() > (size_t) MAX_INCLUDE_COLUMNS) {
+        throw BadIndexInfoException("too many INCLUDE columns");
+    }
+    for (size_t i = 0; i < includeColumns.size(); i++) {
+        if (includeColumns[i].size <= 0 || includeColumns[i].byteOffset < 0) {
+            throw BadIndexInfoException("bad INCLUDE column");
+        }
+        this -> includeSize += includeColumns[i].size;
+    }
+    if (this -> includeSize > MAX_INCLUDE_SIZE) {
+        throw BadIndexInfoException("INCLUDE columns too wide");
+    }
+
+    /// packed leaves hold INTEGER or STRING keys and record ids, and nothing else
+    if (leafFormat == PACKED_LEAVES && ((attrType != INTEGER && attrType != STRING) || this -> includeSize > 0)) {
+        throw BadIndexInfoException("packed leaves need INTEGER or STRING keys and no INCLUDE columns");
+    }
+    this -> leafFormat = leafFormat;
+
+    /// node and leaf occupancy and the code for the key type, picked here once
+    switch (attrType) {
+        case INTEGER:
+            initKeyType<int>();
+            break;
+        case DOUBLE:
+            initKeyType<double>();
+            break;
+        case STRING:
+            initKeyType<StringKey>();
+            break;
+        case COMPOSITE:
+            initKeyType<CompositeKey>();
+            break;
+        default:
+            throw BadIndexInfoException("unknown attribute type");
+    }
+
+    /// get buffer manager
+    bufMgr = bufMgrIn;
+
+    if (!(fillFactor > 0.0 && fillFactor <= 1.0)) {
+        throw BadIndexInfoException("fill factor must be in (0, 1]");
+    }
+    if (!(appendSplitRatio >= 0.5 && appendSplitRatio <= 1.0)) {
+        throw BadIndexInfoException("append split ratio must be in [0.5, 1]");
+    }
+    this->appendSplitRatio = appendSplitRatio;
+
+    Page *pageHead;
+
+    /// create meta index
+    IndexMetaInfo *index_meta;
+
+    /// get and output the name of the index from the relationName passed in
+    std::ostringstream index_string;
+    index_string << relationName;
+    for (size_t i = 0; i < keyColumns.size(); i++) {
+        index_string << '.' << keyColumns[i].byteOffset;
+    }
+    outIndexName = index_string.str();
+
+    /// try to access file and if it does not exist create a new one
+    bool createFile = false;
+    try {
+        /// access file and create meta index
+        file = new BlobFile(index_string.str(), false);
+
+        headerPageNum = file->getFirstPageNo();
+        bufMgr->readPage(file, headerPageNum, pageHead);
+
+        index_meta = (IndexMetaInfo *) pageHead;
+
+        /// an existing index must have been built over the same attribute of the same relation
+        if (strncmp(index_meta->relationName, relationName.c_str(), sizeof(index_meta->relationName) - 1) != 0
+                || index_meta->attrByteOffset != attrByteOffset || index_meta->attrType != attrType) {
+            bufMgr->unPinPage(file, headerPageNum, false);
+            bufMgr->flushFile(file);
+            delete file;
+            file = NULL;
+            throw BadIndexInfoException("meta page does not match the relation, attribute offset or type");
+        }
+
+        /// and carry the same key and INCLUDE columns, unless it is about to be rebuilt in the current format anyway
+        bool sameColumns = index_meta->includeCount == (int) includeColumns.size()
+                && index_meta->keyColumnCount == (int) keyColumns.size();
+        for (size_t i = 0; sameColumns && i < includeColumns.size(); i++) {
+            sameColumns = index_meta->includeColumns[i].byteOffset == includeColumns[i].byteOffset
+                    && index_meta->includeColumns[i].size == includeColumns[i].size;
+        }
+        for (size_t i = 0; sameColumns && i < keyColumns.size(); i++) {
+            sameColumns = index_meta->keyColumns[i].byteOffset == keyColumns[i].byteOffset
+                    && index_meta->keyColumns[i].type == keyColumns[i].type;
+        }
+        if (!sameColumns && index_meta->formatVersion == INDEX_FORMAT_VERSION) {
+            bufMgr->unPinPage(file, headerPageNum, false);
+            bufMgr->flushFile(file);
+            delete file;
+            file = NULL;
+            throw BadIndexInfoException("meta page does not match the key or INCLUDE columns");
+        }
+
+        rootPageNum = index_meta->rootPageNo;
+        freeListHead = index_meta->freeListHead;
+        int formatVersion = index_meta->formatVersion;
+        if (formatVersion == INDEX_FORMAT_VERSION) {
+            this -> leafFormat = index_meta->leafFormat;
+        }
+
+        // unpin the page
+        bufMgr->unPinPage(file, headerPageNum, false);
+
+        /// files in an older node format are thrown away and rebuilt from the relation below
+        if (formatVersion != INDEX_FORMAT_VERSION) {
+            freeListHead = 0;
+            bufMgr->flushFile(file);
+            delete file;
+            file = NULL;
+            File::remove(index_string.str());
+            createFile = true;
+        }
+    }
+    catch(FileNotFoundException err) { /// catch exception if file not found, make new file
+        createFile = true;
+    }
+
+    if (createFile) {
+        /// make new file and create a header page
+        file = new BlobFile(index_string.str(), true);
+        bufMgr->allocPage(file, headerPageNum, pageHead);
+        memset((void *) pageHead, 0, Page::SIZE);
+
+        index_meta = (IndexMetaInfo *) pageHead;
+
+        index_meta->attrType = attrType; /// fill attribute details from what was passed in
+        index_meta->attrByteOffset = attrByteOffset;
+        strncpy(index_meta->relationName, relationName.c_str(), sizeof(index_meta->relationName) - 1);
+        index_meta->formatVersion = INDEX_FORMAT_VERSION;
+        index_meta->includeCount = includeColumns.size();
+        for (size_t i = 0; i < includeColumns.size(); i++) {
+            index_meta->includeColumns[i] = includeColumns[i];
+        }
+        index_meta->leafFormat = leafFormat;
+        index_meta->keyColumnCount = keyColumns.size();
+        for (size_t i = 0; i < keyColumns.size(); i++) {
+            index_meta->keyColumns[i] = keyColumns[i];
+        }
+        bufMgr->unPinPage(file, headerPageNum, true);
+
+        /// instantiate a filescan to read the base relation
+        FileScan scan(relationName, bufMgr);
+
+        switch (attrType) {
+            case INTEGER:
+                buildIndex<int>(scan, buildMode, fillFactor);
+                break;
+            case DOUBLE:
+                buildIndex<double>(scan, buildMode, fillFactor);
+                break;
+            case STRING:
+                buildIndex<StringKey>(scan, buildMode, fillFactor);
+                break;
+            case COMPOSITE:
+                buildIndex<CompositeKey>(scan, buildMode, fillFactor);
+                break;
+        }
+    }
+}
+
+/**
+ * Sets the occupancies and the typed implementations of insertEntry(), lookup(), insertEntries(), deleteEntry(),
+ * minKey(), maxKey() and countRange() for key type T.
+ */
+template <class T>
+void BTreeIndex::initKeyType()
+{
+    this->leafOccupancy = coveringLeafSize<T>(this->includeSize);
+    this->nodeOccupancy = KeyTraits<T>::NONLEAF_SIZE;
+    this->insertEntryFn = &BTreeIndex::insertEntryTyped<T>;
+    this->lookupFn = &BTreeIndex::lookupTyped<T>;
+    this->insertEntriesFn = &BTreeIndex::insertEntriesTyped<T>;
+    this->deleteEntryFn = &BTreeIndex::deleteEntryTyped<T>;
+    this->edgeEntryFn = &BTreeIndex::edgeEntryTyped<T>;
+    this->countRangeFn = &BTreeIndex::countRangeTyped<T>;
+    this->parallelScanFn = &BTreeIndex::parallelScanTyped<T>;
+}
+
+/**
+ * Fills a new index file from the base relation, either by bulk loading or by inserting one record at a time
+ * into a tree that starts out as an empty leaf.
+ */
+template <class T>
+void BTreeIndex::buildIndex(FileScan &scan, const BuildMode buildMode, const double fillFactor)
+{
+    /// variables used in function
+    RecordId r_id;
+    std::string r;
+
+    if (buildMode == BULK_LOAD) {
+        /// extract every <key, rid> pair, then build the tree from them in one pass
+        std::vector< RIDKeyPair<T> > entries;
+        std::vector<char> includes;
+        try {
+            while (true) {
+                scan.scanNext(r_id);
+                r = scan.getRecord();
+                RIDKeyPair<T> entry;
+                entry.set(r_id, recordKey<T>(r.c_str()));
+                entries.push_back(entry);
+                if (includeSize > 0) {
+                    includes.resize(includes.size() + includeSize);
+                    loadIncludes(r.c_str(), &includes[includes.size() - includeSize]);
+                }
+            }
+        }
+        catch (EndOfFileException err) { }
+
+        /// the INCLUDE bytes stay where they are while the entries are sorted
+        if (includeSize > 0) {
+            for (size_t i = 0; i < entries.size(); i++) {
+                entries[i].include = &includes[i * includeSize];
+            }
+        }
+        bulkLoad(entries, fillFactor);
+    }
+    else {
+        /// the root starts out as an empty leaf, packed if the index packs its leaves
+        PageId rootNo;
+        Page *pageRoot;
+        allocNode(rootNo, pageRoot);
+        initLeaf<T>(pageRoot);
+        writeLeaf<T>(pageRoot, NULL, NULL, 0);
+        rootPageNum = rootNo;
+        bufMgr->unPinPage(file, rootNo, true);
+
+        Page *meta;
+        bufMgr->readPage(file, headerPageNum, meta);
+        ((IndexMetaInfo *) meta)->rootPageNo = rootNo;
+        bufMgr->unPinPage(file, headerPageNum, true);
+
+        /// scan file until reaching EOF
+        char include[MAX_INCLUDE_SIZE];
+        try {
+            while (true) {
+                scan.scanNext(r_id);
+                r = scan.getRecord();
+                T key = recordKey<T>(r.c_str());
+                loadIncludes(r.c_str(), include);
+                insertEntryTyped<T>(&key, r_id, includeSize > 0 ? include : NULL);
+            }
+        }
+        catch (EndOfFileException err) { }
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bulkLoad
+// -----------------------------------------------------------------------------
+
+/**
+ * Number of entries to put on one page holding at most `occupancy` entries, never less than `minimum`.
+ */
+static int fillCount(const int occupancy, const double fillFactor, const int minimum)
+{
+    int count = (int) (occupancy * fillFactor);
+    return std::min(occupancy, std::max(minimum, count));
+}
+
+/**
+ * Builds the tree bottom-up. Leaves are written left to right with their sibling links, then every
+ * non-leaf level is written from the first key and page number of each node on the level below it,
+ * until a level holds a single node, which becomes the root. Entries are spread evenly over the pages
+ * of a level so the last page is never left nearly empty.
+ *
+ * @param entries : the <key, rid> pairs of every record in the relation, sorted here in place
+ * @param fillFactor : fraction of each page to fill
+ */
+template <class T>
+void BTreeIndex::bulkLoad(std::vector< RIDKeyPair<T> > &entries, const double fillFactor)
+{
+    std::sort(entries.begin(), entries.end());
+
+    /// leaves without INCLUDE bytes are written from the keys and record ids apart, after long runs of one key have
+    /// gone to posting lists, leaving a single entry each
+    std::vector<T> keys;
+    std::vector<RecordId> rids;
+    if (includeSize == 0) {
+        keys.resize(entries.size());
+        rids.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            keys[i] = entries[i].key;
+            rids[i] = entries[i].rid;
+        }
+    }
+    if (usesPostings() && !entries.empty()) {
+        size_t kept = makePostings(&keys[0], &rids[0], entries.size());
+        for (size_t i = 0; i < kept; i++) {
+            entries[i].set(rids[i], keys[i]);
+        }
+        entries.resize(kept);
+    }
+
+    const size_t perLeaf = fillCount(this->leafOccupancy, fillFactor, 1);
+    /// a non-leaf needs at least two keys, so that splitting a level always leaves two children per node
+    const size_t perNode = fillCount(KeyTraits<T>::NONLEAF_SIZE, fillFactor, 2) + 1;
+
+    /// first key, page number and number of entries of each node on the level just written
+    std::vector< PageKeyPair<T> > level;
+    std::vector<std::uint64_t> counts;
+
+    // step 1: size the leaves. Plain leaves share the entries evenly. Packed leaves are filled left to right with as
+    // many entries as pack, up to the fill factor of what a leaf of them holds, and a stretch of entries too far
+    // apart to pack takes a plain leaf
+    std::vector<size_t> sizes;
+    if (this->leafFormat == PACKED_LEAVES) {
+        for (size_t pos = 0; pos < entries.size(); pos += sizes.back()) {
+            size_t left = entries.size() - pos;
+            /// a packed leaf holds fewer entries than two plain ones
+            int count = PackedLeaf<T>::run(&keys[pos], &rids[pos], std::min(left, 2 * (size_t) this->leafOccupancy));
+            count = std::min(count, fillCount(PackedLeaf<T>::capacity(&keys[pos], count), fillFactor, 1));
+            sizes.push_back(std::max((size_t) count, std::min(left, perLeaf)));
+        }
+        if (sizes.empty()) {
+            sizes.push_back(0);
+        }
+    }
+    else {
+        size_t numLeaves = std::max((size_t) 1, (entries.size() + perLeaf - 1) / perLeaf);
+        for (size_t i = 0; i < numLeaves; i++) {
+            sizes.push_back(entries.size() / numLeaves + (i < entries.size() % numLeaves ? 1 : 0));
+        }
+    }
+
+    // step 2: write the leaves in key order
+    size_t pos = 0;
+    PageId prevLeafNo = 0;
+    LeafNode<T> *prevLeaf = NULL;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        size_t count = sizes[i];
+
+        PageId leafNo;
+        Page *leafPage;
+        allocNode(leafNo, leafPage);
+        LeafNode<T> *leaf = initLeaf<T>(leafPage);
+
+        std::uint64_t weight = 0;
+        for (size_t j = 0; j < count; j++) {
+            weight += entryWeight(entries[pos + j].rid);
+        }
+        if (includeSize == 0) {
+            writeLeaf(leafPage, keys.data() + pos, rids.data() + pos, count);
+        }
+        else {
+            for (size_t j = 0; j < count; j++) {
+                setEntry(leaf, j, entries[pos + j]);
+            }
+            leaf->header.keyCount = count;
+        }
+
+        PageKeyPair<T> node;
+        node.set(leafNo, count > 0 ? entries[pos].key : T());
+        level.push_back(node);
+        counts.push_back(weight);
+        pos += count;
+
+        if (prevLeaf != NULL) {
+            prevLeaf->rightSibPageNo = leafNo;
+            bufMgr->unPinPage(this->file, prevLeafNo, true);
+        }
+        prevLeafNo = leafNo;
+        prevLeaf = leaf;
+    }
+    bufMgr->unPinPage(this->file, prevLeafNo, true);
+
+    // step 3: write the non-leaf levels until a single node is left, which becomes the root
+    buildUpperLevels(level, counts, 1, perNode);
+}
+
+template <class T>
+void BTreeIndex::buildUpperLevels(std::vector< PageKeyPair<T> > &level, std::vector<std::uint64_t> &counts,
+        int height, const size_t perNode)
+{
+    while (level.size() > 1) {
+        std::vector< PageKeyPair<T> > parents;
+        std::vector<std::uint64_t> parentCounts;
+        size_t numNodes = (level.size() + perNode - 1) / perNode;
+        size_t pos = 0;
+        for (size_t i = 0; i < numNodes; i++) {
+            size_t count = level.size() / numNodes + (i < level.size() % numNodes ? 1 : 0);
+
+            PageId nodeNo;
+            Page *nodePage;
+            allocNode(nodeNo, nodePage);
+            NonLeafNode<T> *node = initNonLeaf<T>(nodePage, height);
+
+            node->pageNoArray[0] = level[pos].pageNo;
+            node->countArray[0] = counts[pos];
+            std::uint64_t entries = counts[pos];
+            for (size_t j = 1; j < count; j++) {
+                node->keyArray[j - 1] = level[pos + j].key;
+                node->pageNoArray[j] = level[pos + j].pageNo;
+                node->countArray[j] = counts[pos + j];
+                entries += counts[pos + j];
+            }
+            node->header.keyCount = count - 1;
+
+            PageKeyPair<T> parent;
+            parent.set(nodeNo, level[pos].key);
+            parents.push_back(parent);
+            parentCounts.push_back(entries);
+            pos += count;
+
+            bufMgr->unPinPage(this->file, nodeNo, true);
+        }
+        level.swap(parents);
+        counts.swap(parentCounts);
+        height++;
+    }
+
+    // point the meta page at the new root
+    this->rootPageNum = level[0].pageNo;
+
+    Page *meta;
+    bufMgr->readPage(this->file, this->headerPageNum, meta);
+    ((IndexMetaInfo *) meta)->rootPageNo = this->rootPageNum;
+    bufMgr->unPinPage(this->file, this->headerPageNum, true);
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::~BTreeIndex -- destructor
+// -----------------------------------------------------------------------------
+
+badgerdb::BTreeIndex::~BTreeIndex()
+{
+    try {
+        if (this->scanCursor.isExecuting()) {
+            this->scanCursor.endScan();
+        }
+        bufMgr->flushFile(this->file);
+    }
+    catch (const BadgerDbException &e) { }
+
+    delete this->file;
+    this->file = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntry
+// -----------------------------------------------------------------------------
+/**
+ * This method inserts a new entry into the index using the pair <key, rid>
+ *
+ * @param key :  A pointer to the value (integer, double or string) we want to insert.
+ * @param rid : The corresponding record id of the tuple in the base relation.
+ */
+void BTreeIndex::insertEntry(const void *key, const RecordId rid, const void *include)
+{
+    if (includeSize > 0 && include == NULL) {
+        throw BadIndexInfoException("index has INCLUDE columns, but no INCLUDE bytes were given");
+    }
+    (this->*insertEntryFn)(key, rid, includeSize > 0 ? (const char *) include : NULL);
+}
+
+/**
+ * insertEntry() for keys of type T.
+ */
+template <class T>
+void BTreeIndex::insertEntryTyped(const void *key, const RecordId rid, const char *include)
+{
+    RIDKeyPair<T> newPair;
+    newPair.set(rid, KeyTraits<T>::load(key), include); // create new key-rid pair and set its values
+
+    // most inserts find room in their leaf and only ever lock that leaf
+    if (insertOptimistic(newPair)) {
+        return;
+    }
+
+    // the leaf is full: splits are made one at a time, while other threads keep reading and inserting
+    std::lock_guard<std::mutex> guard(this->structureLatch);
+    StructureChange change(*this);
+    PageId rootNo = this->rootPageNum;
+    Page* root; // root of our tree
+    bufMgr->readPage(this->file, rootNo, root);
+    int rootLevel = ((NodeHeader *) root)->level;
+    PageKeyPair<T> *newChild = NULL;
+    // call insert helper method
+    insertHelper<T>(root, rootNo, newPair, newChild, true);
+
+    // if the root itself was split, we make modifications to the root and the tree. The old root stays locked
+    // until rootPageNum points at the new root, so no reader starts from it while it holds only half the keys
+    if (newChild != NULL) {
+        rootMods<T>(rootNo, newChild, rootLevel + 1);
+        delete newChild;
+        unlockNode(&((NodeHeader *) root)->version);
+        bufMgr->unPinPage(this->file, rootNo, true);
+    }
+}
+
+/**
+ * Writers that change a leaf without structureLatch announce themselves in countUpdaters before they check
+ * structureVersion, and a split or merge advances structureVersion before it checks countUpdaters, so one of the two
+ * always sees the other: either the writer finds the version moved and restarts, or the split waits for it.
+ */
+void BTreeIndex::beginStructureChange()
+{
+    this->structureVersion++;
+    while (this->countUpdaters != 0) {
+        std::this_thread::yield();
+    }
+}
+
+BTreeIndex::StructureChange::StructureChange(BTreeIndex &index) : index(index)
+{
+    index.beginStructureChange();
+}
+
+/**
+ * A split or merge cut short leaves the tree as far as it got, so the nodes it held are unlocked rather than marked
+ * obsolete: they are still in the tree, and readers have to get through them.
+ */
+BTreeIndex::StructureChange::~StructureChange()
+{
+    for (size_t i = 0; i < index.structureLocks.size(); i++) {
+        OptimisticLatch::writeUnlock(index.structureLocks[i]);
+    }
+    index.structureLocks.clear();
+    index.structureVersion++;
+}
+
+void BTreeIndex::lockNode(std::uint64_t *word)
+{
+    OptimisticLatch::writeLock(word);
+    this->structureLocks.push_back(word);
+}
+
+void BTreeIndex::unlockNode(std::uint64_t *word)
+{
+    forgetLock(word);
+    OptimisticLatch::writeUnlock(word);
+}
+
+void BTreeIndex::unlockNodeObsolete(std::uint64_t *word)
+{
+    forgetLock(word);
+    OptimisticLatch::writeUnlockObsolete(word);
+}
+
+void BTreeIndex::forgetLock(std::uint64_t *word)
+{
+    std::vector<std::uint64_t *>::iterator it = std::find(this->structureLocks.begin(), this->structureLocks.end(), word);
+    if (it != this->structureLocks.end()) {
+        this->structureLocks.erase(it);
+    }
+}
+
+bool BTreeIndex::enterCountUpdate(const std::uint64_t structure)
+{
+    this->countUpdaters++;
+    if (structure % 2 == 0 && this->structureVersion == structure) {
+        return true;
+    }
+    this->countUpdaters--;
+    return false;
+}
+
+/**
+ * Counts are added atomically, since writers to different leaves under the same node do not exclude each other.
+ */
+template <class T>
+void BTreeIndex::addToPathCounts(const DescentPath &path, const std::int64_t delta)
+{
+    for (int i = 0; i < path.depth; i++) {
+        NonLeafNode<T> *node = (NonLeafNode<T> *) path.page[i];
+        __atomic_fetch_add(&node->countArray[path.child[i]], (std::uint64_t) delta, __ATOMIC_RELAXED);
+    }
+}
+
+void BTreeIndex::releasePath(DescentPath *path, const bool dirty)
+{
+    if (path == NULL) {
+        return;
+    }
+    for (int i = 0; i < path->depth; i++) {
+        bufMgr->unPinPage(this->file, path->pageNo[i], dirty);
+    }
+    path->depth = 0;
+}
+
+template <class T>
+std::uint64_t BTreeIndex::subtreeCount(const PageId pageNo)
+{
+    Page *page;
+    bufMgr->readPage(this->file, pageNo, page);
+    std::uint64_t entries = nodeEntries<T>(page);
+    bufMgr->unPinPage(this->file, pageNo, false);
+    return entries;
+}
+
+/**
+ * Descends with optimistic lock coupling: the version of a node is validated before the child page number read
+ * from it is used, and again once the child's version has been read, so a split of either node restarts the descent.
+ * Key counts read before validation may be torn by a concurrent write and are clamped to the node.
+ */
+template <class T>
+bool BTreeIndex::findLeafOptimistic(const T &key, PageId &leafNo, Page *&leafPage, std::uint64_t &version,
+        KeyRange<T> *range, DescentPath *path)
+{
+    if (path != NULL) {
+        path->depth = 0;
+    }
+    PageId nodeNo = this->rootPageNum;
+    Page *node;
+    bufMgr->readPage(this->file, nodeNo, node);
+    std::uint64_t nodeVersion;
+    // a root split keeps the old root locked until rootPageNum moves on, so this rejects a root that was replaced
+    if (!OptimisticLatch::readLock(&((NodeHeader *) node)->version, nodeVersion) || nodeNo != this->rootPageNum) {
+        bufMgr->unPinPage(this->file, nodeNo, false);
+        return false;
+    }
+
+    while (!isLeaf(node)) {
+        NonLeafNode<T> *currNode = (NonLeafNode<T> *) node;
+        int numKeys = std::min(std::max((int) currNode->header.keyCount, 0), KeyTraits<T>::NONLEAF_SIZE);
+        int childIdx = lowerBound(currNode->keyArray, numKeys, key);
+        PageId childNo = currNode->pageNoArray[childIdx];
+        if (range != NULL) {
+            /// separators further down are always inside the ones above, so the nearest ones bound the leaf
+            if (childIdx > 0) {
+                range->hasLow = true;
+                range->low = currNode->keyArray[childIdx - 1];
+            }
+            if (childIdx < numKeys) {
+                range->hasHigh = true;
+                range->high = currNode->keyArray[childIdx];
+            }
+        }
+        if (!OptimisticLatch::validate(&currNode->header.version, nodeVersion)
+                || (path != NULL && path->depth == MAX_TREE_HEIGHT)) {
+            bufMgr->unPinPage(this->file, nodeNo, false);
+            releasePath(path, false);
+            return false;
+        }
+
+        Page *child;
+        std::uint64_t childVersion;
+        bufMgr->readPage(this->file, childNo, child);
+        bool valid = OptimisticLatch::readLock(&((NodeHeader *) child)->version, childVersion)
+                && OptimisticLatch::validate(&currNode->header.version, nodeVersion);
+        /// a path keeps the nodes it goes through pinned, for the writer to add to their counts
+        if (path != NULL) {
+            path->pageNo[path->depth] = nodeNo;
+            path->page[path->depth] = node;
+            path->child[path->depth] = childIdx;
+            path->depth++;
+        }
+        else {
+            bufMgr->unPinPage(this->file, nodeNo, false);
+        }
+        if (!valid) {
+            bufMgr->unPinPage(this->file, childNo, false);
+            releasePath(path, false);
+            return false;
+        }
+
+        nodeNo = childNo;
+        node = child;
+        nodeVersion = childVersion;
+    }
+
+    leafNo = nodeNo;
+    leafPage = node;
+    version = nodeVersion;
+    return true;
+}
+
+/**
+ * Finds the leaf optimistically and upgrades to a write lock on it alone. The upgrade fails if the leaf changed
+ * since it was reached, in which case the insert starts over from the root. Keys that land next to the previous
+ * insert skip the descent through the finger. While a split runs, the insert waits for it: the path it would add
+ * its entry to may be changing.
+ */
+template <class T>
+bool BTreeIndex::insertOptimistic(const RIDKeyPair<T> &newPair)
+{
+    if (insertAtFinger(newPair)) {
+        return true;
+    }
+
+    while (true) {
+        PageId leafNo;
+        Page *leafPage;
+        std::uint64_t version;
+        std::uint64_t structure = this->structureVersion;
+        if (structure % 2 == 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        KeyRange<T> range;
+        range.hasLow = false;
+        range.hasHigh = false;
+        DescentPath path;
+        if (!findLeafOptimistic(newPair.key, leafNo, leafPage, version, &range, &path)) {
+            continue;
+        }
+
+        LeafNode<T> *leaf = (LeafNode<T> *) leafPage;
+        bool full = !leafHasRoom(leafPage, &newPair, 1);
+        if (OptimisticLatch::validate(&leaf->header.version, version) && full) {
+            bufMgr->unPinPage(this->file, leafNo, false);
+            releasePath(&path, false);
+            return false;
+        }
+        if (!OptimisticLatch::upgradeToWriteLock(&leaf->header.version, version)) {
+            bufMgr->unPinPage(this->file, leafNo, false);
+            releasePath(&path, false);
+            continue;
+        }
+        if (!enterCountUpdate(structure)) {
+            OptimisticLatch::writeUnlock(&leaf->header.version);
+            bufMgr->unPinPage(this->file, leafNo, false);
+            releasePath(&path, false);
+            continue;
+        }
+
+        addToPathCounts<T>(path, 1);
+        insertLeaf(leaf, newPair);
+        OptimisticLatch::writeUnlock(&leaf->header.version);
+        leaveCountUpdate();
+        bufMgr->unPinPage(this->file, leafNo, true);
+        setFinger(leafNo, range, path, structure);
+        releasePath(&path, true);
+        return true;
+    }
+}
+
+/**
+ * The range of a leaf only changes when a split runs, and every split advances structureVersion before it locks
+ * anything. Reading the leaf's version before checking structureVersion therefore means either the check sees the
+ * split, or the split locks the leaf later and the upgrade fails. The path to the leaf cannot have changed either,
+ * so its nodes are pinned again to add the entry to their counts.
+ */
+template <class T>
+bool BTreeIndex::insertAtFinger(const RIDKeyPair<T> &newPair)
+{
+    LeafFinger<T> &leafFinger = finger<T>();
+    std::uint64_t fingerVersion;
+    if (!OptimisticLatch::readLock(&leafFinger.version, fingerVersion)) {
+        return false;
+    }
+    PageId leafNo = leafFinger.leafNo;
+    std::uint64_t structure = leafFinger.structureVersion;
+    bool inRange = leafFinger.range.contains(newPair.key);
+    DescentPath path = leafFinger.path;
+    if (!OptimisticLatch::validate(&leafFinger.version, fingerVersion) || leafNo == 0 || !inRange
+            || structure != this->structureVersion) {
+        return false;
+    }
+
+    for (int i = 0; i < path.depth; i++) {
+        bufMgr->readPage(this->file, path.pageNo[i], path.page[i]);
+    }
+    Page *leafPage;
+    bufMgr->readPage(this->file, leafNo, leafPage);
+    LeafNode<T> *leaf = (LeafNode<T> *) leafPage;
+    std::uint64_t version;
+    bool usable = OptimisticLatch::readLock(&leaf->header.version, version)
+            && structure == this->structureVersion
+            && leafHasRoom(leafPage, &newPair, 1)
+            && OptimisticLatch::upgradeToWriteLock(&leaf->header.version, version);
+    if (usable && !enterCountUpdate(structure)) {
+        OptimisticLatch::writeUnlock(&leaf->header.version);
+        usable = false;
+    }
+    if (!usable) {
+        bufMgr->unPinPage(this->file, leafNo, false);
+        releasePath(&path, false);
+        return false;
+    }
+
+    addToPathCounts<T>(path, 1);
+    insertLeaf(leaf, newPair);
+    OptimisticLatch::writeUnlock(&leaf->header.version);
+    leaveCountUpdate();
+    bufMgr->unPinPage(this->file, leafNo, true);
+    releasePath(&path, true);
+    return true;
+}
+
+template <class T>
+void BTreeIndex::setFinger(const PageId leafNo, const KeyRange<T> &range, const DescentPath &path,
+        const std::uint64_t structure)
+{
+    LeafFinger<T> &leafFinger = finger<T>();
+    std::uint64_t fingerVersion;
+    /// a range found while a split was running may already be out of date
+    if (structure % 2 == 1 || !OptimisticLatch::readLock(&leafFinger.version, fingerVersion)
+            || !OptimisticLatch::upgradeToWriteLock(&leafFinger.version, fingerVersion)) {
+        return;
+    }
+    leafFinger.leafNo = leafNo;
+    leafFinger.range = range;
+    leafFinger.path.depth = path.depth;
+    memcpy(leafFinger.path.pageNo, path.pageNo, path.depth * sizeof(PageId));
+    memcpy(leafFinger.path.child, path.child, path.depth * sizeof(int));
+    leafFinger.structureVersion = structure;
+    OptimisticLatch::writeUnlock(&leafFinger.version);
+}
+
+/**
+ *  This is the main helper function for the insertEntry function above. We created this function because we want to be able to make
+ *  recursive calls if necessary and make those calls easily manageable.
+ *  Must be called with structureLatch held, so non-leaf nodes can be read without their latch: no other thread changes them.
+ *  Every node is write locked before it is changed. If currPage had to be split, newChild is set to a heap allocated pair
+ *  holding the new right page and its separator key, which the caller must insert into the parent and delete, and currPage
+ *  is returned still locked and pinned: the caller unlocks and unpins it once the parent links the new page, so no reader
+ *  can reach the split node through a parent that does not know about its new sibling. Otherwise currPage is unpinned.
+ *
+ * @param currPage : the current page we're dealing with, a leaf or non-leaf as told by its NodeHeader
+ * @param currPageNo : the page number of the page in question
+ * @param newPair : the RIDKeyPair corresponding to the new child we're inserting
+ * @param newChild : the PageKeyPair corresponding to the new child we're inserting
+ * @param rightmost : true if currPage is the last node of its level, where appends split unevenly
+ */
+template <class T>
+void BTreeIndex::insertHelper(Page *currPage, PageId currPageNo, const RIDKeyPair<T> newPair, PageKeyPair<T> *&newChild,
+        const bool rightmost)
+{
+    NonLeafNode<T> *currNode = (NonLeafNode<T> *)currPage;
+    Page *nextPage;
+    PageId nextNodeNo;
+    // case when we're about to insert at a leaf
+    if (isLeaf(currPage)) {
+      LeafNode<T> *leaf = (LeafNode<T> *)currPage;
+      // leaves also take inserts that are not holding structureLatch
+      lockNode(&leaf->header.version);
+      // a full leaf first moves long runs of one key to posting lists, which may leave it room
+      if (!leafHasRoom(currPage, &newPair, 1) && usesPostings()) {
+        leaf->header.keyCount = (int) makePostings(leaf->keyArray, leaf->ridArray, leaf->header.keyCount);
+      }
+      // if we have space at a certain existing leaf to insert the child, we do it straight away
+      if (leafHasRoom(currPage, &newPair, 1)) {
+        insertLeaf(leaf, newPair);
+        unlockNode(&leaf->header.version);
+        bufMgr->unPinPage(this->file, currPageNo, true);
+        newChild = NULL;
+      } // a leaf of a packed index is written again, repacked or split
+      else if (this->leafFormat == PACKED_LEAVES) {
+        repackLeaf(currPage, currPageNo, newPair, newChild);
+      } // otherwise, we create a new leaf before inserting the new child
+      else {
+          // step 1: create a new page and allocate it to buffer
+          PageId newPageNum;
+          Page *newPage;
+          allocNode(newPageNum, newPage);
+          LeafNode<T> *newLeafNode = initLeaf<T>(newPage);
+
+          // step 2: find the point at which any shifts will be necessary. We start at the midpoint, unless the
+          // new key goes past the end of the last leaf: then keys are most likely arriving in increasing order and
+          // most of them stay here, so the leaf is not left half empty for good
+          int size = this->leafOccupancy;
+          int midpoint = size / 2;
+          if (leaf->rightSibPageNo == 0 && newPair.key > leaf->keyArray[size - 1]) {
+              midpoint = appendSplitPoint(size + 1);
+          }
+          else if (size % 2 == 1 && newPair.key > leaf->keyArray[midpoint]) {
+              midpoint++;
+          }
+          // step 3: we transfer the upper half of the existing key and RID entries into newLeafNode
+          int moved = size - midpoint;
+          moveEntries(newLeafNode, 0, leaf, midpoint, moved);
+          newLeafNode->header.keyCount = moved;
+          leaf->header.keyCount = midpoint;
+
+          // step 4: perform actual inserting. If we have to insert beyond the midpoint..
+          if (newPair.key > leaf->keyArray[midpoint - 1]) {
+              // pass newLeafNode
+            insertLeaf(newLeafNode, newPair);
+          }
+          else {
+              // otherwise, pass leaf
+            insertLeaf(leaf, newPair);
+          }
+
+          // step 5: make necessary changes to sibling pointer upon insertion of new child
+          newLeafNode->rightSibPageNo = leaf->rightSibPageNo;
+          leaf->rightSibPageNo = newPageNum;
+
+          // step 6: specify new child entry
+          newChild = new PageKeyPair<T>();
+          newChild->set(newPageNum, newLeafNode->keyArray[0]);
+
+          // step 7: unpin the new leaf, the caller releases this one
+          bufMgr->unPinPage(this->file, newPageNum, true);
+      }
+    }
+    // case when we're about to insert anywhere but a leaf
+    else {
+        // now, we search for the next node down: the child left of the first key not less than the new key
+        int numKeys = currNode->header.keyCount;
+        int nextIdx = lowerBound(currNode->keyArray, numKeys, newPair.key);
+
+        // assign the newly found index of the next non leaf node to the nextNodeNo variable
+        nextNodeNo = currNode->pageNoArray[nextIdx];
+
+        bufMgr->readPage(this->file, nextNodeNo, nextPage);
+
+        // recursive call to insert function with updated values of the variables
+        insertHelper(nextPage, nextNodeNo, newPair, newChild, rightmost && nextIdx == numKeys);
+
+        // the child holds one more entry, which the split, if any, shares between it and its new sibling
+        std::uint64_t total = currNode->countArray[nextIdx] + 1;
+
+        // if the child points to NULL and there is no split...
+        if (newChild == NULL)
+        {
+            // ... we count the new entry and unpin the current page from the buffer
+            currNode->countArray[nextIdx] = total;
+            bufMgr->unPinPage(this->file, currPageNo, true);
+        } // split is needed
+        else if (numKeys < KeyTraits<T>::NONLEAF_SIZE)
+        {
+            // if there is a free slot in this non leaf node we insert the new child there, then release the split child
+            // and the current page
+            lockNode(&currNode->header.version);
+            std::uint64_t kept = nodeEntries<T>(nextPage);
+            insertNonLeaf(currNode, newChild, nextIdx, kept, total - kept);
+            delete newChild;
+            newChild = NULL;
+            unlockNode(&((NodeHeader *) nextPage)->version);
+            bufMgr->unPinPage(this->file, nextNodeNo, true);
+            unlockNode(&currNode->header.version);
+            bufMgr->unPinPage(this->file, currPageNo, true);
+        }
+        // otherwise, we will have to create a new non leaf node
+        else
+        {
+            lockNode(&currNode->header.version);
+            PageId newPageNum;
+            Page *newPage;
+            allocNode(newPageNum, newPage);
+            NonLeafNode<T> *newNode = initNonLeaf<T>(newPage, currNode->header.level);
+
+            // step 1: lay out the full node plus the new child, right after the child it was split from
+            T keys[KeyTraits<T>::NONLEAF_SIZE + 1];
+            PageId pages[KeyTraits<T>::NONLEAF_SIZE + 2];
+            std::uint64_t counts[KeyTraits<T>::NONLEAF_SIZE + 2];
+            int pos = nextIdx;
+
+            memcpy(keys, currNode->keyArray, pos * sizeof(T));
+            keys[pos] = newChild->key;
+            memcpy(&keys[pos + 1], &currNode->keyArray[pos], (numKeys - pos) * sizeof(T));
+
+            memcpy(pages, currNode->pageNoArray, (pos + 1) * sizeof(PageId));
+            pages[pos + 1] = newChild->pageNo;
+            memcpy(&pages[pos + 2], &currNode->pageNoArray[pos + 1], (numKeys - pos) * sizeof(PageId));
+
+            memcpy(counts, currNode->countArray, pos * sizeof(std::uint64_t));
+            counts[pos] = nodeEntries<T>(nextPage);
+            counts[pos + 1] = total - counts[pos];
+            memcpy(&counts[pos + 2], &currNode->countArray[pos + 1], (numKeys - pos) * sizeof(std::uint64_t));
+
+            // step 2: the middle key moves up to the parent, the keys left of it stay here and the ones right of it
+            // move to the new node along with their children. Appends to the last node of the level split unevenly,
+            // as they do for leaves
+            int total = numKeys + 1;
+            int midpoint = (rightmost && pos == numKeys) ? appendSplitPoint(total) : total / 2;
+            int rightKeys = total - midpoint - 1;
+
+            memcpy(currNode->keyArray, keys, midpoint * sizeof(T));
+            memcpy(currNode->pageNoArray, pages, (midpoint + 1) * sizeof(PageId));
+            memcpy(currNode->countArray, counts, (midpoint + 1) * sizeof(std::uint64_t));
+            currNode->header.keyCount = midpoint;
+
+            memcpy(newNode->keyArray, &keys[midpoint + 1], rightKeys * sizeof(T));
+            memcpy(newNode->pageNoArray, &pages[midpoint + 1], (rightKeys + 1) * sizeof(PageId));
+            memcpy(newNode->countArray, &counts[midpoint + 1], (rightKeys + 1) * sizeof(std::uint64_t));
+            newNode->header.keyCount = rightKeys;
+
+            // step 3: hand the separator and the new node up to the parent
+            newChild->set(newPageNum, keys[midpoint]);
+
+            // release the split child and the new node, the caller releases this one
+            unlockNode(&((NodeHeader *) nextPage)->version);
+            bufMgr->unPinPage(file, nextNodeNo, true);
+            bufMgr->unPinPage(file, newPageNum, true);
+        }
+    }
+}
+
+
+int BTreeIndex::appendSplitPoint(const int total) const
+{
+    int keep = (int) (total * this->appendSplitRatio);
+    return std::min(std::max(keep, total / 2), total - 1);
+}
+
+
+/**
+ * This is a secondary helper function that we created to modify the tree's data as we intend to inser a new root into the page.
+ * In an instance as such, we'll hace to create a new root, update the metadata, and change the page number of the root
+ * to know how to reference this new root.
+ *
+ * @param pageId : The page number of the root
+ * @param newChild : PageKeyPair corresponding to the child we're trying to insert in the root
+ * @param level : level of the new root, one above the old one
+ */
+template <class T>
+void BTreeIndex::rootMods(PageId pageId, PageKeyPair<T> *newChild, int level)
+{
+  // step 1: in order to split, first we create a new root
+  PageId newRootNum;
+  Page *newRoot;
+  allocNode(newRootNum, newRoot);
+  NonLeafNode<T> *pageNew = initNonLeaf<T>(newRoot, level);
+
+  // step 2: the new root has the old root and its new sibling as its two children
+    pageNew->keyArray[0] = newChild->key;
+    pageNew->pageNoArray[0] = pageId;
+    pageNew->pageNoArray[1] = newChild->pageNo;
+    pageNew->countArray[0] = subtreeCount<T>(pageId);
+    pageNew->countArray[1] = subtreeCount<T>(newChild->pageNo);
+    pageNew->header.keyCount = 1;
+
+
+  // step 3: getting the new meta info to change the rootPageNum and rootPageNo values in the metadata itself
+  Page *meta;
+  bufMgr->readPage(file, headerPageNum, meta);
+  IndexMetaInfo *newMetaInfo = (IndexMetaInfo *) meta;
+
+  // step 4: change the page number of the root in the metadata to that of the new root
+  this->rootPageNum = newRootNum;
+  newMetaInfo->rootPageNo = newRootNum;
+
+  // step 5: unpin pages in question
+  bufMgr->unPinPage(file, headerPageNum, true);
+  bufMgr->unPinPage(file, newRootNum, true);
+}
+
+/**
+ * This is a secondary helper function we created to perform the actual insertion process into the tree.
+ * In this case, we're inserting into a leaf of the tree, which must have a free slot.
+ *
+ * @param leaf : the pointer to the leaf node we're inserting the child to
+ * @param newPair : The RIDKeyPair that corresponds to the new child we're about to insert
+ */
+template <class T>
+void BTreeIndex::insertLeaf(LeafNode<T> *leaf, RIDKeyPair<T> newPair)
+{
+  if (PackedLeaf<T>::is((Page *) leaf)) {
+    PackedLeaf<T>::merge((Page *) leaf, &newPair, 1);
+    return;
+  }
+  int size = leaf->header.keyCount;
+
+  // 1) finding the slot: after every key that is less than or equal to the new one
+  int pos = upperBound(leaf->keyArray, size, newPair.key);
+
+  // 2) shifting the rest of the leaf to make space for the new child
+  moveEntries(leaf, pos + 1, leaf, pos, size - pos);
+
+  // 3) putting the new child in the leaf
+  setEntry(leaf, pos, newPair);
+  leaf->header.keyCount = size + 1;
+}
+
+/**
+ * Copies the key, the record id and, for a covering index, the INCLUDE bytes of the pair.
+ */
+template <class T>
+void BTreeIndex::setEntry(LeafNode<T> *leaf, const int i, const RIDKeyPair<T> &pair)
+{
+    leaf->keyArray[i] = pair.key;
+    leaf->ridArray[i] = pair.rid;
+    if (includeSize > 0) {
+        memcpy(includeAt(leaf, i), pair.include, includeSize);
+    }
+}
+
+template <class T>
+void BTreeIndex::moveEntries(LeafNode<T> *dst, const int to, LeafNode<T> *src, const int from, const int n)
+{
+    memmove(&dst->keyArray[to], &src->keyArray[from], n * sizeof(T));
+    memmove(&dst->ridArray[to], &src->ridArray[from], n * sizeof(RecordId));
+    if (includeSize > 0) {
+        memmove(includeAt(dst, to), includeAt(src, from), n * includeSize);
+    }
+}
+
+template <class T>
+void BTreeIndex::mergeIntoLeaf(LeafNode<T> *leaf, const RIDKeyPair<T> *run, const size_t count)
+{
+    if (PackedLeaf<T>::is((Page *) leaf)) {
+        PackedLeaf<T>::merge((Page *) leaf, run, count);
+        return;
+    }
+    int i = leaf->header.keyCount - 1;
+    int j = count - 1;
+    for (int w = leaf->header.keyCount + count - 1; j >= 0; w--) {
+        if (i >= 0 && run[j].key < leaf->keyArray[i]) {
+            leaf->keyArray[w] = leaf->keyArray[i];
+            leaf->ridArray[w] = leaf->ridArray[i];
+            if (includeSize > 0) {
+                memcpy(includeAt(leaf, w), includeAt(leaf, i), includeSize);
+            }
+            i--;
+        }
+        else {
+            setEntry(leaf, w, run[j]);
+            j--;
+        }
+    }
+    leaf->header.keyCount += count;
+}
+
+template <class T>
+bool BTreeIndex::leafHasRoom(const Page *page, const RIDKeyPair<T> *run, const size_t count) const
+{
+    if (PackedLeaf<T>::is(page)) {
+        return PackedLeaf<T>::fits(page, run, count);
+    }
+    return (size_t) leafSize<T>(page, this->leafOccupancy) + count <= (size_t) this->leafOccupancy;
+}
+
+template <class T>
+bool BTreeIndex::fitsLeaf(const T *keys, const RecordId *rids, const int n) const
+{
+    return n <= this->leafOccupancy
+            || (this->leafFormat == PACKED_LEAVES && PackedLeaf<T>::run(keys, rids, n) == n);
+}
+
+/**
+ * In a packed index the entries are packed whenever they can be, and fall back to a plain leaf otherwise. The
+ * version and right sibling of the page are kept.
+ */
+template <class T>
+void BTreeIndex::writeLeaf(Page *page, const T *keys, const RecordId *rids, const int n)
+{
+    if (this->leafFormat == PACKED_LEAVES && PackedLeaf<T>::run(keys, rids, n) == n) {
+        PackedLeaf<T>::write(page, keys, rids, n);
+        return;
+    }
+    LeafNode<T> *leaf = (LeafNode<T> *) page;
+    leaf->header.nodeType = LEAF_NODE;
+    leaf->header.level = 0;
+    memcpy(leaf->keyArray, keys, n * sizeof(T));
+    memcpy(leaf->ridArray, rids, n * sizeof(RecordId));
+    leaf->header.keyCount = n;
+}
+
+/**
+ * Inserts into a leaf of a packed index that has no room for the pair as it is. The entries and the pair are
+ * decoded and written back into the leaf if they fit once written again, as a packed leaf whose bases have moved or
+ * as a plain one. Otherwise the leaf is split like a plain one, each half packed if it packs. Called with the leaf
+ * write locked; it is released here unless the leaf was split, as insertHelper() does.
+ *
+ * @param page : the leaf, pinned and write locked
+ * @param pageNo : its page number
+ * @param newPair : the pair to insert
+ * @param newChild : set to the new right leaf and its separator if the leaf was split, NULL otherwise
+ */
+template <class T>
+void BTreeIndex::repackLeaf(Page *page, PageId pageNo, const RIDKeyPair<T> &newPair, PageKeyPair<T> *&newChild)
+{
+    int size = leafSize<T>(page, this->leafOccupancy);
+    int pos = leafUpperBound(page, size, newPair.key);
+    std::vector<T> keys(size + 1);
+    std::vector<RecordId> rids(size + 1);
+    leafEntries(page, 0, pos, keys.data(), rids.data());
+    keys[pos] = newPair.key;
+    rids[pos] = newPair.rid;
+    leafEntries(page, pos, size - pos, keys.data() + pos + 1, rids.data() + pos + 1);
+
+    int total = size + 1;
+    LeafNode<T> *leaf = (LeafNode<T> *) page;
+    if (fitsLeaf(keys.data(), rids.data(), total)) {
+        writeLeaf(page, keys.data(), rids.data(), total);
+        unlockNode(&leaf->header.version);
+        bufMgr->unPinPage(this->file, pageNo, true);
+        newChild = NULL;
+        return;
+    }
+
+    // as in insertHelper(), keys arriving past the end of the last leaf mostly stay where they are
+    int keep = total / 2;
+    if (leaf->rightSibPageNo == 0 && pos == size) {
+        int append = appendSplitPoint(total);
+        if (fitsLeaf(keys.data(), rids.data(), append)
+                && fitsLeaf(keys.data() + append, rids.data() + append, total - append)) {
+            keep = append;
+        }
+    }
+
+    PageId newPageNum;
+    Page *newPage;
+    allocNode(newPageNum, newPage);
+    LeafNode<T> *newLeafNode = initLeaf<T>(newPage);
+    writeLeaf(page, keys.data(), rids.data(), keep);
+    writeLeaf(newPage, keys.data() + keep, rids.data() + keep, total - keep);
+    newLeafNode->rightSibPageNo = leaf->rightSibPageNo;
+    leaf->rightSibPageNo = newPageNum;
+
+    newChild = new PageKeyPair<T>();
+    newChild->set(newPageNum, keys[keep]);
+    bufMgr->unPinPage(this->file, newPageNum, true);
+}
+
+void BTreeIndex::loadIncludes(const char *record, char *out) const
+{
+    for (size_t i = 0; i < includeColumns.size(); i++) {
+        memcpy(out, record + includeColumns[i].byteOffset, includeColumns[i].size);
+        out += includeColumns[i].size;
+    }
+}
+
+/**
+ * This is a secondary helper function we created to perform the actual insertion process into the tree.
+ * In this case, we're inserting into a non leaf of the tree, which must have a free slot.
+ *
  * @param nonLeaf : the pointer to the leaf node we're inserting the child to
  * @param currentChild : The RIDKeyPair that corresponds to the current child we're about to insert
+ * @param child : index of the child currentChild was split from
+ * @param childCount : number of entries left under that child
+ * @param newCount : number of entries under currentChild
+ */
+template <class T>
+void BTreeIndex::insertNonLeaf(NonLeafNode<T> *nonLeaf, PageKeyPair<T> *currentChild, const int child,
+        const std::uint64_t childCount, const std::uint64_t newCount)
+{
+  int numKeys = nonLeaf->header.keyCount;
+
+  // 1) finding the slot: right after the child that was split. Searching for the key instead would put it after
+  // every separator equal to it, past other children when a run of duplicates spans several of them
+  int pos = child;
+
+  // 2) shifting the rest of the node to make space for the new child
+  memmove(&nonLeaf->keyArray[pos + 1], &nonLeaf->keyArray[pos], (numKeys - pos) * sizeof(T));
+  memmove(&nonLeaf->pageNoArray[pos + 2], &nonLeaf->pageNoArray[pos + 1], (numKeys - pos) * sizeof(PageId));
+  memmove(&nonLeaf->countArray[pos + 2], &nonLeaf->countArray[pos + 1], (numKeys - pos) * sizeof(std::uint64_t));
+
+  // 3) putting the new child in the tree
+  nonLeaf->keyArray[pos] = currentChild->key;
+  nonLeaf->pageNoArray[pos + 1] = currentChild->pageNo;
+  nonLeaf->countArray[pos] = childCount;
+  nonLeaf->countArray[pos + 1] = newCount;
+  nonLeaf->header.keyCount = numKeys + 1;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntries
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertEntries(const void *keys, const RecordId *rids, size_t n, const void *includes)
+{
+    if (includeSize > 0 && includes == NULL) {
+        throw BadIndexInfoException("index has INCLUDE columns, but no INCLUDE bytes were given");
+    }
+    (this->*insertEntriesFn)(keys, rids, n, includeSize > 0 ? (const char *) includes : NULL);
+}
+
+/**
+ * Runs that fit in their leaf are merged into it under the leaf's latch alone, like insertOptimistic() does for
+ * single keys. A run that does not fit takes structureLatch and goes through insertRunHelper().
+ */
+template <class T>
+void BTreeIndex::insertEntriesTyped(const void *keys, const RecordId *rids, size_t n, const char *includes)
+{
+    std::vector< RIDKeyPair<T> > pairs(n);
+    for (size_t i = 0; i < n; i++) {
+        pairs[i].set(rids[i], KeyTraits<T>::load((const char *) keys + i * sizeof(T)),
+                includes != NULL ? includes + i * includeSize : NULL);
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    size_t pos = 0;
+    while (pos < n) {
+        // step 1: find the leaf of the next key, and the run of keys after it that belong in the same leaf
+        PageId leafNo;
+        Page *leafPage;
+        std::uint64_t version;
+        std::uint64_t structure = this->structureVersion;
+        if (structure % 2 == 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        KeyRange<T> range;
+        range.hasLow = false;
+        range.hasHigh = false;
+        DescentPath path;
+        if (!findLeafOptimistic(pairs[pos].key, leafNo, leafPage, version, &range, &path)) {
+            continue;
+        }
+        size_t count = range.hasHigh ? runUpTo(&pairs[pos], n - pos, range.high) : n - pos;
+
+        // step 2: merge the run into the leaf if it fits
+        LeafNode<T> *leaf = (LeafNode<T> *) leafPage;
+        bool fits = leafHasRoom(leafPage, &pairs[pos], count);
+        if (!OptimisticLatch::validate(&leaf->header.version, version)) {
+            bufMgr->unPinPage(this->file, leafNo, false);
+            releasePath(&path, false);
+            continue;
+        }
+        if (fits) {
+            if (!OptimisticLatch::upgradeToWriteLock(&leaf->header.version, version)) {
+                bufMgr->unPinPage(this->file, leafNo, false);
+                releasePath(&path, false);
+                continue;
+            }
+            if (!enterCountUpdate(structure)) {
+                OptimisticLatch::writeUnlock(&leaf->header.version);
+                bufMgr->unPinPage(this->file, leafNo, false);
+                releasePath(&path, false);
+                continue;
+            }
+            addToPathCounts<T>(path, count);
+            mergeIntoLeaf(leaf, &pairs[pos], count);
+            OptimisticLatch::writeUnlock(&leaf->header.version);
+            leaveCountUpdate();
+            bufMgr->unPinPage(this->file, leafNo, true);
+            releasePath(&path, true);
+            pos += count;
+            continue;
+        }
+        bufMgr->unPinPage(this->file, leafNo, false);
+        releasePath(&path, false);
+
+        // step 3: otherwise split the leaf into as many leaves as the run needs, and their parents likewise
+        std::lock_guard<std::mutex> guard(this->structureLatch);
+        StructureChange change(*this);
+        PageId rootNo = this->rootPageNum;
+        Page *root;
+        bufMgr->readPage(this->file, rootNo, root);
+        int rootLevel = ((NodeHeader *) root)->level;
+        std::vector< PageKeyPair<T> > newChildren;
+        pos += insertRunHelper<T>(root, rootNo, &pairs[pos], n - pos, newChildren, true);
+
+        // step 4: a root that was split gets as many levels above it as its new siblings need
+        if (!newChildren.empty()) {
+            std::vector< PageKeyPair<T> > level(1);
+            level[0].set(rootNo, T());
+            level.insert(level.end(), newChildren.begin(), newChildren.end());
+            std::vector<std::uint64_t> counts(1, nodeEntries<T>(root));
+            for (size_t k = 0; k < newChildren.size(); k++) {
+                counts.push_back(subtreeCount<T>(newChildren[k].pageNo));
+            }
+            buildUpperLevels(level, counts, rootLevel + 1, KeyTraits<T>::NONLEAF_SIZE + 1);
+            unlockNode(&((NodeHeader *) root)->version);
+            bufMgr->unPinPage(this->file, rootNo, true);
+        }
+    }
+}
+
+template <class T>
+size_t BTreeIndex::insertRunHelper(Page *currPage, PageId currPageNo, const RIDKeyPair<T> *run, size_t count,
+        std::vector< PageKeyPair<T> > &newChildren, const bool rightmost)
+{
+    if (isLeaf(currPage)) {
+        LeafNode<T> *leaf = (LeafNode<T> *) currPage;
+        lockNode(&leaf->header.version);
+        int size = leaf->header.keyCount;
+        if (leafHasRoom(currPage, run, count)) {
+            mergeIntoLeaf(leaf, run, count);
+            unlockNode(&leaf->header.version);
+            bufMgr->unPinPage(this->file, currPageNo, true);
+            return count;
+        }
+
+        // step 1: merge the leaf's entries with the run, the leaf's first on equal keys. A packed leaf is decoded
+        const T *leafKeys = leaf->keyArray;
+        const RecordId *leafRids = leaf->ridArray;
+        std::vector<T> packedKeys;
+        std::vector<RecordId> packedRids;
+        if (PackedLeaf<T>::is(currPage)) {
+            packedKeys.resize(size);
+            packedRids.resize(size);
+            leafEntries(currPage, 0, size, packedKeys.data(), packedRids.data());
+            leafKeys = packedKeys.data();
+            leafRids = packedRids.data();
+        }
+        int total = size + count;
+        std::vector<T> keys(total);
+        std::vector<RecordId> rids(total);
+        std::vector<char> includes(total * includeSize);
+        int i = 0;
+        size_t j = 0;
+        for (int w = 0; w < total; w++) {
+            if (j == count || (i < size && !(run[j].key < leafKeys[i]))) {
+                keys[w] = leafKeys[i];
+                rids[w] = leafRids[i];
+                if (includeSize > 0) {
+                    memcpy(&includes[w * includeSize], includeAt(leaf, i), includeSize);
+                }
+                i++;
+            }
+            else {
+                keys[w] = run[j].key;
+                rids[w] = run[j].rid;
+                if (includeSize > 0) {
+                    memcpy(&includes[w * includeSize], run[j].include, includeSize);
+                }
+                j++;
+            }
+        }
+
+        // step 2: long runs of one key go to posting lists, which may make everything fit in the leaf after all, as
+        // may packing a leaf of a packed index again
+        if (usesPostings()) {
+            total = (int) makePostings(&keys[0], &rids[0], total);
+        }
+        if (includeSize == 0 && fitsLeaf(&keys[0], &rids[0], total)) {
+            writeLeaf(currPage, &keys[0], &rids[0], total);
+            unlockNode(&leaf->header.version);
+            bufMgr->unPinPage(this->file, currPageNo, true);
+            return count;
+        }
+
+        // step 3: the first piece stays in this leaf, the others go to new leaves linked in after it. A packed index
+        // cuts pieces as large as packed leaves hold, unless some piece would not pack
+        bool append = leaf->rightSibPageNo == 0 && (size == 0 || leafKeys[size - 1] < run[0].key);
+        std::vector<int> sizes;
+        if (this->leafFormat == PACKED_LEAVES) {
+            sizes = pieceSizes(total, PackedLeaf<T>::capacity(&keys[0], total), append);
+            bool packs = true;
+            for (size_t p = 0, start = 0; p < sizes.size() && packs; start += sizes[p], p++) {
+                packs = fitsLeaf(&keys[start], &rids[start], sizes[p]);
+            }
+            if (!packs) {
+                sizes.clear();
+            }
+        }
+        if (sizes.empty()) {
+            sizes = pieceSizes(total, this->leafOccupancy, append);
+        }
+        PageId nextSibling = leaf->rightSibPageNo;
+        LeafNode<T> *prev = leaf;
+        PageId prevNo = currPageNo;
+        int pos = 0;
+        for (size_t p = 0; p < sizes.size(); p++) {
+            LeafNode<T> *piece = leaf;
+            if (p > 0) {
+                PageId pieceNo;
+                Page *piecePage;
+                allocNode(pieceNo, piecePage);
+                piece = initLeaf<T>(piecePage);
+                prev->rightSibPageNo = pieceNo;
+                if (prev != leaf) {
+                    bufMgr->unPinPage(this->file, prevNo, true);
+                }
+                prev = piece;
+                prevNo = pieceNo;
+
+                PageKeyPair<T> child;
+                child.set(pieceNo, keys[pos]);
+                newChildren.push_back(child);
+            }
+            if (includeSize == 0) {
+                writeLeaf((Page *) piece, &keys[pos], &rids[pos], sizes[p]);
+            }
+            else {
+                memcpy(piece->keyArray, &keys[pos], sizes[p] * sizeof(T));
+                memcpy(piece->ridArray, &rids[pos], sizes[p] * sizeof(RecordId));
+                memcpy(includeAt(piece, 0), &includes[pos * includeSize], sizes[p] * includeSize);
+                piece->header.keyCount = sizes[p];
+            }
+            pos += sizes[p];
+        }
+        prev->rightSibPageNo = nextSibling;
+        if (prev != leaf) {
+            bufMgr->unPinPage(this->file, prevNo, true);
+        }
+        return count;
+    }
+
+    // only the part of the run that belongs under the child of its first key goes down
+    NonLeafNode<T> *currNode = (NonLeafNode<T> *) currPage;
+    int numKeys = currNode->header.keyCount;
+    int idx = lowerBound(currNode->keyArray, numKeys, run[0].key);
+    if (idx < numKeys) {
+        count = runUpTo(run, count, currNode->keyArray[idx]);
+    }
+
+    PageId childNo = currNode->pageNoArray[idx];
+    Page *childPage;
+    bufMgr->readPage(this->file, childNo, childPage);
+    std::vector< PageKeyPair<T> > childSplits;
+    count = insertRunHelper(childPage, childNo, run, count, childSplits, rightmost && idx == numKeys);
+    if (childSplits.empty()) {
+        currNode->countArray[idx] += count;
+        bufMgr->unPinPage(this->file, currPageNo, true);
+        return count;
+    }
+
+    // entries under the split child and each node split off it
+    std::vector<std::uint64_t> splitCounts(1, nodeEntries<T>(childPage));
+    for (size_t k = 0; k < childSplits.size(); k++) {
+        splitCounts.push_back(subtreeCount<T>(childSplits[k].pageNo));
+    }
+
+    lockNode(&currNode->header.version);
+    int added = childSplits.size();
+    if (numKeys + added <= KeyTraits<T>::NONLEAF_SIZE) {
+        // the new children go right after the child they were split from
+        memmove(&currNode->keyArray[idx + added], &currNode->keyArray[idx], (numKeys - idx) * sizeof(T));
+        memmove(&currNode->pageNoArray[idx + 1 + added], &currNode->pageNoArray[idx + 1], (numKeys - idx) * sizeof(PageId));
+        memmove(&currNode->countArray[idx + 1 + added], &currNode->countArray[idx + 1],
+                (numKeys - idx) * sizeof(std::uint64_t));
+        currNode->countArray[idx] = splitCounts[0];
+        for (int k = 0; k < added; k++) {
+            currNode->keyArray[idx + k] = childSplits[k].key;
+            currNode->pageNoArray[idx + 1 + k] = childSplits[k].pageNo;
+            currNode->countArray[idx + 1 + k] = splitCounts[k + 1];
+        }
+        currNode->header.keyCount = numKeys + added;
+
+        unlockNode(&((NodeHeader *) childPage)->version);
+        bufMgr->unPinPage(this->file, childNo, true);
+        unlockNode(&currNode->header.version);
+        bufMgr->unPinPage(this->file, currPageNo, true);
+        return count;
+    }
+
+    // step 1: lay out the node's children with the new ones in place
+    std::vector<T> keys(currNode->keyArray, currNode->keyArray + idx);
+    std::vector<PageId> pages(currNode->pageNoArray, currNode->pageNoArray + idx + 1);
+    std::vector<std::uint64_t> counts(currNode->countArray, currNode->countArray + idx);
+    counts.insert(counts.end(), splitCounts.begin(), splitCounts.end());
+    for (int k = 0; k < added; k++) {
+        keys.push_back(childSplits[k].key);
+        pages.push_back(childSplits[k].pageNo);
+    }
+    keys.insert(keys.end(), currNode->keyArray + idx, currNode->keyArray + numKeys);
+    pages.insert(pages.end(), currNode->pageNoArray + idx + 1, currNode->pageNoArray + numKeys + 1);
+    counts.insert(counts.end(), currNode->countArray + idx + 1, currNode->countArray + numKeys + 1);
+
+    // step 2: cut the children into pieces; the key between two pieces moves up to the parent
+    std::vector<int> sizes = pieceSizes(pages.size(), KeyTraits<T>::NONLEAF_SIZE + 1, rightmost && idx == numKeys);
+    int pos = 0;
+    for (size_t p = 0; p < sizes.size(); p++) {
+        NonLeafNode<T> *piece = currNode;
+        PageId pieceNo = currPageNo;
+        if (p > 0) {
+            Page *piecePage;
+            allocNode(pieceNo, piecePage);
+            piece = initNonLeaf<T>(piecePage, currNode->header.level);
+
+            PageKeyPair<T> child;
+            child.set(pieceNo, keys[pos - 1]);
+            newChildren.push_back(child);
+        }
+        memcpy(piece->pageNoArray, &pages[pos], sizes[p] * sizeof(PageId));
+        memcpy(piece->countArray, &counts[pos], sizes[p] * sizeof(std::uint64_t));
+        if (sizes[p] > 1) {
+            memcpy(piece->keyArray, &keys[pos], (sizes[p] - 1) * sizeof(T));
+        }
+        piece->header.keyCount = sizes[p] - 1;
+        if (p > 0) {
+            bufMgr->unPinPage(this->file, pieceNo, true);
+        }
+        pos += sizes[p];
+    }
+
+    // release the split child, the caller releases this node
+    unlockNode(&((NodeHeader *) childPage)->version);
+    bufMgr->unPinPage(this->file, childNo, true);
+    return count;
+}
+
+std::vector<int> BTreeIndex::pieceSizes(const int total, const int capacity, const bool append) const
+{
+    std::vector<int> sizes;
+    if (append) {
+        int per = appendSplitPoint(capacity + 1);
+        for (int left = total; left > 0; left -= per) {
+            sizes.push_back(std::min(per, left));
+        }
+    }
+    else {
+        int pieces = (total + capacity - 1) / capacity;
+        for (int p = 0; p < pieces; p++) {
+            sizes.push_back(total / pieces + (p < total % pieces ? 1 : 0));
+        }
+    }
+    return sizes;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntry
+// -----------------------------------------------------------------------------
+
+/**
+ * Index of the entry <pair.key, pair.rid> among the first size entries of a leaf, or -1 if it is not there as an
+ * entry of its own; it may still be in a posting list between start and end.
+ *
+ * @param start : set to the index of the first key equal to pair.key
+ * @param end : set to the index just past the keys equal to pair.key
+ */
+template <class T>
+static int findEntry(const Page *leaf, const int size, const RIDKeyPair<T> &pair, int &start, int &end)
+{
+    start = leafLowerBound(leaf, size, pair.key);
+    end = leafUpperBound(leaf, size, pair.key);
+    for (int pos = start; pos < end; pos++) {
+        RecordId rid = leafRid<T>(leaf, pos);
+        if (rid.page_number == pair.rid.page_number && rid.slot_number == pair.rid.slot_number) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+template <class T>
+void BTreeIndex::removeFromLeaf(LeafNode<T> *leaf, const int pos)
+{
+    if (PackedLeaf<T>::is((Page *) leaf)) {
+        PackedLeaf<T>::remove((Page *) leaf, pos);
+        return;
+    }
+    int size = leaf->header.keyCount;
+    moveEntries(leaf, pos, leaf, pos + 1, size - pos - 1);
+    leaf->header.keyCount = size - 1;
+}
+
+/**
+ * Takes key pos and the page right of it out of a non-leaf node, as when that page is merged into its left neighbour.
+ */
+template <class T>
+static void removeFromNonLeaf(NonLeafNode<T> *node, const int pos)
+{
+    int numKeys = node->header.keyCount;
+    memmove(&node->keyArray[pos], &node->keyArray[pos + 1], (numKeys - pos - 1) * sizeof(T));
+    memmove(&node->pageNoArray[pos + 1], &node->pageNoArray[pos + 2], (numKeys - pos - 1) * sizeof(PageId));
+    memmove(&node->countArray[pos + 1], &node->countArray[pos + 2], (numKeys - pos - 1) * sizeof(std::uint64_t));
+    node->header.keyCount = numKeys - 1;
+}
+
+/**
+ * This method deletes the entry <key, rid> from the index.
+ *
+ * @param key :  A pointer to the value (integer, double or string) of the entry.
+ * @param rid : The record id of the entry.
+ */
+bool BTreeIndex::deleteEntry(const void *key, const RecordId rid)
+{
+    return (this->*deleteEntryFn)(key, rid);
+}
+
+/**
+ * deleteEntry() for keys of type T.
+ */
+template <class T>
+bool BTreeIndex::deleteEntryTyped(const void *key, const RecordId rid)
+{
+    RIDKeyPair<T> pair;
+    pair.set(rid, KeyTraits<T>::load(key));
+
+    // no record has the slot number that marks a posting list
+    if (isPosting(rid)) {
+        return false;
+    }
+
+    // most deletes leave their leaf well filled and only ever lock that leaf
+    DeleteResult result = deleteOptimistic(pair);
+    if (result != DELETE_STRUCTURAL) {
+        return result == DELETE_DONE;
+    }
+
+    // the leaf would underflow: merges are made one at a time, like splits
+    std::lock_guard<std::mutex> guard(this->structureLatch);
+    StructureChange change(*this);
+    PageId rootNo = this->rootPageNum;
+    Page *root;
+    bufMgr->readPage(this->file, rootNo, root);
+    bool underflow = false;
+    bool found = deleteHelper<T>(root, rootNo, pair, underflow);
+
+    // a non-leaf root left with a single child is replaced by that child, and the tree gets one level lower. The old
+    // root stays locked until rootPageNum points at the child, so no reader starts from it after that
+    bufMgr->readPage(this->file, rootNo, root);
+    NonLeafNode<T> *rootNode = (NonLeafNode<T> *) root;
+    if (!isLeaf(root) && rootNode->header.keyCount == 0) {
+        lockNode(&rootNode->header.version);
+        Page *meta;
+        bufMgr->readPage(this->file, this->headerPageNum, meta);
+        this->rootPageNum = rootNode->pageNoArray[0];
+        ((IndexMetaInfo *) meta)->rootPageNo = rootNode->pageNoArray[0];
+        bufMgr->unPinPage(this->file, this->headerPageNum, true);
+        freeNode(rootNo, root);
+    }
+    else {
+        bufMgr->unPinPage(this->file, rootNo, false);
+    }
+    return found;
+}
+
+/**
+ * Finds the entry optimistically, following right siblings while the run of equal keys goes on, and upgrades to a
+ * write lock on its leaf alone. The upgrade fails if the leaf changed since it was read, in which case the delete
+ * starts over from the root. A leaf that would be left underflowing is not touched, and neither is a sibling under
+ * another parent than the leaf the descent reached, since the entry counts to take the entry from are not on its path.
+ */
+template <class T>
+BTreeIndex::DeleteResult BTreeIndex::deleteOptimistic(const RIDKeyPair<T> &pair)
+{
+    while (true) {
+        PageId leafNo;
+        Page *leafPage;
+        std::uint64_t version;
+        std::uint64_t structure = this->structureVersion;
+        if (structure % 2 == 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        DescentPath path;
+        if (!findLeafOptimistic<T>(pair.key, leafNo, leafPage, version, NULL, &path)) {
+            continue;
+        }
+
+        while (true) {
+            LeafNode<T> *leaf = (LeafNode<T> *) leafPage;
+            int capacity = leafCapacity<T>(leafPage, this->leafOccupancy);
+            int size = leafSize<T>(leafPage, this->leafOccupancy);
+            int start;
+            int end;
+            int pos = findEntry(leafPage, size, pair, start, end);
+            bool posting = false;
+            for (int i = start; i < end && pos < 0 && !posting; i++) {
+                posting = isPosting(leafRid<T>(leafPage, i));
+            }
+            PageId sibling = leaf->rightSibPageNo;
+            if (!OptimisticLatch::validate(&leaf->header.version, version)) {
+                bufMgr->unPinPage(this->file, leafNo, false);
+                releasePath(&path, false);
+                break;
+            }
+
+            if (pos >= 0) {
+                /// the root has no neighbour to take entries from, and may run down to nothing
+                if (underflows(size - 1, capacity) && leafNo != this->rootPageNum) {
+                    bufMgr->unPinPage(this->file, leafNo, false);
+                    releasePath(&path, false);
+                    return DELETE_STRUCTURAL;
+                }
+                if (!OptimisticLatch::upgradeToWriteLock(&leaf->header.version, version)) {
+                    bufMgr->unPinPage(this->file, leafNo, false);
+                    releasePath(&path, false);
+                    break;
+                }
+                if (!enterCountUpdate(structure)) {
+                    OptimisticLatch::writeUnlock(&leaf->header.version);
+                    bufMgr->unPinPage(this->file, leafNo, false);
+                    releasePath(&path, false);
+                    break;
+                }
+                addToPathCounts<T>(path, -1);
+                removeFromLeaf(leaf, pos);
+                OptimisticLatch::writeUnlock(&leaf->header.version);
+                leaveCountUpdate();
+                bufMgr->unPinPage(this->file, leafNo, true);
+                releasePath(&path, true);
+                return DELETE_DONE;
+            }
+            /// a posting list may free its pages, which takes structureLatch
+            if (posting) {
+                bufMgr->unPinPage(this->file, leafNo, false);
+                releasePath(&path, false);
+                return DELETE_STRUCTURAL;
+            }
+            if (end < size || sibling == 0) {
+                bufMgr->unPinPage(this->file, leafNo, false);
+                releasePath(&path, false);
+                return DELETE_NOT_FOUND;
+            }
+
+            /// the sibling is the next child of the same parent, unless the leaf is its parent's last child. The parent
+            /// only changes when structureVersion does, which enterCountUpdate() checks before the path is used
+            NonLeafNode<T> *parent = path.depth > 0 ? (NonLeafNode<T> *) path.page[path.depth - 1] : NULL;
+            int next = path.depth > 0 ? path.child[path.depth - 1] + 1 : 0;
+            if (parent == NULL || next > std::min((int) parent->header.keyCount, KeyTraits<T>::NONLEAF_SIZE)
+                    || parent->pageNoArray[next] != sibling) {
+                bufMgr->unPinPage(this->file, leafNo, false);
+                releasePath(&path, false);
+                return DELETE_STRUCTURAL;
+            }
+            path.child[path.depth - 1] = next;
+
+            Page *sibPage;
+            std::uint64_t sibVersion;
+            bufMgr->readPage(this->file, sibling, sibPage);
+            bool valid = OptimisticLatch::readLock(&((NodeHeader *) sibPage)->version, sibVersion)
+                    && OptimisticLatch::validate(&leaf->header.version, version);
+            bufMgr->unPinPage(this->file, leafNo, false);
+            if (!valid) {
+                bufMgr->unPinPage(this->file, sibling, false);
+                releasePath(&path, false);
+                break;
+            }
+            leafNo = sibling;
+            leafPage = sibPage;
+            version = sibVersion;
+        }
+    }
+}
+
+/**
+ * Every child that may hold the key is tried in turn, since a run of equal keys can span several of them. Leaves are
+ * write locked before they are read, as optimistic inserts and deletes may be changing them; non-leaf nodes only
+ * change with structureLatch held.
+ */
+template <class T>
+bool BTreeIndex::deleteHelper(Page *currPage, PageId currPageNo, const RIDKeyPair<T> &pair, bool &underflow)
+{
+    if (isLeaf(currPage)) {
+        LeafNode<T> *leaf = (LeafNode<T> *) currPage;
+        lockNode(&leaf->header.version);
+        int start;
+        int end;
+        int pos = findEntry(currPage, leaf->header.keyCount, pair, start, end);
+        bool found = pos >= 0;
+        if (found) {
+            removeFromLeaf(leaf, pos);
+        }
+        /// packed leaves hold no posting lists
+        for (int i = start; i < end && !found && !PackedLeaf<T>::is(currPage); i++) {
+            found = isPosting(leaf->ridArray[i]) && removeFromPosting(leaf->ridArray[i], pair.rid);
+        }
+        underflow = underflows(leaf->header.keyCount, leafCapacity<T>(currPage, this->leafOccupancy));
+        unlockNode(&leaf->header.version);
+        bufMgr->unPinPage(this->file, currPageNo, found);
+        return found;
+    }
+
+    NonLeafNode<T> *currNode = (NonLeafNode<T> *) currPage;
+    int first = lowerBound(currNode->keyArray, currNode->header.keyCount, pair.key);
+    int last = upperBound(currNode->keyArray, currNode->header.keyCount, pair.key);
+    bool found = false;
+    bool dirty = false;
+    for (int i = first; i <= last && !found; i++) {
+        PageId childNo = currNode->pageNoArray[i];
+        Page *childPage;
+        bufMgr->readPage(this->file, childNo, childPage);
+        bool childUnderflow = false;
+        found = deleteHelper<T>(childPage, childNo, pair, childUnderflow);
+        if (found) {
+            currNode->countArray[i]--;
+            dirty = true;
+        }
+        if (found && childUnderflow) {
+            rebalanceChild<T>(currNode, i);
+        }
+    }
+    underflow = underflows(currNode->header.keyCount, KeyTraits<T>::NONLEAF_SIZE);
+    bufMgr->unPinPage(this->file, currPageNo, dirty);
+    return found;
+}
+
+/**
+ * The child is paired with its right neighbour, or with its left one if it is the last child. The parent and both
+ * nodes of the pair are write locked, in that order, for the whole change. Whatever is moved, the separator between
+ * the pair stays the first key under the right node.
+ */
+template <class T>
+void BTreeIndex::rebalanceChild(NonLeafNode<T> *node, const int child)
+{
+    // step 1: a node with a single child has no neighbour to pair it with; its own parent deals with it
+    int numKeys = node->header.keyCount;
+    if (numKeys == 0) {
+        return;
+    }
+    int left = (child == numKeys) ? child - 1 : child;
+    PageId leftNo = node->pageNoArray[left];
+    PageId rightNo = node->pageNoArray[left + 1];
+    Page *leftPage;
+    Page *rightPage;
+    bufMgr->readPage(this->file, leftNo, leftPage);
+    bufMgr->readPage(this->file, rightNo, rightPage);
+    lockNode(&node->header.version);
+    lockNode(&((NodeHeader *) leftPage)->version);
+    lockNode(&((NodeHeader *) rightPage)->version);
+    bool merged = false;
+
+    if (node->header.level == 1 && this->leafFormat == PACKED_LEAVES) {
+        rebalancePacked<T>(node, left, leftPage, rightPage, merged);
+    }
+    else if (node->header.level == 1) {
+        LeafNode<T> *leftLeaf = (LeafNode<T> *) leftPage;
+        LeafNode<T> *rightLeaf = (LeafNode<T> *) rightPage;
+        int a = leftLeaf->header.keyCount;
+        int b = rightLeaf->header.keyCount;
+
+        // step 2: both leaves fit in one: the right one is emptied into the left and leaves the tree
+        if (a + b <= this->leafOccupancy) {
+            moveEntries(leftLeaf, a, rightLeaf, 0, b);
+            leftLeaf->header.keyCount = a + b;
+            leftLeaf->rightSibPageNo = rightLeaf->rightSibPageNo;
+            node->countArray[left] = nodeEntries<T>(leftPage);
+            removeFromNonLeaf(node, left);
+            merged = true;
+        }
+        // step 3: otherwise entries move across until both hold about half
+        else if (a < b) {
+            int move = (a + b) / 2 - a;
+            moveEntries(leftLeaf, a, rightLeaf, 0, move);
+            moveEntries(rightLeaf, 0, rightLeaf, move, b - move);
+            leftLeaf->header.keyCount = a + move;
+            rightLeaf->header.keyCount = b - move;
+            node->keyArray[left] = rightLeaf->keyArray[0];
+            node->countArray[left] = nodeEntries<T>(leftPage);
+            node->countArray[left + 1] = nodeEntries<T>(rightPage);
+        }
+        else {
+            int move = a - (a + b) / 2;
+            moveEntries(rightLeaf, move, rightLeaf, 0, b);
+            moveEntries(rightLeaf, 0, leftLeaf, a - move, move);
+            leftLeaf->header.keyCount = a - move;
+            rightLeaf->header.keyCount = b + move;
+            node->keyArray[left] = rightLeaf->keyArray[0];
+            node->countArray[left] = nodeEntries<T>(leftPage);
+            node->countArray[left + 1] = nodeEntries<T>(rightPage);
+        }
+    }
+    else {
+        NonLeafNode<T> *leftNode = (NonLeafNode<T> *) leftPage;
+        NonLeafNode<T> *rightNode = (NonLeafNode<T> *) rightPage;
+        int a = leftNode->header.keyCount;
+        int b = rightNode->header.keyCount;
+
+        // step 2: the separator comes down between the keys of the two nodes when they fit in one
+        if (a + 1 + b <= KeyTraits<T>::NONLEAF_SIZE) {
+            leftNode->keyArray[a] = node->keyArray[left];
+            memcpy(&leftNode->keyArray[a + 1], &rightNode->keyArray[0], b * sizeof(T));
+            memcpy(&leftNode->pageNoArray[a + 1], &rightNode->pageNoArray[0], (b + 1) * sizeof(PageId));
+            memcpy(&leftNode->countArray[a + 1], &rightNode->countArray[0], (b + 1) * sizeof(std::uint64_t));
+            leftNode->header.keyCount = a + 1 + b;
+            node->countArray[left] += node->countArray[left + 1];
+            removeFromNonLeaf(node, left);
+            merged = true;
+        }
+        // step 3: otherwise keys rotate through the separator until both hold about half
+        else {
+            std::vector<T> keys(leftNode->keyArray, leftNode->keyArray + a);
+            keys.push_back(node->keyArray[left]);
+            keys.insert(keys.end(), rightNode->keyArray, rightNode->keyArray + b);
+            std::vector<PageId> pages(leftNode->pageNoArray, leftNode->pageNoArray + a + 1);
+            pages.insert(pages.end(), rightNode->pageNoArray, rightNode->pageNoArray + b + 1);
+            std::vector<std::uint64_t> counts(leftNode->countArray, leftNode->countArray + a + 1);
+            counts.insert(counts.end(), rightNode->countArray, rightNode->countArray + b + 1);
+
+            int keep = (a + b) / 2;
+            std::copy(keys.begin(), keys.begin() + keep, leftNode->keyArray);
+            std::copy(pages.begin(), pages.begin() + keep + 1, leftNode->pageNoArray);
+            std::copy(counts.begin(), counts.begin() + keep + 1, leftNode->countArray);
+            node->keyArray[left] = keys[keep];
+            std::copy(keys.begin() + keep + 1, keys.end(), rightNode->keyArray);
+            std::copy(pages.begin() + keep + 1, pages.end(), rightNode->pageNoArray);
+            std::copy(counts.begin() + keep + 1, counts.end(), rightNode->countArray);
+            leftNode->header.keyCount = keep;
+            rightNode->header.keyCount = a + b - keep;
+            node->countArray[left] = nodeEntries<T>(leftPage);
+            node->countArray[left + 1] = nodeEntries<T>(rightPage);
+        }
+    }
+
+    // step 4: unlock everything, taking the right node out of the tree if it was merged away
+    unlockNode(&((NodeHeader *) leftPage)->version);
+    bufMgr->unPinPage(this->file, leftNo, true);
+    if (merged) {
+        freeNode(rightNo, rightPage);
+    }
+    else {
+        unlockNode(&((NodeHeader *) rightPage)->version);
+        bufMgr->unPinPage(this->file, rightNo, true);
+    }
+    unlockNode(&node->header.version);
+}
+
+/**
+ * rebalanceChild() for two leaves of a packed index, either of which may be packed or plain. Their entries are
+ * decoded and written back as one leaf if they fit in one, or as two halves if each half fits. Otherwise, which
+ * only happens when keys or page numbers are too far apart to pack, the pair is left as it is.
+ */
+template <class T>
+void BTreeIndex::rebalancePacked(NonLeafNode<T> *node, const int left, Page *leftPage, Page *rightPage, bool &merged)
+{
+    int a = ((NodeHeader *) leftPage)->keyCount;
+    int b = ((NodeHeader *) rightPage)->keyCount;
+    int total = a + b;
+    std::vector<T> keys(total);
+    std::vector<RecordId> rids(total);
+    leafEntries(leftPage, 0, a, keys.data(), rids.data());
+    leafEntries(rightPage, 0, b, keys.data() + a, rids.data() + a);
+
+    LeafNode<T> *leftLeaf = (LeafNode<T> *) leftPage;
+    LeafNode<T> *rightLeaf = (LeafNode<T> *) rightPage;
+    if (fitsLeaf(keys.data(), rids.data(), total)) {
+        writeLeaf(leftPage, keys.data(), rids.data(), total);
+        leftLeaf->rightSibPageNo = rightLeaf->rightSibPageNo;
+        node->countArray[left] = total;
+        removeFromNonLeaf(node, left);
+        merged = true;
+        return;
+    }
+    int keep = total / 2;
+    if (fitsLeaf(keys.data(), rids.data(), keep)
+            && fitsLeaf(keys.data() + keep, rids.data() + keep, total - keep)) {
+        writeLeaf(leftPage, keys.data(), rids.data(), keep);
+        writeLeaf(rightPage, keys.data() + keep, rids.data() + keep, total - keep);
+        node->keyArray[left] = keys[keep];
+        node->countArray[left] = keep;
+        node->countArray[left + 1] = total - keep;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::allocNode, freeNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::allocNode(PageId &pageNo, Page *&page)
+{
+    if (this->freeListHead == 0) {
+        bufMgr->allocPage(this->file, pageNo, page);
+        return;
+    }
+    pageNo = this->freeListHead;
+    bufMgr->readPage(this->file, pageNo, page);
+    this->freeListHead = ((FreeNode *) page)->nextFree;
+    writeFreeListHead();
+}
+
+void BTreeIndex::freeNode(const PageId pageNo, Page *page)
+{
+    FreeNode *node = (FreeNode *) page;
+    node->header.nodeType = FREE_NODE;
+    node->header.keyCount = 0;
+    node->nextFree = this->freeListHead;
+    unlockNodeObsolete(&node->header.version);
+    bufMgr->unPinPage(this->file, pageNo, true);
+    this->freeListHead = pageNo;
+    writeFreeListHead();
+}
+
+void BTreeIndex::writeFreeListHead()
+{
+    Page *meta;
+    bufMgr->readPage(this->file, this->headerPageNum, meta);
+    ((IndexMetaInfo *) meta)->freeListHead = this->freeListHead;
+    bufMgr->unPinPage(this->file, this->headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex posting lists
+// -----------------------------------------------------------------------------
+
+/**
+ * Full posting lists are left as they are; the record ids of a run's own entries and of its other posting lists are
+ * merged and written out again in as few lists as they take, on the pages the old lists free.
+ */
+template <class T>
+size_t BTreeIndex::makePostings(T *keys, RecordId *rids, const size_t n)
+{
+    std::vector<PageId> spare;
+    std::vector<RecordId> runRids;
+    size_t kept = 0;
+    size_t start = 0;
+    while (start < n) {
+        size_t end = start + 1;
+        while (end < n && keys[end] == keys[start]) {
+            end++;
+        }
+        size_t plain = 0;
+        bool open = false;
+        for (size_t i = start; i < end; i++) {
+            if (!isPosting(rids[i])) {
+                plain++;
+            }
+            else if (rids[i].padding < POSTING_MAX_RIDS) {
+                open = true;
+            }
+        }
+
+        /// a short run of a key without a posting list, or one with nothing to add to its lists, stays as it is
+        if (plain == 0 || (plain < (size_t) POSTING_MIN_RUN && !open)) {
+            for (size_t i = start; i < end; i++, kept++) {
+                keys[kept] = keys[i];
+                rids[kept] = rids[i];
+            }
+            start = end;
+            continue;
+        }
+
+        T key = keys[start];
+        runRids.clear();
+        for (size_t i = start; i < end; i++) {
+            if (!isPosting(rids[i])) {
+                runRids.push_back(rids[i]);
+            }
+            else if (rids[i].padding < POSTING_MAX_RIDS) {
+                readPosting(rids[i], runRids);
+                releasePosting(rids[i].page_number, &spare);
+            }
+            else {
+                keys[kept] = key;
+                rids[kept] = rids[i];
+                kept++;
+            }
+        }
+        std::sort(runRids.begin(), runRids.end(), ridOrder);
+        for (size_t pos = 0; pos < runRids.size(); kept++) {
+            size_t take = std::min(runRids.size() - pos, (size_t) POSTING_MAX_RIDS);
+            keys[kept] = key;
+            if (take == 1) {
+                rids[kept] = runRids[pos];
+            }
+            else {
+                rids[kept].page_number = writePosting(&runRids[pos], take, spare);
+                rids[kept].slot_number = Page::INVALID_SLOT;
+                rids[kept].padding = (SlotId) take;
+            }
+            pos += take;
+        }
+        start = end;
+    }
+
+    /// the merged lists may take fewer pages than the old ones did
+    for (size_t i = 0; i < spare.size(); i++) {
+        Page *page;
+        bufMgr->readPage(this->file, spare[i], page);
+        lockNode(&((NodeHeader *) page)->version);
+        freeNode(spare[i], page);
+    }
+    return kept;
+}
+
+PageId BTreeIndex::writePosting(const RecordId *rids, const size_t n, std::vector<PageId> &spare)
+{
+    PageId head = 0;
+    PageId prevNo = 0;
+    PostingNode *prev = NULL;
+    size_t pos = 0;
+    while (pos < n) {
+        PageId pageNo;
+        Page *page;
+        if (!spare.empty()) {
+            pageNo = spare.back();
+            spare.pop_back();
+            bufMgr->readPage(this->file, pageNo, page);
+        }
+        else {
+            allocNode(pageNo, page);
+        }
+        PostingNode *node = initPosting(page);
+        pos += encodePosting(node, rids + pos, n - pos);
+
+        if (prev == NULL) {
+            head = pageNo;
+        }
+        else {
+            prev->nextPageNo = pageNo;
+            bufMgr->unPinPage(this->file, prevNo, true);
+        }
+        prev = node;
+        prevNo = pageNo;
+    }
+    if (prev != NULL) {
+        bufMgr->unPinPage(this->file, prevNo, true);
+    }
+    return head;
+}
+
+/**
+ * A posting list only changes while its leaf is write locked, so a leaf version that still validates after a page
+ * has been read means the page was read whole, and the link read from it can be followed.
+ */
+bool BTreeIndex::readPosting(const RecordId &ref, std::vector<RecordId> &out, const std::uint64_t *latch,
+        const std::uint64_t version)
+{
+    PageId pageNo = ref.page_number;
+    while (pageNo != 0) {
+        if (latch != NULL && !OptimisticLatch::validate(latch, version)) {
+            return false;
+        }
+        Page *page;
+        bufMgr->readPage(this->file, pageNo, page);
+        PostingNode *node = (PostingNode *) page;
+        decodePosting(node, out);
+        PageId next = node->nextPageNo;
+        bufMgr->unPinPage(this->file, pageNo, false);
+        pageNo = next;
+    }
+    return latch == NULL || OptimisticLatch::validate(latch, version);
+}
+
+/**
+ * The pages of a list hold consecutive stretches of its sorted ids, so the id is on the first page whose last id is
+ * not below it, if anywhere. That page is decoded and written again without it, which never takes more room; a page
+ * left empty is unlinked and freed.
+ */
+bool BTreeIndex::removeFromPosting(RecordId &ref, const RecordId &rid)
+{
+    std::uint64_t target = packRid(rid);
+    PageId prevNo = 0;
+    PageId pageNo = ref.page_number;
+    while (pageNo != 0) {
+        Page *page;
+        bufMgr->readPage(this->file, pageNo, page);
+        PostingNode *node = (PostingNode *) page;
+        PageId next = node->nextPageNo;
+        if (node->lastRid < target) {
+            bufMgr->unPinPage(this->file, pageNo, false);
+            prevNo = pageNo;
+            pageNo = next;
+            continue;
+        }
+
+        std::vector<RecordId> rids;
+        decodePosting(node, rids);
+        std::vector<RecordId>::iterator it = std::lower_bound(rids.begin(), rids.end(), rid, ridOrder);
+        if (it == rids.end() || packRid(*it) != target) {
+            bufMgr->unPinPage(this->file, pageNo, false);
+            return false;
+        }
+        rids.erase(it);
+        if (!rids.empty()) {
+            encodePosting(node, &rids[0], rids.size());
+            bufMgr->unPinPage(this->file, pageNo, true);
+        }
+        else if (prevNo == 0) {
+            ref.page_number = next;
+            lockNode(&node->header.version);
+            freeNode(pageNo, page);
+        }
+        else {
+            Page *prevPage;
+            bufMgr->readPage(this->file, prevNo, prevPage);
+            ((PostingNode *) prevPage)->nextPageNo = next;
+            bufMgr->unPinPage(this->file, prevNo, true);
+            lockNode(&node->header.version);
+            freeNode(pageNo, page);
+        }
+
+        /// a list of one is no list: its last id takes its place in the leaf
+        ref.padding--;
+        if (ref.padding == 1) {
+            std::vector<RecordId> last;
+            readPosting(ref, last);
+            releasePosting(ref.page_number, NULL);
+            ref = last[0];
+        }
+        return true;
+    }
+    return false;
+}
+
+void BTreeIndex::releasePosting(const PageId head, std::vector<PageId> *spare)
+{
+    PageId pageNo = head;
+    while (pageNo != 0) {
+        Page *page;
+        bufMgr->readPage(this->file, pageNo, page);
+        PageId next = ((PostingNode *) page)->nextPageNo;
+        if (spare != NULL) {
+            spare->push_back(pageNo);
+            bufMgr->unPinPage(this->file, pageNo, false);
+        }
+        else {
+            lockNode(&((NodeHeader *) page)->version);
+            freeNode(pageNo, page);
+        }
+        pageNo = next;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::containsKey, lookup, minKey, maxKey
+// -----------------------------------------------------------------------------
+/**
+ * Looks the key up without taking any lock, stopping at the first match.
+ *
+ * @param key : A pointer to the value (integer, double or string) we are looking for.
+ */
+bool BTreeIndex::containsKey(const void *key)
+{
+    return (this->*lookupFn)(key, NULL) > 0;
+}
+
+size_t BTreeIndex::lookup(const void *key, std::vector<RecordId> &outRids)
+{
+    return (this->*lookupFn)(key, &outRids);
+}
+
+/**
+ * Every read from a leaf is validated against the leaf's version before it is trusted, and the whole lookup
+ * restarts from the root if a concurrent write got in the way, dropping the record ids it had collected.
+ *
+ * @param key : A pointer to the value we are looking for.
+ * @param outRids : matching record ids are appended to this. If NULL, the lookup stops at the first match.
+ * @return the number of matching entries, at most 1 if outRids is NULL
+ */
+template <class T>
+size_t BTreeIndex::lookupTyped(const void *key, std::vector<RecordId> *outRids)
+{
+    T value = KeyTraits<T>::load(key);
+    size_t start = outRids != NULL ? outRids->size() : 0;
+    while (true) {
+        PageId leafNo;
+        Page *leafPage;
+        std::uint64_t version;
+        if (outRids != NULL) {
+            outRids->resize(start);
+        }
+        if (!findLeafOptimistic<T>(value, leafNo, leafPage, version)) {
+            continue;
+        }
+
+        size_t found = 0;
+        while (true) {
+            LeafNode<T> *leaf = (LeafNode<T> *) leafPage;
+            int size = leafSize<T>(leafPage, this->leafOccupancy);
+            int pos = leafLowerBound(leafPage, size, value);
+            int end = pos;
+            size_t before = outRids != NULL ? outRids->size() : 0;
+            bool read = true;
+            if (outRids != NULL) {
+                end = leafUpperBound(leafPage, size, value);
+                for (int i = pos; i < end && read; i++) {
+                    RecordId rid = leafRid<T>(leafPage, i);
+                    if (isPosting(rid)) {
+                        read = readPosting(rid, *outRids, &leaf->header.version, version);
+                    }
+                    else {
+                        outRids->push_back(rid);
+                    }
+                }
+            }
+            else if (pos < size && leafKey<T>(leafPage, pos) == value) {
+                end = pos + 1;
+            }
+            PageId sibling = leaf->rightSibPageNo;
+            if (!read || !OptimisticLatch::validate(&leaf->header.version, version)) {
+                bufMgr->unPinPage(this->file, leafNo, false);
+                break;
+            }
+            found += outRids != NULL ? outRids->size() - before : end - pos;
+
+            /// the descent stops left of a separator equal to the key, and a run of equal keys can go on in the
+            /// next leaf, so matches continue to the right until a leaf holds a greater key
+            if (end < size || sibling == 0 || (outRids == NULL && found > 0)) {
+                bufMgr->unPinPage(this->file, leafNo, false);
+                return found;
+            }
+
+            Page *sibPage;
+            std::uint64_t sibVersion;
+            bufMgr->readPage(this->file, sibling, sibPage);
+            bool valid = OptimisticLatch::readLock(&((NodeHeader *) sibPage)->version, sibVersion)
+                    && OptimisticLatch::validate(&leaf->header.version, version);
+            bufMgr->unPinPage(this->file, leafNo, false);
+            if (!valid) {
+                bufMgr->unPinPage(this->file, sibling, false);
+                break;
+            }
+            leafNo = sibling;
+            leafPage = sibPage;
+            version = sibVersion;
+        }
+    }
+}
+
+bool BTreeIndex::minKey(void *outKey, RecordId *outRid)
+{
+    return (this->*edgeEntryFn)(false, outKey, outRid);
+}
+
+bool BTreeIndex::maxKey(void *outKey, RecordId *outRid)
+{
+    return (this->*edgeEntryFn)(true, outKey, outRid);
+}
+
+/**
+ * Only the root leaf of a tree can be empty: deletes rebalance every other leaf before it runs that low.
+ */
+template <class T>
+bool BTreeIndex::edgeEntryTyped(const bool last, void *outKey, RecordId *outRid)
+{
+    while (true) {
+        PageId leafNo;
+        Page *leafPage;
+        std::uint64_t version;
+        if (!findEdgeLeafOptimistic<T>(last, leafNo, leafPage, version)) {
+            continue;
+        }
+
+        LeafNode<T> *leaf = (LeafNode<T> *) leafPage;
+        int size = leafSize<T>(leafPage, this->leafOccupancy);
+        int pos = last ? size - 1 : 0;
+        T key = leafKey<T>(leafPage, std::max(pos, 0));
+        RecordId rid = leafRid<T>(leafPage, std::max(pos, 0));
+        bool valid = true;
+        if (size > 0 && outRid != NULL && isPosting(rid)) {
+            std::vector<RecordId> rids;
+            valid = readPosting(rid, rids, &leaf->header.version, version) && !rids.empty();
+            rid = valid ? (last ? rids.back() : rids.front()) : rid;
+        }
+        valid = valid && OptimisticLatch::validate(&leaf->header.version, version);
+        bufMgr->unPinPage(this->file, leafNo, false);
+        if (!valid) {
+            continue;
+        }
+
+        if (size == 0) {
+            return false;
+        }
+        memcpy(outKey, &key, sizeof(T));
+        if (outRid != NULL) {
+            *outRid = rid;
+        }
+        return true;
+    }
+}
+
+template <class T>
+bool BTreeIndex::findEdgeLeafOptimistic(const bool last, PageId &leafNo, Page *&leafPage, std::uint64_t &version)
+{
+    PageId nodeNo = this->rootPageNum;
+    Page *node;
+    bufMgr->readPage(this->file, nodeNo, node);
+    std::uint64_t nodeVersion;
+    if (!OptimisticLatch::readLock(&((NodeHeader *) node)->version, nodeVersion) || nodeNo != this->rootPageNum) {
+        bufMgr->unPinPage(this->file, nodeNo, false);
+        return false;
+    }
+
+    while (!isLeaf(node)) {
+        NonLeafNode<T> *currNode = (NonLeafNode<T> *) node;
+        int numKeys = std::min(std::max((int) currNode->header.keyCount, 0), KeyTraits<T>::NONLEAF_SIZE);
+        PageId childNo = currNode->pageNoArray[last ? numKeys : 0];
+        if (!OptimisticLatch::validate(&currNode->header.version, nodeVersion)) {
+            bufMgr->unPinPage(this->file, nodeNo, false);
+            return false;
+        }
+
+        Page *child;
+        std::uint64_t childVersion;
+        bufMgr->readPage(this->file, childNo, child);
+        bool valid = OptimisticLatch::readLock(&((NodeHeader *) child)->version, childVersion)
+                && OptimisticLatch::validate(&currNode->header.version, nodeVersion);
+        bufMgr->unPinPage(this->file, nodeNo, false);
+        if (!valid) {
+            bufMgr->unPinPage(this->file, childNo, false);
+            return false;
+        }
+
+        nodeNo = childNo;
+        node = child;
+        nodeVersion = childVersion;
+    }
+
+    leafNo = nodeNo;
+    leafPage = node;
+    version = nodeVersion;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::countRange
+// -----------------------------------------------------------------------------
+
+size_t BTreeIndex::countRange(const void *lowValParm, const Operator lowOpParm, const void *highValParm,
+        const Operator highOpParm)
+{
+    /// the bounds are checked like startScan() checks them
+    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE)) {
+        throw BadOpcodesException();
+    }
+    return (this->*countRangeFn)(lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+/**
+ * The entries within the range are those up to the high bound less those below the low bound, and each of the two
+ * is counted on its own descent. A GT bound excludes the entries equal to it, so they are counted below it.
+ */
+template <class T>
+size_t BTreeIndex::countRangeTyped(const void *lowValParm, const Operator lowOpParm, const void *highValParm,
+        const Operator highOpParm)
+{
+    T lowVal = KeyTraits<T>::load(lowValParm);
+    T highVal = KeyTraits<T>::load(highValParm);
+    if (lowVal > highVal) {
+        throw BadScanrangeException();
+    }
+
+    std::uint64_t below;
+    std::uint64_t upTo;
+    while (!rankOptimistic(lowVal, lowOpParm == GT, below)) { }
+    while (!rankOptimistic(highVal, highOpParm == LTE, upTo)) { }
+    /// an empty range, or writes between the two descents, can put the high end below the low one
+    return upTo > below ? upTo - below : 0;
+}
+
+/**
+ * Child j of a node holds keys from keyArray[j - 1] to keyArray[j]. Descending to the first child whose upper
+ * separator is not below the key (not above it if inclusive) leaves only entries that count on the left of that
+ * child and none that do on its right, so the counts of the children left of it are added up at every level, and
+ * the position of the key in the leaf finishes the rank. Counts are read atomically, as optimistic writers add to
+ * them without locking the node.
+ */
+template <class T>
+bool BTreeIndex::rankOptimistic(const T &key, const bool inclusive, std::uint64_t &rank)
+{
+    rank = 0;
+    PageId nodeNo = this->rootPageNum;
+    Page *node;
+    bufMgr->readPage(this->file, nodeNo, node);
+    std::uint64_t nodeVersion;
+    if (!OptimisticLatch::readLock(&((NodeHeader *) node)->version, nodeVersion) || nodeNo != this->rootPageNum) {
+        bufMgr->unPinPage(this->file, nodeNo, false);
+        return false;
+    }
+
+    while (!isLeaf(node)) {
+        NonLeafNode<T> *currNode = (NonLeafNode<T> *) node;
+        int numKeys = std::min(std::max((int) currNode->header.keyCount, 0), KeyTraits<T>::NONLEAF_SIZE);
+        int childIdx = inclusive ? upperBound(currNode->keyArray, numKeys, key)
+                                 : lowerBound(currNode->keyArray, numKeys, key);
+        for (int i = 0; i < childIdx; i++) {
+            rank += __atomic_load_n(&currNode->countArray[i], __ATOMIC_RELAXED);
+        }
+        PageId childNo = currNode->pageNoArray[childIdx];
+        if (!OptimisticLatch::validate(&currNode->header.version, nodeVersion)) {
+            bufMgr->unPinPage(this->file, nodeNo, false);
+            return false;
+        }
+
+        Page *child;
+        std::uint64_t childVersion;
+        bufMgr->readPage(this->file, childNo, child);
+        bool valid = OptimisticLatch::readLock(&((NodeHeader *) child)->version, childVersion)
+                && OptimisticLatch::validate(&currNode->header.version, nodeVersion);
+        bufMgr->unPinPage(this->file, nodeNo, false);
+        if (!valid) {
+            bufMgr->unPinPage(this->file, childNo, false);
+            return false;
+        }
+
+        nodeNo = childNo;
+        node = child;
+        nodeVersion = childVersion;
+    }
+
+    LeafNode<T> *leaf = (LeafNode<T> *) node;
+    int size = leafSize<T>(node, this->leafOccupancy);
+    int pos = inclusive ? leafUpperBound(node, size, key) : leafLowerBound(node, size, key);
+    /// every entry of a packed leaf stands for one record
+    if (PackedLeaf<T>::is(node)) {
+        rank += pos;
+    }
+    else {
+        for (int i = 0; i < pos; i++) {
+            rank += entryWeight(leaf->ridArray[i]);
+        }
+    }
+    bool valid = OptimisticLatch::validate(&leaf->header.version, nodeVersion);
+    bufMgr->unPinPage(this->file, nodeNo, false);
+    return valid;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::parallelScan
+// -----------------------------------------------------------------------------
+
+size_t BTreeIndex::parallelScan(const void *lowValParm, const Operator lowOpParm, const void *highValParm,
+        const Operator highOpParm, std::vector<RecordId> &outRids, const unsigned workers, const bool ordered)
+{
+    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE)) {
+        throw BadOpcodesException();
+    }
+    unsigned threads = (workers != 0) ? workers : std::thread::hardware_concurrency();
+    return (this->*parallelScanFn)(lowValParm, lowOpParm, highValParm, highOpParm, outRids,
+            std::max(threads, 1u), ordered);
+}
+
+/**
+ * The range is cut where the entries left of it, as rankOptimistic() counts them, reach each multiple of an equal
+ * share, at the separator nearest to that entry. Sub-ranges run from one cut, inclusive, to the next, exclusive, so
+ * every entry falls in exactly one of them even where duplicates of a cut key span several leaves. The rank of each
+ * cut also says where its sub-range's entries go in the ordered result, so no merge step copies them.
+ */
+template <class T>
+size_t BTreeIndex::parallelScanTyped(const void *lowValParm, const Operator lowOpParm, const void *highValParm,
+        const Operator highOpParm, std::vector<RecordId> &outRids, unsigned workers, const bool ordered)
+{
+    T lowVal = KeyTraits<T>::load(lowValParm);
+    T highVal = KeyTraits<T>::load(highValParm);
+    if (lowVal > highVal) {
+        throw BadScanrangeException();
+    }
+
+    /// no more sub-ranges than leaves the range covers
+    std::uint64_t below;
+    std::uint64_t upTo;
+    while (!rankOptimistic(lowVal, lowOpParm == GT, below)) { }
+    while (!rankOptimistic(highVal, highOpParm == LTE, upTo)) { }
+    std::uint64_t total = upTo > below ? upTo - below : 0;
+    workers = (unsigned) std::min<std::uint64_t>(workers, std::max<std::uint64_t>(total / this->leafOccupancy, 1));
+
+    /// cuts that fall outside the range or on the previous one are dropped, leaving fewer, larger sub-ranges
+    std::vector<T> cuts;
+    {
+        std::lock_guard<std::mutex> guard(this->structureLatch);
+        for (unsigned i = 1; i < workers; i++) {
+            T cut;
+            if (separatorNearRank(below + total * i / workers, cut) && lowVal < cut && cut < highVal
+                    && (cuts.empty() || cuts.back() < cut)) {
+                cuts.push_back(cut);
+            }
+        }
+    }
+
+    const size_t parts = cuts.size() + 1;
+    const size_t batchSize = 4096;
+    const size_t start = outRids.size();
+
+    /// in key order each sub-range is scanned straight into its place in outRids, which starts as many entries
+    /// after the start of the range as the sub-range's low cut has left of it
+    std::vector<std::uint64_t> offsets(parts + 1, 0);
+    offsets[parts] = total;
+    for (size_t p = 1; p < parts; p++) {
+        std::uint64_t rank;
+        while (!rankOptimistic(cuts[p - 1], false, rank)) { }
+        offsets[p] = std::min(std::max(rank - std::min(rank, below), offsets[p - 1]), total);
+    }
+    if (ordered) {
+        outRids.resize(start + total);
+    }
+
+    std::vector<size_t> written(parts, 0);
+    std::vector< std::vector<RecordId> > overflow(parts);
+    std::vector<std::exception_ptr> errors(parts);
+    std::mutex outLatch;
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < parts; p++) {
+        threads.push_back(std::thread([&, p]() {
+            T partLow = (p == 0) ? lowVal : cuts[p - 1];
+            T partHigh = (p == parts - 1) ? highVal : cuts[p];
+            BTreeCursor cursor(this);
+            try {
+                cursor.startScan(&partLow, (p == 0) ? lowOpParm : GTE, &partHigh, (p == parts - 1) ? highOpParm : LT);
+                /// unordered workers append under outLatch, so only ordered ones may hold a pointer into outRids
+                RecordId *place = ordered ? outRids.data() + start + offsets[p] : NULL;
+                const size_t room = ordered ? offsets[p + 1] - offsets[p] : 0;
+                std::vector<RecordId> batch(batchSize);
+                size_t wanted;
+                size_t count;
+                do {
+                    if (written[p] < room) {
+                        wanted = std::min(batchSize, room - written[p]);
+                        count = cursor.scanNextBatch(place + written[p], NULL, wanted);
+                        written[p] += count;
+                    }
+                    else {
+                        /// entries beyond the counted ones, or every entry when unordered
+                        wanted = batchSize;
+                        count = cursor.scanNextBatch(&batch[0], NULL, wanted);
+                        if (ordered) {
+                            overflow[p].insert(overflow[p].end(), batch.begin(), batch.begin() + count);
+                        }
+                        else {
+                            std::lock_guard<std::mutex> guard(outLatch);
+                            outRids.insert(outRids.end(), batch.begin(), batch.begin() + count);
+                        }
+                    }
+                } while (count == wanted);
+                cursor.endScan();
+            }
+            catch (const NoSuchKeyFoundException &e) {
+            }
+            catch (...) {
+                errors[p] = std::current_exception();
+            }
+        }));
+    }
+    for (size_t p = 0; p < parts; p++) {
+        threads[p].join();
+    }
+    for (size_t p = 0; p < parts; p++) {
+        if (errors[p]) {
+            outRids.resize(start);
+            std::rethrow_exception(errors[p]);
+        }
+    }
+
+    /// the counts only miss when the tree changed since they were taken: close up the gaps and fit in the overflow
+    bool exact = true;
+    for (size_t p = 0; ordered && p < parts; p++) {
+        exact = exact && written[p] == offsets[p + 1] - offsets[p] && overflow[p].empty();
+    }
+    if (!exact) {
+        std::vector<RecordId> merged;
+        for (size_t p = 0; p < parts; p++) {
+            merged.insert(merged.end(), outRids.begin() + start + offsets[p],
+                    outRids.begin() + start + offsets[p] + written[p]);
+            merged.insert(merged.end(), overflow[p].begin(), overflow[p].end());
+        }
+        outRids.resize(start);
+        outRids.insert(outRids.end(), merged.begin(), merged.end());
+    }
+    return outRids.size() - start;
+}
+
+/**
+ * A child's entries are those of rank from the counts of the children left of it up to that plus its own count, so
+ * the entry is in the first child whose running total passes it. Above the leaves the separators on either side
+ * of that child are its bounds, and the one closer to the entry by count is taken.
+ */
+template <class T>
+bool BTreeIndex::separatorNearRank(std::uint64_t rank, T &separator)
+{
+    PageId nodeNo = this->rootPageNum;
+    Page *node;
+    bufMgr->readPage(this->file, nodeNo, node);
+    while (!isLeaf(node)) {
+        NonLeafNode<T> *currNode = (NonLeafNode<T> *) node;
+        int numKeys = currNode->header.keyCount;
+        int child = 0;
+        std::uint64_t before = 0;
+        while (child < numKeys && before + __atomic_load_n(&currNode->countArray[child], __ATOMIC_RELAXED) <= rank) {
+            before += __atomic_load_n(&currNode->countArray[child], __ATOMIC_RELAXED);
+            child++;
+        }
+
+        if (currNode->header.level == 1 && numKeys > 0) {
+            std::uint64_t after = before + __atomic_load_n(&currNode->countArray[child], __ATOMIC_RELAXED);
+            bool right = child < numKeys && (child == 0 || after - rank < rank - before);
+            separator = currNode->keyArray[right ? child : child - 1];
+            bufMgr->unPinPage(this->file, nodeNo, false);
+            return true;
+        }
+
+        rank -= before;
+        PageId childNo = currNode->pageNoArray[child];
+        bufMgr->unPinPage(this->file, nodeNo, false);
+        nodeNo = childNo;
+        bufMgr->readPage(this->file, nodeNo, node);
+    }
+    bufMgr->unPinPage(this->file, nodeNo, false);
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getStatistics
+// -----------------------------------------------------------------------------
+
+IndexStatistics BTreeIndex::getStatistics()
+{
+    IndexStatistics stats;
+    memset(&stats, 0, sizeof(stats));
+    size_t leafKeys = 0;
+    size_t leafSlots = 0;
+    size_t nonLeafKeys = 0;
+
+    std::lock_guard<std::mutex> guard(this->structureLatch);
+    switch (this->attributeType) {
+        case INTEGER:
+            collectStatistics<int>(this->rootPageNum, stats, leafKeys, leafSlots, nonLeafKeys);
+            break;
+        case DOUBLE:
+            collectStatistics<double>(this->rootPageNum, stats, leafKeys, leafSlots, nonLeafKeys);
+            break;
+        case STRING:
+            collectStatistics<StringKey>(this->rootPageNum, stats, leafKeys, leafSlots, nonLeafKeys);
+            break;
+        case COMPOSITE:
+            collectStatistics<CompositeKey>(this->rootPageNum, stats, leafKeys, leafSlots, nonLeafKeys);
+            break;
+    }
+
+    for (PageId pageNo = this->freeListHead; pageNo != 0; stats.freePages++) {
+        Page *page;
+        bufMgr->readPage(this->file, pageNo, page);
+        PageId next = ((FreeNode *) page)->nextFree;
+        bufMgr->unPinPage(this->file, pageNo, false);
+        pageNo = next;
+    }
+
+    /// packed leaves count against what each of them holds
+    stats.leafFillFactor = stats.leafPages == 0 ? 0 : leafKeys / (double) leafSlots;
+    stats.nonLeafFillFactor = stats.nonLeafPages == 0 ? 0
+            : nonLeafKeys / ((double) stats.nonLeafPages * this->nodeOccupancy);
+    return stats;
+}
+
+template <class T>
+void BTreeIndex::collectStatistics(const PageId pageNo, IndexStatistics &stats, size_t &leafKeys,
+        size_t &leafSlots, size_t &nonLeafKeys)
+{
+    Page *page;
+    bufMgr->readPage(this->file, pageNo, page);
+    NodeHeader *header = (NodeHeader *) page;
+    stats.height = std::max(stats.height, header->level + 1);
+
+    if (isLeaf(page)) {
+        LeafNode<T> *leaf = (LeafNode<T> *) page;
+        stats.leafPages++;
+        stats.entries += nodeEntries<T>(page);
+        leafKeys += header->keyCount;
+        leafSlots += leafCapacity<T>(page, this->leafOccupancy);
+        if (PackedLeaf<T>::is(page)) {
+            stats.packedLeafPages++;
+            bufMgr->unPinPage(this->file, pageNo, false);
+            return;
+        }
+
+        /// inserts that do not split may be moving entries around, so a posting list is only followed from a leaf
+        /// that held still while its entry was read; its pages only change under structureLatch
+        std::uint64_t version;
+        bool stable = OptimisticLatch::readLock(&header->version, version);
+        for (int i = 0; i < header->keyCount && stable; i++) {
+            RecordId rid = leaf->ridArray[i];
+            if (!isPosting(rid) || !OptimisticLatch::validate(&header->version, version)) {
+                continue;
+            }
+            for (PageId postingNo = rid.page_number; postingNo != 0; stats.postingPages++) {
+                Page *posting;
+                bufMgr->readPage(this->file, postingNo, posting);
+                PageId next = ((PostingNode *) posting)->nextPageNo;
+                bufMgr->unPinPage(this->file, postingNo, false);
+                postingNo = next;
+            }
+        }
+    }
+    else {
+        NonLeafNode<T> *node = (NonLeafNode<T> *) page;
+        stats.nonLeafPages++;
+        nonLeafKeys += node->header.keyCount;
+        for (int i = 0; i <= node->header.keyCount; i++) {
+            collectStatistics<T>(node->pageNoArray[i], stats, leafKeys, leafSlots, nonLeafKeys);
+        }
+    }
+    bufMgr->unPinPage(this->file, pageNo, false);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan, scanNext, endScan -- the built-in cursor
+// -----------------------------------------------------------------------------
+
+void badgerdb::BTreeIndex::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm,
+				   const ScanOrder orderParm,
+				   const size_t limitParm)
+{
+    scanCursor.startScan(lowValParm, lowOpParm, highValParm, highOpParm, orderParm, limitParm);
+}
+
+void badgerdb::BTreeIndex::scanNext(RecordId& outRid)
+{
+    scanCursor.scanNext(outRid);
+}
+
+size_t badgerdb::BTreeIndex::scanNextBatch(RecordId *outRids, void *outKeys, const size_t maxEntries,
+        void *outIncludes)
+{
+    return scanCursor.scanNextBatch(outRids, outKeys, maxEntries, outIncludes);
+}
+
+void badgerdb::BTreeIndex::startMultiScan(const void* lowValsParm,
+				   const Operator lowOpParm,
+				   const void* highValsParm,
+				   const Operator highOpParm,
+				   const size_t numRangesParm,
+				   const size_t limitParm)
+{
+    scanCursor.startMultiScan(lowValsParm, lowOpParm, highValsParm, highOpParm, numRangesParm, limitParm);
+}
+
+void badgerdb::BTreeIndex::startPrefixScan(const void * const *values, const int numColumns, const ScanOrder orderParm,
+        const size_t limitParm)
+{
+    /// a CompositeKey has room for a key of any type
+    CompositeKey low;
+    CompositeKey high;
+    makeKey(values, numColumns, &low, false);
+    makeKey(values, numColumns, &high, true);
+    scanCursor.startScan(&low, GTE, &high, LTE, orderParm, limitParm);
+}
+
+void badgerdb::BTreeIndex::endScan()
+{
+    scanCursor.endScan();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::BTreeCursor -- Constructor
+// -----------------------------------------------------------------------------
+
+BTreeCursor::BTreeCursor(BTreeIndex *index)
+{
+    this->index = index;
+    this->currentPageNum = (PageId) -1;
+    this->currentPageData = NULL;
+
+    /// variables used for scanning
+    this->scanExecuting = false;
+    this->nextEntry = -1;
+    this->highValInt = 0;
+    this->lowValInt = 0;
+    this->highValDouble = 0;
+    this->lowValDouble = 0;
+    this->highValString = StringKey();
+    this->lowValString = StringKey();
+    this->highValComposite = CompositeKey();
+    this->lowValComposite = CompositeKey();
+    this->lowOp = GT;
+    this->highOp = LT;
+    this->order = ASCENDING;
+    this->remaining = SIZE_MAX;
+    this->numRanges = 0;
+    this->nextRange = 0;
+    this->readaheadDepth = 0;
+    this->readaheadMarker = 0;
+    this->leafMicros = 0;
+    this->waitMicros = 0;
+    this->readaheadStalled = false;
+    this->postingPos = 0;
+    this->packedPageNo = Page::INVALID_NUMBER;
+    this->scanNextFn = NULL;
+    this->scanNextBatchFn = NULL;
+}
+
+template <> int &BTreeCursor::lowVal<int>() { return lowValInt; }
+template <> int &BTreeCursor::highVal<int>() { return highValInt; }
+template <> double &BTreeCursor::lowVal<double>() { return lowValDouble; }
+template <> double &BTreeCursor::highVal<double>() { return highValDouble; }
+template <> StringKey &BTreeCursor::lowVal<StringKey>() { return lowValString; }
+template <> StringKey &BTreeCursor::highVal<StringKey>() { return highValString; }
+template <> CompositeKey &BTreeCursor::lowVal<CompositeKey>() { return lowValComposite; }
+template <> CompositeKey &BTreeCursor::highVal<CompositeKey>() { return highValComposite; }
+template <class T>
+bool BTreeCursor::pastHigh(const T &key)
+{
+    return (highOp == LTE) ? highVal<T>() < key : !(key < highVal<T>());
+}
+
+template <> std::vector<int> &BTreeCursor::pathHighs<int>() { return pathHighsInt; }
+template <> std::vector<double> &BTreeCursor::pathHighs<double>() { return pathHighsDouble; }
+template <> std::vector<StringKey> &BTreeCursor::pathHighs<StringKey>() { return pathHighsString; }
+template <> std::vector<CompositeKey> &BTreeCursor::pathHighs<CompositeKey>() { return pathHighsComposite; }
+template <> std::vector<int> &BTreeCursor::rangeBounds<int>() { return rangeBoundsInt; }
+template <> std::vector<double> &BTreeCursor::rangeBounds<double>() { return rangeBoundsDouble; }
+template <> std::vector<StringKey> &BTreeCursor::rangeBounds<StringKey>() { return rangeBoundsString; }
+template <> std::vector<CompositeKey> &BTreeCursor::rangeBounds<CompositeKey>() { return rangeBoundsComposite; }
+
+template <class T>
+const T *BTreeCursor::leafKeys()
+{
+    return ((LeafNode<T> *) currentPageData)->keyArray;
+}
+
+template <class T>
+const RecordId *BTreeCursor::leafRids()
+{
+    return ((LeafNode<T> *) currentPageData)->ridArray;
+}
+
+template <> std::vector<int> &BTreeCursor::packedKeys<int>() { return packedKeysInt; }
+template <> std::vector<StringKey> &BTreeCursor::packedKeys<StringKey>() { return packedKeysString; }
+
+template <>
+const int *BTreeCursor::leafKeys<int>()
+{
+    if (!PackedLeaf<int>::is(currentPageData)) {
+        return ((LeafNode<int> *) currentPageData)->keyArray;
+    }
+    unpackLeaf<int>();
+    return packedKeysInt.data();
+}
+
+template <>
+const RecordId *BTreeCursor::leafRids<int>()
+{
+    if (!PackedLeaf<int>::is(currentPageData)) {
+        return ((LeafNode<int> *) currentPageData)->ridArray;
+    }
+    unpackLeaf<int>();
+    return packedRids.data();
+}
+
+template <>
+const StringKey *BTreeCursor::leafKeys<StringKey>()
+{
+    if (!PackedLeaf<StringKey>::is(currentPageData)) {
+        return ((LeafNode<StringKey> *) currentPageData)->keyArray;
+    }
+    unpackLeaf<StringKey>();
+    return packedKeysString.data();
+}
+
+template <>
+const RecordId *BTreeCursor::leafRids<StringKey>()
+{
+    if (!PackedLeaf<StringKey>::is(currentPageData)) {
+        return ((LeafNode<StringKey> *) currentPageData)->ridArray;
+    }
+    unpackLeaf<StringKey>();
+    return packedRids.data();
+}
+
+/**
+ * A scan never runs alongside changes to the index, so a leaf decoded once stays valid for as long as the scan is
+ * on it; moving to another leaf and back decodes it again.
  */
-void badgerdb::BTreeIndex::insertNonLeaf(NonLeafNodeInt *nonLeaf, PageKeyPair<int> *currentChild)
+template <class T>
+void BTreeCursor::unpackLeaf()
 {
+    if (packedPageNo == currentPageNum) {
+        return;
+    }
+    int size = ((NodeHeader *) currentPageData)->keyCount;
+    packedKeys<T>().resize(size);
+    packedRids.resize(size);
+    PackedLeaf<T>::copy(currentPageData, 0, size, packedKeys<T>().data(), packedRids.data());
+    packedPageNo = currentPageNum;
+}
 
-  int endIdx = this->nodeOccupancy;
-
-  // 1) finding the end
-  for(int i = endIdx; i >= 0 && (nonLeaf->pageNoArray[i] == 0); i--)
-  {
-      endIdx--;
-  }
-
-  // 2) shifting the rest of the tree to make space for the new child
-  for(int i = endIdx; i > 0 && (nonLeaf->keyArray[i-1] > currentChild->key); i--)
-  {
-      nonLeaf->keyArray[i] = nonLeaf->keyArray[i-1];
-      nonLeaf->pageNoArray[i+1] = nonLeaf->pageNoArray[i];
-      endIdx--;
-  }
+// -----------------------------------------------------------------------------
+// BTreeCursor::~BTreeCursor -- destructor
+// -----------------------------------------------------------------------------
 
-  // 3) putting the new child in the tree
-  nonLeaf->keyArray[endIdx] = currentChild->key;
-  nonLeaf->pageNoArray[endIdx+1] = currentChild->pageNo;
+BTreeCursor::~BTreeCursor()
+{
+    try {
+        if (this->scanExecuting) {
+            endScan();
+        }
+    }
+    catch (const BadgerDbException &e) { }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::startScan
+// BTreeCursor::startScan
 // -----------------------------------------------------------------------------
 
-void badgerdb::BTreeIndex::startScan(const void* lowValParm,
+void badgerdb::BTreeCursor::startScan(const void* lowValParm,
 				   const Operator lowOpParm,
 				   const void* highValParm,
-				   const Operator highOpParm)
+				   const Operator highOpParm,
+				   const ScanOrder orderParm,
+				   const size_t limitParm)
 {
 
     /// first check to make sure that the opParms are valid, throw exception if not
@@ -471,191 +3991,848 @@ void badgerdb::BTreeIndex::startScan(const void* lowValParm,
     /// now get values to be used in the scan
     this->highOp = highOpParm; /// opcodes
     this->lowOp = lowOpParm;
+    this->order = orderParm;
+    this->remaining = (limitParm == 0) ? SIZE_MAX : limitParm;
+    this->numRanges = 0;
+    this->nextRange = 0;
+    this->readaheadDepth = 0;
+    this->readaheadMarker = 0;
+    this->postingRids.clear();
+    this->packedPageNo = Page::INVALID_NUMBER;
+
+    /// the rest of the scan runs the code for the index's key type
+    switch (index->attributeType) {
+        case INTEGER:
+            startScanTyped<int>(lowValParm, highValParm);
+            break;
+        case DOUBLE:
+            startScanTyped<double>(lowValParm, highValParm);
+            break;
+        case STRING:
+            startScanTyped<StringKey>(lowValParm, highValParm);
+            break;
+        case COMPOSITE:
+            startScanTyped<CompositeKey>(lowValParm, highValParm);
+            break;
+    }
+}
 
-    this->lowValInt = *((int*) lowValParm); /// low and high values
-    this->highValInt = *((int*) highValParm);
+template <class T>
+void BTreeCursor::startScanTyped(const void* lowValParm, const void* highValParm)
+{
+    lowVal<T>() = KeyTraits<T>::load(lowValParm); /// low and high values
+    highVal<T>() = KeyTraits<T>::load(highValParm);
 
     /// check that the scan range is valid, throw exception if not
 
-    if (this->lowValInt > this->highValInt) {
+    if (lowVal<T>() > highVal<T>()) {
         // reset variables
         this->highOp = (Operator) -1;
         this->lowOp = (Operator) -1;
-        this->lowValInt = 0;
-        this->highValInt = 0;
+        lowVal<T>() = T();
+        highVal<T>() = T();
         throw BadScanrangeException();
     }
 
     this->scanExecuting = true;
+    if (this->order == DESCENDING) {
+        scanNextFn = &BTreeCursor::scanPrevTyped<T>;
+        scanNextBatchFn = &BTreeCursor::scanPrevBatchTyped<T>;
+        seekLast<T>();
+        return;
+    }
+    scanNextFn = &BTreeCursor::scanNextTyped<T>;
+    scanNextBatchFn = &BTreeCursor::scanNextBatchTyped<T>;
+
     /// loop variables for scanning
-    currentPageNum = rootPageNum;
+    currentPageNum = index->rootPageNum;
     PageId next;
-    bool notLeaf = true;
     bool gotLowerVal = false;
-    int index = nodeOccupancy;
+    pathPageNos.clear();
+    pathChildren.clear();
+
 
+    /// descend from the root until reaching the leaf level
+    index->bufMgr->readPage(index->file, currentPageNum, currentPageData);
+    while (!isLeaf(currentPageData)) {
+        NonLeafNode<T> *scanPageNonLeaf = (NonLeafNode<T> *) currentPageData;
 
-    /// check if the root is a leaf node, otherwise scan until finding first
-    /// non - leaf node
-    if (initRootPageNo == rootPageNum) {
-        bufMgr->readPage(file, currentPageNum, currentPageData);
+        /// follow the child left of the first separator the low bound does not pass; a separator
+        /// equal to the low value may still have matching duplicates to its left unless lowOp is GT
+        int numKeys = scanPageNonLeaf->header.keyCount;
+        int child = (lowOp == GTE) ? lowerBound(scanPageNonLeaf->keyArray, numKeys, lowVal<T>())
+                                   : upperBound(scanPageNonLeaf->keyArray, numKeys, lowVal<T>());
+
+        /// unpin current page and move down a level, keeping the path for readahead
+        pathPageNos.push_back(currentPageNum);
+        pathChildren.push_back(child);
+        next = scanPageNonLeaf->pageNoArray[child];
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+        currentPageNum = next;
+        index->bufMgr->readPage(index->file, currentPageNum, currentPageData);
     }
-    else {
-        /// extra variables used in scanning
-        NonLeafNodeInt *scanPageNonLeaf;
 
-        /// root is a non-leaf node so make it one and find leaf node
-        while (true) {
-            bufMgr->readPage(this->file, currentPageNum, currentPageData);
-            scanPageNonLeaf = (NonLeafNodeInt *) currentPageData;
 
-            index = nodeOccupancy;
+    while (!gotLowerVal) {
+        // change leaf node with current page data
+        LeafNode<T> *nodeLeaf  = (LeafNode<T> *) currentPageData;
 
-            /// when level is equal to 1, then next level will contain leaf nodes
-            if (scanPageNonLeaf->level == 1) {
-                while (!(scanPageNonLeaf->pageNoArray[index]) && (index > -1)) {
-                    index -= 1;
-                } while (scanPageNonLeaf->keyArray[index - 1] >= lowValInt && (index >0)) {
-                    index -= 1;
-                }
+        /// find the first key above the low bound
+        int size = nodeLeaf->header.keyCount;
+        int keyIndex = (lowOp == GTE) ? lowerBound(leafKeys<T>(), size, lowVal<T>())
+                                      : upperBound(leafKeys<T>(), size, lowVal<T>());
 
-                /// unpin current page and update page number
-                next = scanPageNonLeaf->pageNoArray[index];
+        if (keyIndex < size) {
+            T currValue = leafKeys<T>()[keyIndex];
 
-                bufMgr->unPinPage(this->file, currentPageNum, false);
-                currentPageNum = next;
-                /// final read to get to the page on the leaf level
-                bufMgr->readPage(this->file, currentPageNum, currentPageData);
-                break;
+            /// keys are sorted, so if the first key above the low bound is past the high bound nothing matches
+            if (!((highOp == LT && currValue < highVal<T>()) || (highOp == LTE && currValue <= highVal<T>()))) {
+                index->bufMgr->unPinPage(index->file, currentPageNum, false);
+                scanExecuting = false;
+                throw NoSuchKeyFoundException();
             }
-            /// move to next level, unpin page, and update current page number
-            /// to get to the next level must find index by setting index to total node occupancy
-            /// then decrementing it for each empty page and every key that is greater than our low val
-            while (!(scanPageNonLeaf->pageNoArray[index]) && (index > -1)) {
-                index -= 1;
-            } while (scanPageNonLeaf->keyArray[index - 1] >= lowValInt && (index >0)) {
-                index -= 1;
+
+            nextEntry = keyIndex;
+            gotLowerVal = true;
+            readaheadDepth = READAHEAD_MIN_LEAVES;
+            leafPinned = std::chrono::steady_clock::now();
+            leafMicros = 0;
+            waitMicros = 0;
+            readaheadStalled = false;
+        }
+        /// leaf does not contain the value we are looking for, move on to its right sibling
+        else {
+            PageId sibling = nodeLeaf->rightSibPageNo;
+            index->bufMgr->unPinPage(index->file, currentPageNum, false);
+            if (!sibling) {
+                scanExecuting = false;
+                throw NoSuchKeyFoundException();
             }
+            currentPageNum = sibling;
+            index->bufMgr->readPage(index->file, currentPageNum, currentPageData);
+        }
+    }
+}
+
+
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanNext
+// -----------------------------------------------------------------------------
+
+void badgerdb::BTreeCursor::scanNext(RecordId& outRid)
+{
+    if (!scanExecuting) {
+        throw ScanNotInitializedException();
+    }
+
+    if(nextEntry == -1) {
+        throw IndexScanCompletedException();
+    }
+
+    (this->*scanNextFn)(outRid);
+}
+
+template <class T>
+void BTreeCursor::scanNextTyped(RecordId& outRid)
+{
+    /// fetch current node data
+    outRid = leafRids<T>()[nextEntry];
+    if (isPosting(outRid)) {
+        takePosting<T>(&outRid, NULL, 1);
+    }
+
+    /// a scan that reached its limit stops here rather than reading the next leaf
+    if (--remaining == 0) {
+        nextEntry = -1;
+        return;
+    }
+    if (postingRids.empty()) {
+        advanceTo<T>(nextEntry + 1);
+    }
+}
 
-            /// unpin current page and update page number
-            next = scanPageNonLeaf->pageNoArray[index];
-            bufMgr->unPinPage(this->file, currentPageNum, false);
-            currentPageNum = next;
+/**
+ * The whole list is read in at once, so a scan pins a single posting list page at a time, and only for as long as
+ * it takes to decode it.
+ */
+template <class T>
+size_t BTreeCursor::takePosting(RecordId *outRids, T *keys, const size_t n)
+{
+    if (postingRids.empty()) {
+        index->readPosting(leafRids<T>()[nextEntry], postingRids);
+        if (order == DESCENDING) {
+            std::reverse(postingRids.begin(), postingRids.end());
         }
+        postingPos = 0;
+    }
+
+    size_t taken = std::min(n, postingRids.size() - postingPos);
+    memcpy(outRids, &postingRids[postingPos], taken * sizeof(RecordId));
+    if (keys != NULL) {
+        std::fill(keys, keys + taken, leafKeys<T>()[nextEntry]);
+    }
+    postingPos += taken;
+    if (postingPos == postingRids.size()) {
+        postingRids.clear();
     }
+    return taken;
+}
 
+/**
+ * Moves to entry `following` of the current leaf, or to the first entry of the next leaf that has one if the
+ * current leaf has no entry there, then ends the scan if that entry is past the high bound.
+ */
+template <class T>
+void BTreeCursor::advanceTo(int following)
+{
+    if (!skipToEntry<T>(following)) {
+        nextEntry = -1;
+        return;
+    }
 
-    while (!gotLowerVal) {
-        bool validNode = false;
-        // change leaf node with current page data
-        LeafNodeInt *nodeLeaf  = (LeafNodeInt *) currentPageData;
+    /// continue only while the following entry is still within the high bound
+    T nextKey = leafKeys<T>()[following];
+    if((highOp == LTE && nextKey <= highVal<T>()) || (highOp == LT && nextKey < highVal<T>())) {
+        nextEntry = following;
+    } else if (nextRange < numRanges) {
+        seekRange<T>(following);
+    } else {
+        nextEntry = -1;
+    }
+}
 
-        ///check that the page is not NULL before searching nod
-        if ( !(nodeLeaf->ridArray[0].page_number) ) {
-            bufMgr->unPinPage(this->file, currentPageNum, false); /// unpin page and throw exception if so
-            throw NoSuchKeyFoundException();
+template <class T>
+bool BTreeCursor::skipToEntry(int &following)
+{
+    LeafNode<T>* leafNode = (LeafNode<T>*) currentPageData;
+
+    /// once the current node is used up, move to the first right sibling that has entries
+    while(following == leafNode->header.keyCount) {
+        /// has a right node been instantiated?
+        if(leafNode->rightSibPageNo == 0) {
+            return false;
         }
-        int keyIndex = 0;
-        for (int j = 0; j < sizeof(nodeLeaf -> keyArray) / sizeof(nodeLeaf -> keyArray[0]); j++) {
+        PageId new_pageID = leafNode->rightSibPageNo;
+        Page* new_page;
+        std::chrono::steady_clock::time_point asked;
+        if (readaheadDepth != 0) {
+            asked = std::chrono::steady_clock::now();
         }
-        while (keyIndex < leafOccupancy) {
-            /// get current leaf node and check if it is lesser than our value
-            int currValue = nodeLeaf->keyArray[keyIndex];
 
-            if (lowOp == GT && highOp == LT) {
-                validNode = (currValue > lowValInt && currValue < highValInt);
+        /// pin and unpin new and old pages
+        index->bufMgr->readPage(index->file, new_pageID, new_page);
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+
+        currentPageData = new_page;
+        currentPageNum = new_pageID;
+        leafNode = (LeafNode<T>*) new_page;
+        following = 0;
+
+        if (readaheadDepth != 0) {
+            timeLeaf(asked);
+            if (readaheadMarker == 0 || new_pageID == readaheadMarker) {
+                readAhead<T>();
             }
-            else if (lowOp == GT && highOp == LTE) {
-                validNode = (currValue > lowValInt && currValue <= highValInt);
+        }
+    }
+    return true;
+}
+
+/**
+ * Pages are only handed to BufMgr::prefetchPages(), which has the operating system read them in the background, so
+ * the scan goes on with the current leaf while they arrive and finds them cached when it moves right.
+ */
+template <class T>
+void BTreeCursor::readAhead()
+{
+    PageId pageNos[READAHEAD_MAX_LEAVES];
+    if (readaheadMarker == 0) {
+        /// the path leads to the leaf the scan started in, and the scan may have passed a leaf before its first
+        /// entry, so bring the path up to the current leaf first
+        int taken = 0;
+        do {
+            if (++taken > 2 || nextLeaves<T>(pageNos, 1) == 0) {
+                readaheadDepth = 0;
+                return;
             }
-            else if (lowOp == GTE && highOp == LT) {
-                validNode = (currValue >= lowValInt && currValue < highValInt);
+        } while (pageNos[0] != currentPageNum);
+    }
+
+    int n = nextLeaves<T>(pageNos, readaheadDepth);
+    if (n == 0) {
+        readaheadDepth = 0;
+        return;
+    }
+    int cold = index->bufMgr->prefetchPages(index->file, pageNos, n);
+    readaheadMarker = pageNos[0];
+    readaheadDepth = (cold == 0) ? READAHEAD_MIN_LEAVES : pacedDepth();
+    readaheadStalled = false;
+}
+
+/**
+ * Averages weigh the newest leaf by 1/8, so they follow a scan that speeds up or slows down within a batch or two.
+ */
+void BTreeCursor::timeLeaf(const std::chrono::steady_clock::time_point &asked)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double work = std::chrono::duration<double, std::micro>(asked - leafPinned).count();
+    double wait = std::chrono::duration<double, std::micro>(now - asked).count();
+    leafPinned = now;
+    leafMicros = (leafMicros == 0) ? work : leafMicros + (work - leafMicros) / 8;
+    if (wait > READAHEAD_WAIT_MICROS) {
+        waitMicros = (waitMicros == 0) ? wait : waitMicros + (wait - waitMicros) / 8;
+        readaheadStalled = true;
+    }
+}
+
+/**
+ * A batch goes out when the scan reaches the first leaf of the one before, so it has the time the scan spends in
+ * that batch to arrive: it needs about as many leaves as the scan gets through while one is read from disk, and
+ * twice that leaves room for both to vary. A scan that waited on the disk since the last batch went out at least
+ * doubles the batch, since the averages lag behind a sudden change of pace.
+ */
+int BTreeCursor::pacedDepth() const
+{
+    int depth = READAHEAD_MIN_LEAVES;
+    if (waitMicros > 0) {
+        depth = (int) std::ceil(2 * waitMicros / std::max(leafMicros, 1.0));
+    }
+    if (readaheadStalled) {
+        depth = std::max(depth, 2 * readaheadDepth);
+    }
+    return std::max(READAHEAD_MIN_LEAVES, std::min(depth, READAHEAD_MAX_LEAVES));
+}
+
+/**
+ * Leaf j + 1 of a node holds keys from separator j on, so a separator past the high bound ends the leaves worth
+ * reading. Moving to the next node above the leaves crosses the separator of an ancestor, which is checked the same
+ * way.
+ */
+template <class T>
+int BTreeCursor::nextLeaves(PageId *pageNos, int n)
+{
+    int taken = 0;
+    while (taken < n && !pathPageNos.empty()) {
+        size_t depth = pathPageNos.size();
+        Page *page;
+        index->bufMgr->readPage(index->file, pathPageNos[depth - 1], page);
+        NonLeafNode<T> *parent = (NonLeafNode<T> *) page;
+        int &child = pathChildren[depth - 1];
+        while (taken < n && child < parent->header.keyCount) {
+            if (child >= 0 && pastHigh<T>(parent->keyArray[child])) {
+                index->bufMgr->unPinPage(index->file, pathPageNos[depth - 1], false);
+                pathPageNos.clear();
+                pathChildren.clear();
+                return taken;
             }
-            else if (lowOp == GTE && highOp == LTE) {
-                validNode = (currValue >= lowValInt && currValue <= highValInt);
+            child++;
+            pageNos[taken++] = parent->pageNoArray[child];
+        }
+        index->bufMgr->unPinPage(index->file, pathPageNos[depth - 1], false);
+        if (taken == n) {
+            break;
+        }
+
+        /// this node has no children left: go up to the nearest node with a child right of the one taken
+        depth--;
+        while (depth > 0) {
+            index->bufMgr->readPage(index->file, pathPageNos[depth - 1], page);
+            if (pathChildren[depth - 1] < ((NonLeafNode<T> *) page)->header.keyCount) {
+                break;
             }
+            index->bufMgr->unPinPage(index->file, pathPageNos[depth - 1], false);
+            depth--;
+        }
+        if (depth == 0) {
+            pathPageNos.clear();
+            pathChildren.clear();
+            break;
+        }
+        NonLeafNode<T> *node = (NonLeafNode<T> *) page;
+        int next = ++pathChildren[depth - 1];
+        bool past = pastHigh<T>(node->keyArray[next - 1]);
+        PageId pageNo = node->pageNoArray[next];
+        index->bufMgr->unPinPage(index->file, pathPageNos[depth - 1], false);
+        pathPageNos.resize(depth);
+        pathChildren.resize(depth);
+        if (past) {
+            pathPageNos.clear();
+            pathChildren.clear();
+            break;
+        }
 
-            if (validNode) {
-                scanExecuting = true;
-                nextEntry = keyIndex;
-                gotLowerVal = true;
+        /// and down the first children of that child to the node above the leaves, before its first leaf
+        while (true) {
+            index->bufMgr->readPage(index->file, pageNo, page);
+            node = (NonLeafNode<T> *) page;
+            pathPageNos.push_back(pageNo);
+            if (node->header.level == 1) {
+                pathChildren.push_back(-1);
+                index->bufMgr->unPinPage(index->file, pageNo, false);
                 break;
             }
+            pathChildren.push_back(0);
+            PageId first = node->pageNoArray[0];
+            index->bufMgr->unPinPage(index->file, pageNo, false);
+            pageNo = first;
+        }
+    }
+    return taken;
+}
 
-            /// if at the last index, leaf does not contain value we are looking for
-            if (keyIndex == leafOccupancy - 1) {
-                bufMgr->unPinPage(this->file, currentPageNum, false);
-                if (nodeLeaf->rightSibPageNo) {
-                    currentPageNum = nodeLeaf->rightSibPageNo;
-                    bufMgr->readPage(this->file, currentPageNum, currentPageData);
-                }
-                else {
-                    throw NoSuchKeyFoundException();
-                }
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanNextBatch
+// -----------------------------------------------------------------------------
+
+/**
+ * Copies runs of entries with memcpy: the high bound is looked up once per leaf to find how many of its
+ * remaining entries match, instead of being compared against every key.
+ */
+size_t badgerdb::BTreeCursor::scanNextBatch(RecordId *outRids, void *outKeys, const size_t maxEntries,
+        void *outIncludes)
+{
+    if (!scanExecuting) {
+        throw ScanNotInitializedException();
+    }
+
+    return (this->*scanNextBatchFn)(outRids, outKeys, maxEntries, outIncludes);
+}
+
+template <class T>
+size_t BTreeCursor::scanNextBatchTyped(RecordId *outRids, void *outKeys, const size_t maxEntries,
+        void *outIncludes)
+{
+    T *keys = (T *) outKeys;
+    char *includes = index->includeSize > 0 ? (char *) outIncludes : NULL;
+    const int includeSize = index->includeSize;
+    size_t wanted = std::min(maxEntries, remaining);
+    size_t count = 0;
+    while (count < wanted && nextEntry != -1) {
+        LeafNode<T>* leafNode = (LeafNode<T>*) currentPageData;
+        const T *keyArray = leafKeys<T>();
+        const RecordId *ridArray = leafRids<T>();
+        int size = leafNode->header.keyCount;
+
+        /// entries of this leaf within the high bound end here
+        int end = (highOp == LTE) ? upperBound(keyArray, size, highVal<T>())
+                                  : lowerBound(keyArray, size, highVal<T>());
+
+        /// a posting list is returned from its pages, every other entry in runs that end at the next posting list
+        size_t run = 1;
+        if (isPosting(ridArray[nextEntry])) {
+            count += takePosting<T>(&outRids[count], keys != NULL ? &keys[count] : NULL, wanted - count);
+        }
+        else {
+            int last = nextEntry + (int) std::min((size_t) (end - nextEntry), wanted - count);
+            while (nextEntry + (int) run < last && !isPosting(ridArray[nextEntry + run])) {
+                run++;
+            }
+            memcpy(&outRids[count], &ridArray[nextEntry], run * sizeof(RecordId));
+            if (keys != NULL) {
+                memcpy(&keys[count], &keyArray[nextEntry], run * sizeof(T));
+            }
+            if (includes != NULL) {
+                memcpy(&includes[count * includeSize], index->includeAt(leafNode, nextEntry), run * includeSize);
+            }
+            count += run;
+        }
+
+        if (count == remaining) {
+            /// the limit is reached
+            nextEntry = -1;
+        }
+        else if (!postingRids.empty()) {
+            /// the batch is full part way through a posting list
+        }
+        else if (end < size && nextEntry + (int) run == end) {
+            /// the high bound falls inside this leaf and everything up to it has been returned
+            if (nextRange < numRanges) {
+                seekRange<T>(end);
+            } else {
+                nextEntry = -1;
             }
-            keyIndex += 1;
+        }
+        else {
+            advanceTo<T>(nextEntry + run);
+        }
+    }
+    remaining -= count;
+    return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::startMultiScan
+// -----------------------------------------------------------------------------
+
+void badgerdb::BTreeCursor::startMultiScan(const void* lowValsParm,
+				   const Operator lowOpParm,
+				   const void* highValsParm,
+				   const Operator highOpParm,
+				   const size_t numRangesParm,
+				   const size_t limitParm)
+{
+    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE)){
+        throw BadOpcodesException();
+    }
+
+    if (this->scanExecuting) {
+        this->endScan();
+    }
+
+    this->highOp = highOpParm;
+    this->lowOp = lowOpParm;
+    this->order = ASCENDING;
+    this->remaining = (limitParm == 0) ? SIZE_MAX : limitParm;
+    this->numRanges = numRangesParm;
+    this->nextRange = 0;
+    this->readaheadDepth = 0;
+    this->readaheadMarker = 0;
+    this->postingRids.clear();
+    this->packedPageNo = Page::INVALID_NUMBER;
+
+    switch (index->attributeType) {
+        case INTEGER:
+            startMultiScanTyped<int>(lowValsParm, highValsParm);
+            break;
+        case DOUBLE:
+            startMultiScanTyped<double>(lowValsParm, highValsParm);
+            break;
+        case STRING:
+            startMultiScanTyped<StringKey>(lowValsParm, highValsParm);
+            break;
+        case COMPOSITE:
+            startMultiScanTyped<CompositeKey>(lowValsParm, highValsParm);
+            break;
+    }
+}
+
+/**
+ * The ranges are sorted by low bound so that the scan only ever moves right: a range that overlaps one already
+ * scanned starts after the last entry returned, and one that lies entirely before it returns nothing.
+ */
+template <class T>
+void BTreeCursor::startMultiScanTyped(const void* lowValsParm, const void* highValsParm)
+{
+    std::vector<std::pair<T, T> > ranges(numRanges);
+    for (size_t i = 0; i < numRanges; i++) {
+        ranges[i].first = KeyTraits<T>::load((const char *) lowValsParm + i * sizeof(T));
+        ranges[i].second = KeyTraits<T>::load((const char *) highValsParm + i * sizeof(T));
+        if (ranges[i].first > ranges[i].second) {
+            numRanges = 0;
+            throw BadScanrangeException();
+        }
+    }
+    if (numRanges == 0) {
+        throw NoSuchKeyFoundException();
+    }
+    std::sort(ranges.begin(), ranges.end());
+
+    std::vector<T> &bounds = rangeBounds<T>();
+    bounds.resize(2 * numRanges);
+    for (size_t i = 0; i < numRanges; i++) {
+        bounds[2 * i] = ranges[i].first;
+        bounds[2 * i + 1] = ranges[i].second;
+    }
+
+    this->scanExecuting = true;
+    scanNextFn = &BTreeCursor::scanNextTyped<T>;
+    scanNextBatchFn = &BTreeCursor::scanNextBatchTyped<T>;
+
+    /// descend from the root to the leaf of the first low bound, then let seekRange() find its first entry
+    pathPageNos.clear();
+    pathChildren.clear();
+    pathHasHigh.clear();
+    pathHighs<T>().clear();
+    currentPageData = NULL;
+    lowVal<T>() = bounds[0];
+    descendToLow<T>();
+    seekRange<T>(0);
+
+    if (nextEntry == -1) {
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+        currentPageData = NULL;
+        scanExecuting = false;
+        throw NoSuchKeyFoundException();
+    }
+}
+
+template <class T>
+void BTreeCursor::seekRange(int following)
+{
+    std::vector<T> &bounds = rangeBounds<T>();
+    while (nextRange < numRanges) {
+        lowVal<T>() = bounds[2 * nextRange];
+        highVal<T>() = bounds[2 * nextRange + 1];
+        nextRange++;
+
+        /// the range starts in the current leaf unless its low bound is past the leaf's last key
+        LeafNode<T> *leafNode = (LeafNode<T> *) currentPageData;
+        int size = leafNode->header.keyCount;
+        int start = (lowOp == GTE) ? lowerBound(leafKeys<T>(), size, lowVal<T>())
+                                   : upperBound(leafKeys<T>(), size, lowVal<T>());
+        if (start == size && !pathPageNos.empty()) {
+            descendToLow<T>();
+            leafNode = (LeafNode<T> *) currentPageData;
+            size = leafNode->header.keyCount;
+            start = (lowOp == GTE) ? lowerBound(leafKeys<T>(), size, lowVal<T>())
+                                   : upperBound(leafKeys<T>(), size, lowVal<T>());
+        }
+        else {
+            /// entries before `following` belong to ranges already scanned
+            start = std::max(start, following);
         }
 
+        if (!skipToEntry<T>(start)) {
+            nextEntry = -1;
+            return;
+        }
+        T startKey = leafKeys<T>()[start];
+        if ((highOp == LTE && startKey <= highVal<T>()) || (highOp == LT && startKey < highVal<T>())) {
+            nextEntry = start;
+            return;
+        }
+        /// nothing in this range, try the next one from here
+        following = start;
     }
+    nextEntry = -1;
 }
 
+/**
+ * The path may be older than the current leaf, which the scan can have reached through sibling links, but its
+ * nodes still divide the keys the same way: a node whose child taken has a separator at or past the low bound, at
+ * every level above it, holds the low bound's leaf.
+ */
+template <class T>
+void BTreeCursor::descendToLow()
+{
+    std::vector<T> &highs = pathHighs<T>();
+
+    /// go up to the first node whose child taken ends before the low bound, or stop at the leaf's parent
+    size_t depth = 0;
+    while (depth + 1 < pathPageNos.size()
+           && (!pathHasHigh[depth] || (lowOp == GTE ? !(highs[depth] < lowVal<T>()) : lowVal<T>() < highs[depth]))) {
+        depth++;
+    }
+    PageId pageNo = pathPageNos.empty() ? index->rootPageNum.load() : pathPageNos[depth];
+    pathPageNos.resize(depth);
+    pathChildren.resize(depth);
+    pathHasHigh.resize(depth);
+    highs.resize(depth);
+
+    /// and down from it the way startScan() descends from the root, recording the separator right of each child
+    Page *page;
+    index->bufMgr->readPage(index->file, pageNo, page);
+    while (!isLeaf(page)) {
+        NonLeafNode<T> *node = (NonLeafNode<T> *) page;
+        int numKeys = node->header.keyCount;
+        int child = (lowOp == GTE) ? lowerBound(node->keyArray, numKeys, lowVal<T>())
+                                   : upperBound(node->keyArray, numKeys, lowVal<T>());
+        pathPageNos.push_back(pageNo);
+        pathChildren.push_back(child);
+        pathHasHigh.push_back(child < numKeys);
+        highs.push_back(child < numKeys ? node->keyArray[child] : T());
+
+        PageId next = node->pageNoArray[child];
+        index->bufMgr->unPinPage(index->file, pageNo, false);
+        pageNo = next;
+        index->bufMgr->readPage(index->file, pageNo, page);
+    }
 
+    if (currentPageData != NULL) {
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+    }
+    currentPageNum = pageNo;
+    currentPageData = page;
+}
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
+// BTreeCursor descending scans
 // -----------------------------------------------------------------------------
 
-void badgerdb::BTreeIndex::scanNext(RecordId& outRid)
+template <class T>
+void BTreeCursor::seekLast()
 {
+    pathPageNos.clear();
+    pathChildren.clear();
 
-    if(nextEntry == -1) {
-        throw IndexScanCompletedException();
+    /// follow the child right of the last separator the high bound passes; a separator equal to the high
+    /// value may still have matching duplicates to its right unless highOp is LT
+    currentPageNum = index->rootPageNum;
+    index->bufMgr->readPage(index->file, currentPageNum, currentPageData);
+    while (!isLeaf(currentPageData)) {
+        NonLeafNode<T> *scanPageNonLeaf = (NonLeafNode<T> *) currentPageData;
+        int numKeys = scanPageNonLeaf->header.keyCount;
+        int child = (highOp == LTE) ? upperBound(scanPageNonLeaf->keyArray, numKeys, highVal<T>())
+                                    : lowerBound(scanPageNonLeaf->keyArray, numKeys, highVal<T>());
+        pathPageNos.push_back(currentPageNum);
+        pathChildren.push_back(child);
+
+        PageId next = scanPageNonLeaf->pageNoArray[child];
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+        currentPageNum = next;
+        index->bufMgr->readPage(index->file, currentPageNum, currentPageData);
     }
 
-    /// fetch current node data
-    LeafNodeInt* leafNode = (LeafNodeInt*) currentPageData;
-    outRid = leafNode->ridArray[nextEntry];
+    /// the last key within the high bound is just before the first one past it, possibly in an earlier leaf
+    LeafNode<T> *nodeLeaf = (LeafNode<T> *) currentPageData;
+    int size = nodeLeaf->header.keyCount;
+    int keyIndex = (highOp == LTE) ? upperBound(leafKeys<T>(), size, highVal<T>())
+                                   : lowerBound(leafKeys<T>(), size, highVal<T>());
+    retreatTo<T>(keyIndex - 1);
+    if (nextEntry == -1) {
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+        scanExecuting = false;
+        throw NoSuchKeyFoundException();
+    }
+}
 
+template <class T>
+void BTreeCursor::scanPrevTyped(RecordId& outRid)
+{
+    outRid = leafRids<T>()[nextEntry];
+    if (isPosting(outRid)) {
+        takePosting<T>(&outRid, NULL, 1);
+    }
 
-    /// check if next entry is at the end of the node
-    if(leafNode->keyArray[nextEntry + 1] == INT_MAX || nextEntry == leafOccupancy - 1) { // validate next entry
-        /// has a right node been instantiated?
-        if(leafNode->rightSibPageNo != NULL) {
-            PageId new_pageID = leafNode->rightSibPageNo;
-            Page* new_page;
+    if (--remaining == 0) {
+        nextEntry = -1;
+        return;
+    }
+    if (postingRids.empty()) {
+        retreatTo<T>(nextEntry - 1);
+    }
+}
 
-            /// pin and unpin new and old pages
-            bufMgr->readPage(file, new_pageID, new_page);
-            bufMgr->unPinPage(file, currentPageNum, false);
+/**
+ * Like scanNextBatchTyped(), the low bound is looked up once per leaf to find how many of the entries before the
+ * current one match. Entries are copied out last first, so the batch is in decreasing key order.
+ */
+template <class T>
+size_t BTreeCursor::scanPrevBatchTyped(RecordId *outRids, void *outKeys, const size_t maxEntries,
+        void *outIncludes)
+{
+    T *keys = (T *) outKeys;
+    char *includes = index->includeSize > 0 ? (char *) outIncludes : NULL;
+    const int includeSize = index->includeSize;
+    size_t wanted = std::min(maxEntries, remaining);
+    size_t count = 0;
+    while (count < wanted && nextEntry != -1) {
+        LeafNode<T>* leafNode = (LeafNode<T>*) currentPageData;
+        const T *keyArray = leafKeys<T>();
+        const RecordId *ridArray = leafRids<T>();
 
-            currentPageData = new_page;
-            currentPageNum = new_pageID;
+        /// entries of this leaf within the low bound start here
+        int start = (lowOp == GTE) ? lowerBound(keyArray, nextEntry + 1, lowVal<T>())
+                                   : upperBound(keyArray, nextEntry + 1, lowVal<T>());
 
-            /// Check if node should go back to start
-            if((highOp == LTE && leafNode->keyArray[0] <= highValInt) || (highOp == LT && leafNode->keyArray[0] < highValInt)) {
-                nextEntry = 0;
-            } else {
-                nextEntry = -1;
+        size_t run = 1;
+        if (isPosting(ridArray[nextEntry])) {
+            count += takePosting<T>(&outRids[count], keys != NULL ? &keys[count] : NULL, wanted - count);
+        }
+        else {
+            size_t most = std::min((size_t) (nextEntry + 1 - start), wanted - count);
+            while (run < most && !isPosting(ridArray[nextEntry - run])) {
+                run++;
+            }
+            for (size_t i = 0; i < run; i++) {
+                outRids[count + i] = ridArray[nextEntry - i];
+            }
+            if (keys != NULL) {
+                for (size_t i = 0; i < run; i++) {
+                    keys[count + i] = keyArray[nextEntry - i];
+                }
+            }
+            if (includes != NULL) {
+                for (size_t i = 0; i < run; i++) {
+                    memcpy(&includes[(count + i) * includeSize], index->includeAt(leafNode, nextEntry - i), includeSize);
+                }
             }
-        } else {
+            count += run;
+        }
+
+        if ((start > 0 && nextEntry - (int) run + 1 == start && postingRids.empty()) || count == remaining) {
+            /// the low bound falls inside this leaf and everything down to it has been returned, or the limit is reached
             nextEntry = -1;
         }
-    } else {
-        /// after handling special cases, check if scan should continue to next node
-        if((this->highOp == LTE && leafNode->keyArray[nextEntry+1] <= highValInt) || (highOp == LT && leafNode->keyArray[nextEntry+1] < highValInt)) {
-            nextEntry++;
-            return;
-        } else {
+        else if (!postingRids.empty()) {
+            /// the batch is full part way through a posting list
+        }
+        else {
+            retreatTo<T>(nextEntry - run);
+        }
+    }
+    remaining -= count;
+    return count;
+}
+
+template <class T>
+void BTreeCursor::retreatTo(int preceding)
+{
+    LeafNode<T>* leafNode = (LeafNode<T>*) currentPageData;
+
+    /// once the start of the current node is passed, move to the first earlier leaf that has entries
+    while (preceding < 0) {
+        if (!previousLeaf<T>()) {
             nextEntry = -1;
+            return;
         }
+        leafNode = (LeafNode<T>*) currentPageData;
+        preceding = leafNode->header.keyCount - 1;
+    }
+
+    /// continue only while the preceding entry is still within the low bound
+    T prevKey = leafKeys<T>()[preceding];
+    if ((lowOp == GTE && prevKey >= lowVal<T>()) || (lowOp == GT && prevKey > lowVal<T>())) {
+        nextEntry = preceding;
+    } else {
+        nextEntry = -1;
+    }
+}
+
+template <class T>
+bool BTreeCursor::previousLeaf()
+{
+    /// go up to the nearest node on the path that has a child left of the one taken
+    size_t depth = pathChildren.size();
+    while (depth > 0 && pathChildren[depth - 1] == 0) {
+        depth--;
+    }
+    if (depth == 0) {
+        return false;
     }
+    pathPageNos.resize(depth);
+    pathChildren.resize(depth);
+    pathChildren[depth - 1]--;
+
+    /// and down the last children from the one left of it
+    Page *page;
+    index->bufMgr->readPage(index->file, pathPageNos[depth - 1], page);
+    PageId pageNo = ((NonLeafNode<T> *) page)->pageNoArray[pathChildren[depth - 1]];
+    index->bufMgr->unPinPage(index->file, pathPageNos[depth - 1], false);
+    index->bufMgr->readPage(index->file, pageNo, page);
+    while (!isLeaf(page)) {
+        NonLeafNode<T> *node = (NonLeafNode<T> *) page;
+        pathPageNos.push_back(pageNo);
+        pathChildren.push_back(node->header.keyCount);
+
+        PageId next = node->pageNoArray[node->header.keyCount];
+        index->bufMgr->unPinPage(index->file, pageNo, false);
+        pageNo = next;
+        index->bufMgr->readPage(index->file, pageNo, page);
+    }
+
+    index->bufMgr->unPinPage(index->file, currentPageNum, false);
+    currentPageNum = pageNo;
+    currentPageData = page;
+    return true;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::endScan
+// BTreeCursor::endScan
 // -----------------------------------------------------------------------------
 //
-void badgerdb::BTreeIndex::endScan() {
+void badgerdb::BTreeCursor::endScan() {
     /// if trying to end scan when scan has not been started, throw exception
     if (!(scanExecuting)) {
         throw ScanNotInitializedException();
@@ -663,8 +4840,21 @@ void badgerdb::BTreeIndex::endScan() {
         currentPageData = NULL;
         nextEntry = -1;
         scanExecuting = false;
+        pathPageNos.clear();
+        pathChildren.clear();
+        pathHasHigh.clear();
+        pathHighsInt.clear();
+        pathHighsDouble.clear();
+        pathHighsString.clear();
+        pathHighsComposite.clear();
+        numRanges = 0;
+        nextRange = 0;
+        readaheadDepth = 0;
+        readaheadMarker = 0;
+        postingRids.clear();
+        packedPageNo = Page::INVALID_NUMBER;
 
-        bufMgr->unPinPage(this->file, currentPageNum, false);
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
         currentPageNum = -1;
     }
 }
@@ -12,11 +12,17 @@
 #include "string.h"
 #include <sstream>
 #include <stdio.h>
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "key_normalize.h"
 
 namespace badgerdb
 {
@@ -28,7 +34,8 @@ enum Datatype
 {
 	INTEGER = 0,
 	DOUBLE = 1,
-	STRING = 2
+	STRING = 2,
+	COMPOSITE = 3	/* several attributes, encoded into a CompositeKey */
 };
 
 /**
@@ -42,18 +49,233 @@ enum Operator
 	GT		/* Greater Than */
 };
 
+/**
+ * @brief Order a scan returns its entries in. Passed to BTreeIndex::startScan() method.
+ */
+enum ScanOrder
+{
+	ASCENDING,	/* from the low bound up */
+	DESCENDING	/* from the high bound down */
+};
+
+
+/**
+ * @brief How a newly created index file is populated from its base relation. Passed to the BTreeIndex constructor.
+ */
+enum BuildMode
+{
+	INSERT_BUILD,	/* call insertEntry() once per record of the relation */
+	BULK_LOAD		/* sort all entries and build the tree bottom-up in one pass */
+};
+
+/**
+ * @brief How the leaves of a new index store their entries. Passed to the BTreeIndex constructor.
+ */
+enum LeafFormat
+{
+	PLAIN_LEAVES,	/* every key and record id whole, in LeafNode pages */
+	PACKED_LEAVES	/* INTEGER keys and record ids as 16-bit deltas from a base per page, in PackedLeafNode pages;
+					   STRING keys without the prefix they share with the rest of their page, in PackedStringLeafNode pages */
+};
+
+/**
+ * @brief Default fraction of each leaf and non-leaf page filled by the bulk loader.
+ */
+const double DEFAULT_FILL_FACTOR = 1.0;
+
+/**
+ * @brief Default fraction of the entries kept on the left when a node on the right edge of the tree is split by
+ * an insert past its last key. Keys inserted in increasing order then leave nearly full pages behind them instead
+ * of half full ones.
+ */
+const double DEFAULT_APPEND_SPLIT_RATIO = 0.9;
+
+/**
+ * @brief On-disk format of index files written by this code, stored in IndexMetaInfo::formatVersion.
+ * Files written before nodes had a NodeHeader read 0 there, files whose NodeHeader has no version word read 1,
+ * files written before DOUBLE and STRING keys had their own node layouts read 2, and files whose meta page has no
+ * free list read 3, files whose non-leaf nodes hold no entry counts read 4, files whose meta page has no
+ * INCLUDE columns read 5, files whose leaves have no posting lists read 6, files whose meta page has no leaf
+ * format read 7, files whose meta page has no key columns read 8, and files that may hold -0.0 as a DOUBLE key
+ * read 9; all are rebuilt when opened.
+ */
+const int INDEX_FORMAT_VERSION = 10;
+
+/**
+ * @brief Kind of node stored in a B+Tree page. Kept in NodeHeader::nodeType.
+ */
+enum NodeType
+{
+	LEAF_NODE = 1,
+	NON_LEAF_NODE = 2,
+	FREE_NODE = 3,
+	POSTING_NODE = 4,
+	PACKED_LEAF_NODE = 5
+};
+
+/**
+ * @brief Header at the start of every B+Tree node page. Holds the number of keys in the node, so the
+ * occupancy of a node is known without looking at its arrays, and the latch that guards the node.
+ */
+struct NodeHeader{
+  /**
+   * OptimisticLatch version word. Bumped by every change to the node, locked while a writer changes it.
+   */
+	std::uint64_t version;
+
+  /**
+   * LEAF_NODE, NON_LEAF_NODE, FREE_NODE, POSTING_NODE or PACKED_LEAF_NODE.
+   */
+	std::uint16_t nodeType;
+
+  /**
+   * Height of the node above the leaves: 0 for leaves, 1 for the non-leaf nodes just above them, and so on.
+   */
+	std::uint16_t level;
+
+  /**
+   * Number of keys in the node. A non-leaf node has one more child than it has keys.
+   */
+	std::int32_t keyCount;
+};
+
+/**
+ * @brief Size of String key.
+ */
+const  int STRINGSIZE = 10;
+
+/**
+ * @brief Key of a STRING index: the first STRINGSIZE characters of the attribute, zero padded if the string
+ * is shorter. Keys compare like strncmp over STRINGSIZE characters; as set() pads them with zeros, that is how
+ * their bytes compare, which compareBytes() does a word at a time.
+ */
+struct StringKey{
+	char data[ STRINGSIZE ];
+
+	void set( const char *s )
+	{
+		size_t length = strnlen( s, STRINGSIZE );
+		memcpy( data, s, length );
+		memset( data + length, 0, STRINGSIZE - length );
+	}
+};
+
+inline bool operator<( const StringKey& a, const StringKey& b ) { return compareBytes<STRINGSIZE>( a.data, b.data ) < 0; }
+inline bool operator>( const StringKey& a, const StringKey& b ) { return b < a; }
+inline bool operator<=( const StringKey& a, const StringKey& b ) { return !( b < a ); }
+inline bool operator>=( const StringKey& a, const StringKey& b ) { return !( a < b ); }
+inline bool operator==( const StringKey& a, const StringKey& b ) { return memcmp( a.data, b.data, STRINGSIZE ) == 0; }
+inline bool operator!=( const StringKey& a, const StringKey& b ) { return !( a == b ); }
+
+/**
+ * @brief Size of Composite key.
+ */
+const  int COMPOSITESIZE = 24;
+
+/**
+ * @brief Key of a COMPOSITE index: its key columns encoded one after the other so that keys compare like memcmp
+ * over COMPOSITESIZE bytes, in the order of the columns, each as its own type compares. Bytes past the last column
+ * are zero. BTreeIndex::loadKey() and BTreeIndex::makeKey() build them.
+ */
+struct CompositeKey{
+	unsigned char data[ COMPOSITESIZE ];
+};
+
+inline bool operator<( const CompositeKey& a, const CompositeKey& b ) { return compareBytes<COMPOSITESIZE>( a.data, b.data ) < 0; }
+inline bool operator>( const CompositeKey& a, const CompositeKey& b ) { return b < a; }
+inline bool operator<=( const CompositeKey& a, const CompositeKey& b ) { return !( b < a ); }
+inline bool operator>=( const CompositeKey& a, const CompositeKey& b ) { return !( a < b ); }
+inline bool operator==( const CompositeKey& a, const CompositeKey& b ) { return memcmp( a.data, b.data, COMPOSITESIZE ) == 0; }
+inline bool operator!=( const CompositeKey& a, const CompositeKey& b ) { return !( a == b ); }
 
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+//                                                  header                 sibling ptr             key               rid
+const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+//                                                     header                 sibling ptr             key               rid
+const  int DOUBLEARRAYLEAFSIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( RecordId ) );
+
+/**
+ * @brief Number of key slots in B+Tree leaf for STRING key.
+ */
+//                                                     header                 sibling ptr             key                  rid
+const  int STRINGARRAYLEAFSIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) ) / ( sizeof( StringKey ) + sizeof( RecordId ) );
+
+/**
+ * @brief Number of key slots in B+Tree leaf for COMPOSITE key.
+ */
+//                                                        header                 sibling ptr             key                     rid
+const  int COMPOSITEARRAYLEAFSIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) ) / ( sizeof( CompositeKey ) + sizeof( RecordId ) );
 
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
  */
-//                                                     level     extra pageNo                  key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+//                                                     header            extra pageNo + count                                      key       pageNo         count
+const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) - sizeof( std::uint64_t ) ) / ( sizeof( int ) + sizeof( PageId ) + sizeof( std::uint64_t ) );
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+//                                                        header            extra pageNo + count                                       key          pageNo         count
+const  int DOUBLEARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) - sizeof( std::uint64_t ) ) / ( sizeof( double ) + sizeof( PageId ) + sizeof( std::uint64_t ) );
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for STRING key.
+ */
+//                                                        header            extra pageNo + count                                         key            pageNo         count
+const  int STRINGARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) - sizeof( std::uint64_t ) ) / ( sizeof( StringKey ) + sizeof( PageId ) + sizeof( std::uint64_t ) );
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for COMPOSITE key.
+ */
+//                                                           header            extra pageNo + count                                          key               pageNo         count
+const  int COMPOSITEARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) - sizeof( std::uint64_t ) ) / ( sizeof( CompositeKey ) + sizeof( PageId ) + sizeof( std::uint64_t ) );
+
+/**
+ * @brief Compile-time description of a key type: the Datatype it indexes, how many keys fit in its nodes and how a key
+ * is read from the value passed to the index. The tree code is templated on the key type and reads everything
+ * type-specific from here, so no type switch is needed once a call has been dispatched.
+ */
+template <class T>
+struct KeyTraits;
+
+template <>
+struct KeyTraits<int>{
+	static const Datatype TYPE = INTEGER;
+	static const int LEAF_SIZE = INTARRAYLEAFSIZE;
+	static const int NONLEAF_SIZE = INTARRAYNONLEAFSIZE;
+	static int load( const void *value ) { int key; memcpy( &key, value, sizeof( key ) ); return key; }
+};
+
+template <>
+struct KeyTraits<double>{
+	static const Datatype TYPE = DOUBLE;
+	static const int LEAF_SIZE = DOUBLEARRAYLEAFSIZE;
+	static const int NONLEAF_SIZE = DOUBLEARRAYNONLEAFSIZE;
+	/// -0.0 is stored as 0.0, so that the keys of a node compare as their normalizeDouble() bits do
+	static double load( const void *value ) { double key; memcpy( &key, value, sizeof( key ) ); return key == 0.0 ? 0.0 : key; }
+};
+
+template <>
+struct KeyTraits<StringKey>{
+	static const Datatype TYPE = STRING;
+	static const int LEAF_SIZE = STRINGARRAYLEAFSIZE;
+	static const int NONLEAF_SIZE = STRINGARRAYNONLEAFSIZE;
+	static StringKey load( const void *value ) { StringKey key; key.set( (const char *) value ); return key; }
+};
+
+template <>
+struct KeyTraits<CompositeKey>{
+	static const Datatype TYPE = COMPOSITE;
+	static const int LEAF_SIZE = COMPOSITEARRAYLEAFSIZE;
+	static const int NONLEAF_SIZE = COMPOSITEARRAYNONLEAFSIZE;
+	static CompositeKey load( const void *value ) { CompositeKey key; memcpy( &key, value, sizeof( key ) ); return key; }
+};
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
@@ -64,10 +286,13 @@ class RIDKeyPair{
 public:
 	RecordId rid;
 	T key;
-	void set( RecordId r, T k)
+	/// INCLUDE bytes of the entry, or NULL for an index without INCLUDE columns. Points into the caller's buffer.
+	const char *include;
+	void set( RecordId r, T k, const char *inc = NULL )
 	{
 		rid = r;
 		key = k;
+		include = inc;
 	}
 };
 
@@ -90,23 +315,69 @@ public:
 /**
  * @brief Overloaded operator to compare the key values of two rid-key pairs
  * and if they are the same compares to see if the first pair has
- * a smaller rid.pageNo value.
+ * a smaller rid.pageNo value (and then rid.slot_number), so sorting a run of equal keys
+ * leaves them in record id order.
 */
 template <class T>
 bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 {
 	if( r1.key != r2.key )
 		return r1.key < r2.key;
-	else
+	else if( r1.rid.page_number != r2.rid.page_number )
 		return r1.rid.page_number < r2.rid.page_number;
+	else
+		return r1.rid.slot_number < r2.rid.slot_number;
 }
 
+/**
+ * @brief Most INCLUDE columns an index can have, and most bytes they may take in an entry together.
+ */
+const int MAX_INCLUDE_COLUMNS = 4;
+const int MAX_INCLUDE_SIZE = 64;
+
+/**
+ * @brief A fixed-width attribute of the relation that a covering index copies into every leaf entry, next to the key
+ * and record id, so that scans can return it without reading the record. Passed to the BTreeIndex constructor.
+ */
+struct IncludeColumn{
+  /**
+   * Offset of the attribute inside records.
+   */
+	int byteOffset;
+
+  /**
+   * Number of bytes of the attribute.
+   */
+	int size;
+};
+
+/**
+ * @brief Most attributes a COMPOSITE key can be made of.
+ */
+const int MAX_KEY_COLUMNS = 4;
+
+/**
+ * @brief An attribute of the relation that is part of the key of a COMPOSITE index. Keys compare on the first column,
+ * then on the second where the first ones are equal, and so on. Passed to the BTreeIndex constructor.
+ */
+struct KeyColumn{
+  /**
+   * Offset of the attribute inside records.
+   */
+	int byteOffset;
+
+  /**
+   * Type of the attribute: INTEGER, DOUBLE or STRING.
+   */
+	Datatype type;
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
  * Contains the relation name for which the index is created, the byte offset
- * of the key value on which the index is made, the type of the key and the page no
- * of the root page. Root page starts as page 2 but since a split can occur
+ * of the key value on which the index is made, the type of the key, the page no
+ * of the root page and the version of the node format. Root page starts as page 2 but since a split can occur
  * at the root the root page may get moved up and get a new page no.
 */
 struct IndexMetaInfo{
@@ -129,49 +400,110 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
+
+  /**
+   * INDEX_FORMAT_VERSION of the code that wrote the file.
+   */
+	int formatVersion;
+
+  /**
+   * First page of the list of node pages freed by deletes, 0 if there are none. BlobFile cannot delete pages,
+   * so freed pages are kept here and handed out again before the file grows.
+   */
+	PageId freeListHead;
+
+  /**
+   * Number of INCLUDE columns, and the columns in the order their bytes follow each other in an entry.
+   */
+	int includeCount;
+	IncludeColumn includeColumns[ MAX_INCLUDE_COLUMNS ];
+
+  /**
+   * Format of the leaves of the index.
+   */
+	LeafFormat leafFormat;
+
+  /**
+   * Number of attributes the key is made of, and the attributes in key order. A single one for an index that is not
+   * COMPOSITE.
+   */
+	int keyColumnCount;
+	KeyColumn keyColumns[ MAX_KEY_COLUMNS ];
+};
+
+/**
+ * @brief A node page taken out of the tree, waiting on the free list in IndexMetaInfo::freeListHead.
+ * The version word in its header carries on counting when the page is reused.
+*/
+struct FreeNode{
+  /**
+   * nodeType is FREE_NODE, and the version is obsolete.
+   */
+	NodeHeader header;
+
+  /**
+   * Next page on the free list, 0 at the end.
+   */
+	PageId nextFree;
 };
 
 /*
 Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
 These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
-node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
-at this level are just above the leaf nodes. Otherwise set to 0.
+node they are. Both start with a NodeHeader, so any node page can be cast to NodeHeader to find out what it is. Only the first
+header.keyCount entries of the arrays are in use.
 */
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all non-leaf nodes, for keys of type T.
 */
-struct NonLeafNodeInt{
+template <class T>
+struct NonLeafNode{
+  /**
+   * Node type, level and number of keys.
+   */
+	NodeHeader header;
+
   /**
-   * Level of the node in the tree.
+   * Number of entries in the leaves under each child page, so the entries in a key range can be counted from the
+   * nodes on the two paths to its ends. Kept before the keys, where the 8-byte counts need no padding.
    */
-	int level;
+	std::uint64_t countArray[ KeyTraits<T>::NONLEAF_SIZE + 1 ];
 
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	T keyArray[ KeyTraits<T>::NONLEAF_SIZE ];
 
   /**
    * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
+	PageId pageNoArray[ KeyTraits<T>::NONLEAF_SIZE + 1 ];
 };
 
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all leaf nodes, for keys of type T.
 */
-struct LeafNodeInt{
+template <class T>
+struct LeafNode{
+  /**
+   * Node type, level and number of keys.
+   */
+	NodeHeader header;
+
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	T keyArray[ KeyTraits<T>::LEAF_SIZE ];
 
   /**
-   * Stores RecordIds.
+   * Stores RecordIds. A leaf of an index with INCLUDE columns holds fewer entries than LEAF_SIZE, and keeps the
+   * INCLUDE bytes of its entries in the end of this array that it does not use; see leafIncludes().
+   * An entry whose slot_number is Page::INVALID_SLOT, which no record has, stands for a posting list instead: the
+   * record ids of padding entries with its key, kept in PostingNode pages from page_number on.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	RecordId ridArray[ KeyTraits<T>::LEAF_SIZE ];
 
   /**
    * Page number of the leaf on the right side.
@@ -180,142 +512,1374 @@ struct LeafNodeInt{
 	PageId rightSibPageNo;
 };
 
+typedef NonLeafNode<int> NonLeafNodeInt;
+typedef NonLeafNode<double> NonLeafNodeDouble;
+typedef NonLeafNode<StringKey> NonLeafNodeString;
+typedef LeafNode<int> LeafNodeInt;
+typedef LeafNode<double> LeafNodeDouble;
+typedef LeafNode<StringKey> LeafNodeString;
+
+static_assert( sizeof( NonLeafNodeInt ) <= Page::SIZE && sizeof( LeafNodeInt ) <= Page::SIZE, "INTEGER nodes must fit in a page" );
+static_assert( sizeof( NonLeafNodeDouble ) <= Page::SIZE && sizeof( LeafNodeDouble ) <= Page::SIZE, "DOUBLE nodes must fit in a page" );
+static_assert( sizeof( NonLeafNodeString ) <= Page::SIZE && sizeof( LeafNodeString ) <= Page::SIZE, "STRING nodes must fit in a page" );
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
-*/
-class BTreeIndex {
+ * @brief Fewest entries with one key that a full leaf moves to a posting list of their own. A posting list takes at
+ * least a page, which only pays off for a run about this long; entries whose key already has a posting list join it
+ * whenever their leaf fills up, however few they are.
+ */
+const int POSTING_MIN_RUN = 256;
 
- private:
+/**
+ * @brief Most record ids in one posting list, whose length is kept in the 16-bit RecordId::padding of its leaf entry.
+ * A longer run of one key takes several posting lists.
+ */
+const int POSTING_MAX_RIDS = 65535;
 
+/**
+ * @brief A page of a posting list: record ids of entries that share a key, sorted by page and slot number and
+ * stored as the differences between consecutive ids, in 7-bit groups with the top bit set on all but the last
+ * byte. Consecutive records on a page take a byte each, against a key and a RecordId per entry in a leaf. The first
+ * id of every page is stored whole, so each page decodes on its own. A posting list only changes while its leaf is
+ * write locked, and is read under the leaf's version.
+*/
+struct PostingNode{
   /**
-   * File object for the index file.
+   * nodeType is POSTING_NODE, and keyCount the number of record ids on the page.
    */
-	File		*file;
+	NodeHeader header;
 
   /**
-   * Buffer Manager Instance.
+   * Next page of the posting list, 0 on its last page.
    */
-	BufMgr	*bufMgr;
+	PageId nextPageNo;
 
   /**
-   * Page number of meta page.
+   * Bytes of data in use.
    */
-	PageId	headerPageNum;
+	std::int32_t usedBytes;
 
   /**
-   * page number of root page of B+ tree inside index file.
+   * Last record id on the page, as page_number << 16 | slot_number, so a delete finds the page holding an id
+   * without decoding the pages before it.
    */
-	PageId	rootPageNum;
+	std::uint64_t lastRid;
 
   /**
-   * page number of root page of B+ tree inside index file.
+   * The encoded record ids.
    */
-    PageId	initRootPageNo;
+	unsigned char data[ Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) - sizeof( std::int32_t ) - sizeof( std::uint64_t ) ];
+};
 
-    PageId firstPageNumber;
+static_assert( sizeof( PostingNode ) == Page::SIZE, "posting list pages must fill a page" );
 
+/**
+ * @brief Number of entries in a packed INTEGER leaf.
+ */
+//                                                        header               key and page base                  sibling ptr          key, page and slot
+const  int PACKED_LEAF_SIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( std::int32_t ) - sizeof( PageId ) - sizeof( PageId ) ) / ( 3 * sizeof( std::uint16_t ) );
+
+/**
+ * @brief Leaf of an INTEGER index with PACKED_LEAVES: each key is kept as its difference from keyBase, and each
+ * record id as the difference of its page number from pageBase and its slot number, in 16 bits apiece. An entry
+ * takes 6 bytes instead of 12, so a leaf holds twice as many entries as a LeafNodeInt, as long as its keys and its
+ * record ids' page numbers each span less than 65536. Keys stay sorted as deltas, so a leaf is searched without
+ * decoding it. Posting lists are never kept in a packed leaf. The header and rightSibPageNo are where a LeafNodeInt
+ * has them, so code that only counts entries or follows sibling links reads either kind of leaf.
+*/
+struct PackedLeafNode{
   /**
-   * Datatype of attribute over which index is built.
+   * nodeType is PACKED_LEAF_NODE.
    */
-	Datatype	attributeType;
+	NodeHeader header;
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * Key and page number the deltas are added to: no greater than any key and page number in the leaf.
    */
-	int 		attrByteOffset;
+	std::int32_t keyBase;
+	PageId pageBase;
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Key, page number and slot number of each entry.
    */
-	int			leafOccupancy;
+	std::uint16_t keyDelta[ PACKED_LEAF_SIZE ];
+	std::uint16_t pageDelta[ PACKED_LEAF_SIZE ];
+	std::uint16_t slotArray[ PACKED_LEAF_SIZE ];
+
+	char unused[ Page::SIZE - sizeof( NodeHeader ) - sizeof( std::int32_t ) - 2 * sizeof( PageId ) - 3 * PACKED_LEAF_SIZE * sizeof( std::uint16_t ) ];
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Page number of the leaf on the right side.
    */
-	int			nodeOccupancy;
+	PageId rightSibPageNo;
+};
 
+static_assert( sizeof( PackedLeafNode ) == Page::SIZE && sizeof( LeafNodeInt ) == Page::SIZE
+		&& offsetof( PackedLeafNode, rightSibPageNo ) == offsetof( LeafNodeInt, rightSibPageNo ),
+		"packed leaves must keep their sibling link where INTEGER leaves do" );
+/// a leaf that overflows by one entry splits into two halves that fit in plain leaves
+static_assert( PACKED_LEAF_SIZE < 2 * INTARRAYLEAFSIZE, "half a full packed leaf must fit in a plain leaf" );
 
-	// MEMBERS SPECIFIC TO SCANNING
+/**
+ * @brief Bytes of a packed STRING leaf that hold its entries.
+ */
+//                                                          header              prefix length          prefix          sibling ptr
+const  int PACKED_STRING_LEAF_BYTES = Page::SIZE - sizeof( NodeHeader ) - sizeof( std::uint16_t ) - STRINGSIZE - sizeof( PageId );
+
+/**
+ * @brief Most entries in a packed STRING leaf, which it holds when its keys are all the same. Kept below twice what a
+ * LeafNodeString holds, so that a leaf that overflows by one entry splits into two halves that fit in plain leaves.
+ */
+const  int PACKED_STRING_LEAF_SIZE = 2 * STRINGARRAYLEAFSIZE - 1;
 
+/**
+ * @brief Leaf of a STRING index with PACKED_LEAVES: the first prefixLength bytes, which every key in the leaf starts
+ * with, are kept once in prefix, and each entry is the rest of its key followed by its record id. An entry takes
+ * STRINGSIZE - prefixLength + sizeof( RecordId ) bytes, so the longer the prefix the more entries the leaf holds: as
+ * many as a LeafNodeString with no prefix, and up to PACKED_STRING_LEAF_SIZE. Entries stay sorted by the rest of
+ * their keys, so a leaf is searched without rebuilding its keys. The header and rightSibPageNo are where a
+ * LeafNodeString has them.
+*/
+struct PackedStringLeafNode{
   /**
-   * True if an index scan has been started.
+   * nodeType is PACKED_LEAF_NODE.
    */
-	bool		scanExecuting;
+	NodeHeader header;
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Number of bytes at the start of every key in the leaf kept in prefix, at most STRINGSIZE.
    */
-	int			nextEntry;
+	std::uint16_t prefixLength;
+	char prefix[ STRINGSIZE ];
 
   /**
-   * Page number of current page being scanned.
+   * The entries, one after the other.
    */
-	PageId	currentPageNum;
+	unsigned char data[ PACKED_STRING_LEAF_BYTES ];
 
   /**
-   * Current Page being scanned.
+   * Page number of the leaf on the right side.
    */
-	Page		*currentPageData;
+	PageId rightSibPageNo;
+};
+
+static_assert( sizeof( PackedStringLeafNode ) == Page::SIZE && sizeof( LeafNodeString ) == Page::SIZE
+		&& offsetof( PackedStringLeafNode, rightSibPageNo ) == offsetof( LeafNodeString, rightSibPageNo ),
+		"packed leaves must keep their sibling link where STRING leaves do" );
+
+/**
+ * @brief Number of entries a leaf holds when each of them carries includeSize INCLUDE bytes: as many as fit in
+ * ridArray with their bytes after them. Every leaf of a tree has the same capacity, LEAF_SIZE without INCLUDE columns.
+ */
+template <class T>
+inline int coveringLeafSize( const int includeSize )
+{
+	return KeyTraits<T>::LEAF_SIZE * (int) sizeof( RecordId ) / ( (int) sizeof( RecordId ) + includeSize );
+}
+
+/**
+ * @brief Start of the INCLUDE bytes of a leaf holding at most capacity entries: entry i's are includeSize bytes from
+ * i * includeSize on.
+ */
+template <class T>
+inline char *leafIncludes( LeafNode<T> *leaf, const int capacity )
+{
+	return (char *) &leaf->ridArray[ capacity ];
+}
+
+
+/**
+ * @brief The keys a descent from the root sends to a node: greater than low unless hasLow is false, and no
+ * greater than high unless hasHigh is false. Bounded by the separators on either side of the node's parent entries.
+*/
+template <class T>
+struct KeyRange{
+	bool hasLow;
+	T low;
+	bool hasHigh;
+	T high;
+
+	bool contains( const T &key ) const { return ( !hasLow || low < key ) && ( !hasHigh || key <= high ); }
+};
+
+/**
+ * @brief Most non-leaf levels a tree can have. Every non-leaf node has at least two children, so a tree this tall
+ * would need more leaves than a file has page numbers.
+ */
+const int MAX_TREE_HEIGHT = 32;
+
+/**
+ * @brief Leaves an ascending scan asks the BufMgr to read ahead in its first batch, and the fewest and most it asks
+ * for in one batch. In between, batches are sized from how fast the scan moves through leaves against how long a
+ * leaf takes to come from disk.
+ */
+const int READAHEAD_MIN_LEAVES = 4;
+const int READAHEAD_MAX_LEAVES = 64;
+
+/**
+ * @brief Microseconds past which moving to the next leaf counts as waiting on the disk: copying a page the operating
+ * system already holds takes a few.
+ */
+const double READAHEAD_WAIT_MICROS = 20;
 
+/**
+ * @brief Non-leaf nodes a descent went through from the root to a leaf, and the child it took in each. A write to the
+ * leaf adds to the entry count of every one of those children.
+*/
+struct DescentPath{
   /**
-   * Low INTEGER value for scan.
+   * Number of non-leaf nodes on the path, 0 if the root is a leaf.
    */
-	int			lowValInt;
+	int depth;
 
   /**
-   * Low DOUBLE value for scan.
+   * Page number of each node, from the root down.
    */
-	double	lowValDouble;
+	PageId pageNo[ MAX_TREE_HEIGHT ];
 
   /**
-   * Low STRING value for scan.
+   * The node pages, pinned while a descent holds the path. Not used by a path kept in a LeafFinger.
    */
-	std::string	lowValString;
+	Page *page[ MAX_TREE_HEIGHT ];
 
   /**
-   * High INTEGER value for scan.
+   * Index of the child taken in each node.
    */
-	int			highValInt;
+	int child[ MAX_TREE_HEIGHT ];
+};
 
+/**
+ * @brief The leaf the last descending insert went to, with the keys that belong in it. Inserts of keys in that
+ * range go straight to the leaf while no split has happened since the finger was set.
+*/
+template <class T>
+struct LeafFinger{
   /**
-   * High DOUBLE value for scan.
+   * Guards the other members with OptimisticLatch.
    */
-	double	highValDouble;
+	std::uint64_t version;
 
   /**
-   * High STRING value for scan.
+   * Page number of the leaf, 0 if there is none yet.
    */
-	std::string highValString;
-	
+	PageId leafNo;
+
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * BTreeIndex::structureVersion when the descent to the leaf started.
    */
-	Operator	lowOp;
+	std::uint64_t structureVersion;
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Keys that belong in the leaf.
    */
-	Operator	highOp;
+	KeyRange<T> range;
 
-	
- public:
+  /**
+   * Non-leaf nodes above the leaf, whose entry counts an insert through the finger adds to.
+   */
+	DescentPath path;
+};
+
+/**
+ * @brief Shape of a B+Tree, as returned by BTreeIndex::getStatistics(). Fill factors are the fraction of the
+ * key slots in use over all pages of that kind.
+*/
+struct IndexStatistics{
+  /**
+   * Number of levels, counting the leaf level.
+   */
+	int height;
+
+  /**
+   * Number of leaf pages.
+   */
+	size_t leafPages;
+
+  /**
+   * Number of non-leaf pages.
+   */
+	size_t nonLeafPages;
+
+  /**
+   * Number of entries in all leaves, counting each record id of a posting list.
+   */
+	size_t entries;
+
+  /**
+   * Number of posting list pages.
+   */
+	size_t postingPages;
+
+  /**
+   * Number of leaf pages in the packed format, also counted in leafPages.
+   */
+	size_t packedLeafPages;
+
+  /**
+   * Fraction of leaf key slots in use. A posting list takes one slot, and a packed leaf has as many as it holds packed.
+   */
+	double leafFillFactor;
+
+  /**
+   * Fraction of non-leaf key slots in use, 0 if the root is a leaf.
+   */
+	double nonLeafFillFactor;
+
+  /**
+   * Number of pages on the free list, waiting to be reused.
+   */
+	size_t freePages;
+};
+
+class BTreeIndex;
+class FileScan;
+
+/**
+ * @brief A range scan over a BTreeIndex. Each cursor owns its bounds, its pinned leaf and its position, so any
+ * number of cursors can be open on one index at the same time, from one thread or several. Cursors read
+ * without locking and must not run while other threads insert into the index.
+*/
+class BTreeCursor {
+
+ private:
+
+  /**
+   * Index being scanned.
+   */
+	BTreeIndex	*index;
+
+  /**
+   * True if an index scan has been started.
+   */
+	bool		scanExecuting;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+	int			nextEntry;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+	int			lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+	double	lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+	StringKey	lowValString;
+
+  /**
+   * Low COMPOSITE value for scan.
+   */
+	CompositeKey	lowValComposite;
+
+  /**
+   * High INTEGER value for scan.
+   */
+	int			highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+	double	highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+	StringKey	highValString;
+
+  /**
+   * High COMPOSITE value for scan.
+   */
+	CompositeKey	highValComposite;
+	
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+  /**
+   * Order the entries are returned in.
+   */
+	ScanOrder	order;
+
+  /**
+   * Entries the scan may still return before its limit ends it, SIZE_MAX if it has no limit.
+   */
+	size_t	remaining;
+
+  /**
+   * Non-leaf nodes a descending scan went through to reach the current leaf, from the root down, and the index of
+   * the child it took in each. Leaves only link to their right sibling, so the previous leaf is found by going back
+   * up this path to the first node with a child further left and down the rightmost children of that child.
+   * A multi-range scan keeps the path of its last descent here too, and an ascending scan of one range the path to
+   * the last leaf it has read ahead.
+   */
+	std::vector<PageId>	pathPageNos;
+	std::vector<int>	pathChildren;
+
+  /**
+   * For each node on the path of a multi-range scan, whether the child taken has a separator on its right, and that
+   * separator, in pathHighsInt, pathHighsDouble, pathHighsString or pathHighsComposite. The next range is looked for under the deepest
+   * node whose child still takes its low bound.
+   */
+	std::vector<bool>	pathHasHigh;
+	std::vector<int>	pathHighsInt;
+	std::vector<double>	pathHighsDouble;
+	std::vector<StringKey>	pathHighsString;
+	std::vector<CompositeKey>	pathHighsComposite;
+
+  /**
+   * Low and high bound of every range of a multi-range scan, one after the other and sorted by low bound, for
+   * INTEGER, DOUBLE, STRING and COMPOSITE keys. Empty for scans of a single range.
+   */
+	std::vector<int>	rangeBoundsInt;
+	std::vector<double>	rangeBoundsDouble;
+	std::vector<StringKey>	rangeBoundsString;
+	std::vector<CompositeKey>	rangeBoundsComposite;
+
+  /**
+   * Number of ranges of a multi-range scan, and the index of the first one the scan has not started yet.
+   */
+	size_t	numRanges;
+	size_t	nextRange;
+
+  /**
+   * Leaves the next readahead batch asks for; 0 if the scan does not read ahead.
+   */
+	int	readaheadDepth;
+
+  /**
+   * Leaf whose arrival sends the next readahead batch: the first leaf of the last batch, so a batch is always on
+   * its way while the scan reads the one before. 0 until the scan first moves to a right sibling, which sends the
+   * first batch; short scans that stay in one leaf read nothing ahead.
+   */
+	PageId	readaheadMarker;
+
+  /**
+   * Pace of a scan that reads ahead: when it pinned its current leaf, and running averages, in microseconds, of the
+   * time it spends in a leaf and of the time moving to a leaf keeps it waiting on the disk. The averages are 0 until
+   * measured.
+   */
+	std::chrono::steady_clock::time_point	leafPinned;
+	double	leafMicros;
+	double	waitMicros;
+
+  /**
+   * True if moving to a leaf has waited on the disk since the last readahead batch went out.
+   */
+	bool	readaheadStalled;
+
+  /**
+   * Record ids of the posting list at nextEntry once the scan has reached it, in the order the scan returns them,
+   * and the index of the next one to return. Empty while nextEntry is an entry of its own.
+   */
+	std::vector<RecordId>	postingRids;
+	size_t	postingPos;
+
+  /**
+   * Keys and record ids of the current leaf, decoded, if it is a packed leaf, and the page number of the leaf they
+   * were decoded from; Page::INVALID_NUMBER if none has been.
+   */
+	std::vector<int>	packedKeysInt;
+	std::vector<StringKey>	packedKeysString;
+	std::vector<RecordId>	packedRids;
+	PageId	packedPageNo;
+
+  /**
+   * scanNextTyped() or scanPrevTyped() for the key type and order of the scan, chosen by startScan().
+   */
+	void (BTreeCursor::*scanNextFn)(RecordId &outRid);
+
+  /**
+   * scanNextBatchTyped() or scanPrevBatchTyped() for the key type and order of the scan, chosen by startScan().
+   */
+	size_t (BTreeCursor::*scanNextBatchFn)(RecordId *outRids, void *outKeys, const size_t maxEntries, void *outIncludes);
+
+	BTreeCursor(const BTreeCursor &);
+	BTreeCursor &operator=(const BTreeCursor &);
+
+  /**
+   * The low / high bound member for key type T: lowValInt, lowValDouble, lowValString or lowValComposite and the
+   * matching high one.
+   */
+	template <class T> T &lowVal();
+	template <class T> T &highVal();
+
+  /**
+   * Whether key is beyond the high bound of the scan.
+   */
+	template <class T> bool pastHigh(const T &key);
+
+  /**
+   * pathHighsInt, pathHighsDouble, pathHighsString or pathHighsComposite, and the rangeBounds member of the same type,
+   * for key type T.
+   */
+	template <class T> std::vector<T> &pathHighs();
+	template <class T> std::vector<T> &rangeBounds();
+
+  /**
+   * Keys and record ids of the current leaf: its own arrays, or packedKeys() and packedRids for a packed leaf, which
+   * is decoded the first time they are asked for. Valid until the scan moves to another leaf.
+   */
+	template <class T> const T *leafKeys();
+	template <class T> const RecordId *leafRids();
+
+  /**
+   * packedKeysInt or packedKeysString for key type T, the types that have packed leaves.
+   */
+	template <class T> std::vector<T> &packedKeys();
+
+  /**
+   * Decode the current leaf, a packed one, into packedKeys() and packedRids unless they already hold it.
+   */
+	template <class T> void unpackLeaf();
+
+  /**
+   * startScan(), scanNext() and scanNextBatch() once the key type is known.
+   */
+	template <class T> void startScanTyped(const void* lowVal, const void* highVal);
+	template <class T> void scanNextTyped(RecordId& outRid);
+	template <class T> size_t scanNextBatchTyped(RecordId *outRids, void *outKeys, const size_t maxEntries,
+			void *outIncludes);
+
+  /**
+   * Copy up to n record ids of the posting list at nextEntry to outRids, and its key as many times to keys unless
+   * keys is NULL, reading the list in when the scan first gets to it. postingRids is emptied once all are returned.
+   *
+   * @return Number of record ids copied.
+   */
+	template <class T> size_t takePosting(RecordId *outRids, T *keys, const size_t n);
+
+  /**
+   * Position the scan on entry `following` of the current leaf, moving right past leaves that have no entry
+   * there, and end the scan if that entry is beyond the high bound or there is none. A multi-range scan goes on
+   * with its next range instead.
+   */
+	template <class T> void advanceTo(int following);
+
+  /**
+   * Move right past leaves until entry `following` of the current leaf exists, unpinning the leaves passed.
+   *
+   * @return False if there is no entry after the current one. The current leaf is left as it is.
+   */
+	template <class T> bool skipToEntry(int &following);
+
+  /**
+   * Send the next readahead batch of leaves to the BufMgr, and size the batch after it with pacedDepth(), or
+   * READAHEAD_MIN_LEAVES if the leaves were all in the buffer pool.
+   */
+	template <class T> void readAhead();
+
+  /**
+   * Add the move to the current leaf, asked for at asked and done now, to the scan's pace.
+   */
+	void timeLeaf(const std::chrono::steady_clock::time_point &asked);
+
+  /**
+   * Leaves the next readahead batch needs so that it arrives before the scan gets to it, from the scan's pace.
+   */
+	int pacedDepth() const;
+
+  /**
+   * Take up to n leaves that follow the last one read ahead, from the leaf-level nodes on the readahead path, moving
+   * the path on to the next of those nodes as each runs out. Stops at the first leaf that starts past the high bound.
+   *
+   * @param pageNos	Page numbers of the leaves are returned in this
+   * @return Number of leaves taken; fewer than n at the end of the index or of the range.
+   */
+	template <class T> int nextLeaves(PageId *pageNos, int n);
+
+  /**
+   * startMultiScan() once the key type is known.
+   */
+	template <class T> void startMultiScanTyped(const void* lowVals, const void* highVals);
+
+  /**
+   * The current range is done with entry `following` of the current leaf: position the scan on the first entry of
+   * a later range that is there or after it, or end the scan if there is none.
+   */
+	template <class T> void seekRange(int following);
+
+  /**
+   * Make the current leaf the one the low bound of the current range belongs in, descending from the deepest node on
+   * the path whose child still takes it, or from the root if there is no path, and recording the path taken.
+   */
+	template <class T> void descendToLow();
+
+  /**
+   * Descend to the leaf holding the last entry within the high bound, recording the path, and position the scan
+   * on that entry. Part of startScanTyped() for descending scans.
+   *
+   * @throws  NoSuchKeyFoundException If no entry is within both bounds.
+   */
+	template <class T> void seekLast();
+
+  /**
+   * scanNextTyped() and scanNextBatchTyped() for descending scans, which walk each leaf from its end.
+   */
+	template <class T> void scanPrevTyped(RecordId& outRid);
+	template <class T> size_t scanPrevBatchTyped(RecordId *outRids, void *outKeys, const size_t maxEntries,
+			void *outIncludes);
+
+  /**
+   * Position the scan on entry `preceding` of the current leaf, moving to earlier leaves while it is before the
+   * start of the leaf, and end the scan if that entry is below the low bound or there is none.
+   */
+	template <class T> void retreatTo(int preceding);
+
+  /**
+   * Move to the leaf before the current one through pathPageNos, unpinning the current leaf.
+   *
+   * @return False if the current leaf is the first one. The current leaf is left as it is.
+   */
+	template <class T> bool previousLeaf();
+
+ public:
+
+  /**
+   * BTreeCursor Constructor. The cursor starts out with no scan executing.
+   *
+   * @param index		Index to scan. Must outlive the cursor.
+   */
+	BTreeCursor(BTreeIndex *index);
+
+  /**
+   * BTreeCursor Destructor. Ends the scan if one is executing, unpinning its leaf. Does not throw.
+   */
+	~BTreeCursor();
+
+  /**
+	 * Begin a filtered scan of the index, with the same semantics as BTreeIndex::startScan().
+	 * Ends the scan this cursor was executing, if any; other cursors are not affected.
+   * @param lowVal	Low value of range, pointer to integer / double / char string / CompositeKey
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string / CompositeKey
+   * @param highOp	High operator (LT/LTE)
+   * @param order		ASCENDING to return entries from the low bound up, DESCENDING from the high bound down
+   * @param limit		Most entries the scan returns, 0 for no limit
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+			const ScanOrder order = ASCENDING, const size_t limit = 0);
+
+  /**
+	 * Begin a scan of several ranges in one left-to-right pass, with the same semantics as
+	 * BTreeIndex::startMultiScan(). Ends the scan this cursor was executing, if any.
+	**/
+	void startMultiScan(const void* lowVals, const Operator lowOp, const void* highVals, const Operator highOp,
+			const size_t numRanges, const size_t limit = 0);
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	void scanNext(RecordId& outRid);
+
+  /**
+	 * Fetch up to maxEntries of the next matching entries at once, copying them straight out of the current
+	 * leaf and the leaves after it. A batch shorter than maxEntries means the scan has completed; calls after
+	 * that return 0.
+   * @param outRids			Buffer for at least maxEntries record ids
+   * @param outKeys			Buffer for at least maxEntries keys of the attribute type (int, double or StringKey), or NULL
+   * @param maxEntries	Number of entries to fetch at most
+   * @param outIncludes	Buffer for the INCLUDE bytes of at least maxEntries entries, BTreeIndex::getIncludeSize() per
+   *										entry, or NULL. With the keys they make an index-only scan, which never reads the relation.
+   * @return Number of entries written to outRids (and outKeys and outIncludes).
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	size_t scanNextBatch(RecordId *outRids, void *outKeys, const size_t maxEntries, void *outIncludes = NULL);
+
+  /**
+	 * Terminate the scan. Unpin the pinned leaf. Reset scan specific variables.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	void endScan();
+
+  /**
+   * True if a scan has been started and not ended.
+   */
+	bool isExecuting() const { return scanExecuting; }
+};
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation. startScan(), scanNext() and endScan() drive one built-in scan; open a BTreeCursor for each
+ * additional scan that has to run at the same time.
+ *
+ * insertEntry(), insertEntries(), containsKey() and lookup() may be called from any number of threads at once. They synchronize through
+ * optimistic lock coupling on the NodeHeader::version of each node: readers validate versions instead of locking,
+ * an insert locks only the leaf it changes, and inserts that split nodes are serialized by structureLatch.
+ * Scans must not run while other threads insert.
+ *
+ * A key with many entries, as low-cardinality attributes have, keeps their record ids in posting lists: a leaf that
+ * fills up moves long runs of one key to compressed PostingNode pages before it splits, leaving a single entry for
+ * each run, and bulk loading does the same for every long run. Indexes with INCLUDE columns keep every entry apart.
+ *
+ * An INTEGER index created with PACKED_LEAVES stores its leaves as PackedLeafNode pages wherever their entries pack,
+ * holding twice as many entries per page, and LeafNode pages elsewhere. It keeps every entry apart as well. A STRING
+ * index created with PACKED_LEAVES stores each leaf whose keys share a prefix as a PackedStringLeafNode, which keeps
+ * the prefix once and holds more entries the longer it is.
+*/
+class BTreeIndex {
+
+	friend class BTreeCursor;
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file. Read without locks by concurrent operations.
+   */
+	std::atomic<PageId>	rootPageNum;
+
+    PageId firstPageNumber;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Attributes the key is made of; a single one, at attrByteOffset, unless attributeType is COMPOSITE.
+   */
+	std::vector<KeyColumn>	keyColumns;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key and the INCLUDE columns.
+   */
+	int			leafOccupancy;
+
+  /**
+   * INCLUDE columns copied into every leaf entry, and the number of bytes they take in an entry together.
+   */
+	std::vector<IncludeColumn>	includeColumns;
+	int			includeSize;
+
+  /**
+   * How the leaves store their entries.
+   */
+	LeafFormat	leafFormat;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+	int			nodeOccupancy;
+
+  /**
+   * Fraction of the entries kept on the left when a node on the right edge of the tree splits for an append.
+   */
+	double	appendSplitRatio;
+
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Cursor behind startScan(), scanNext() and endScan().
+   */
+	BTreeCursor	scanCursor;
+
+
+  /**
+   * insertEntryTyped() for the attribute type, chosen by the constructor.
+   */
+	void (BTreeIndex::*insertEntryFn)(const void* key, const RecordId rid, const char* include);
+
+  /**
+   * lookupTyped() for the attribute type, chosen by the constructor.
+   */
+	size_t (BTreeIndex::*lookupFn)(const void* key, std::vector<RecordId> *outRids);
+
+  /**
+   * insertEntriesTyped() for the attribute type, chosen by the constructor.
+   */
+	void (BTreeIndex::*insertEntriesFn)(const void* keys, const RecordId* rids, size_t n, const char* includes);
+
+  /**
+   * deleteEntryTyped() for the attribute type, chosen by the constructor.
+   */
+	bool (BTreeIndex::*deleteEntryFn)(const void* key, const RecordId rid);
+
+  /**
+   * edgeEntryTyped() for the attribute type, chosen by the constructor.
+   */
+	bool (BTreeIndex::*edgeEntryFn)(const bool last, void* outKey, RecordId* outRid);
+
+  /**
+   * countRangeTyped() for the attribute type, chosen by the constructor.
+   */
+	size_t (BTreeIndex::*countRangeFn)(const void* lowVal, const Operator lowOp, const void* highVal,
+			const Operator highOp);
+
+  /**
+   * parallelScanTyped() for the attribute type, chosen by the constructor.
+   */
+	size_t (BTreeIndex::*parallelScanFn)(const void* lowVal, const Operator lowOp, const void* highVal,
+			const Operator highOp, std::vector<RecordId> &outRids, unsigned workers, const bool ordered);
+
+  /**
+   * In-memory copy of IndexMetaInfo::freeListHead. Only changed with structureLatch held.
+   */
+	PageId	freeListHead;
+
+  /**
+   * Set leafOccupancy, nodeOccupancy, insertEntryFn, lookupFn, insertEntriesFn, deleteEntryFn, edgeEntryFn,
+   * countRangeFn and parallelScanFn for key type T.
+   */
+	template <class T> void initKeyType();
+
+  /**
+   * Fill a new index from every record the scan returns, as the constructor's buildMode says.
+   */
+	template <class T> void buildIndex(FileScan &scan, const BuildMode buildMode, const double fillFactor);
+
+  /**
+   * Key of type T of a record: the attribute at attrByteOffset, or the key columns encoded for a COMPOSITE key.
+   */
+	template <class T> T recordKey(const char *record) const;
+
+  /**
+   * Build the tree bottom-up from the given entries: sort them, write packed leaves left to right and then
+   * each non-leaf level above them, allocating every page in order through BufMgr::allocPage.
+   * Updates rootPageNum and the meta page.
+   *
+   * @param entries		Key-rid pairs of every record in the base relation. Sorted in place.
+   * @param fillFactor	Fraction of leafOccupancy / nodeOccupancy to fill on each page.
+   */
+	template <class T> void bulkLoad(std::vector< RIDKeyPair<T> > &entries, const double fillFactor);
+
+  /**
+   * Write the non-leaf levels above level, grouping perNode of its entries under each node, until a single node is
+   * left. That node becomes the root: rootPageNum and the meta page are updated.
+   *
+   * @param level		Page number and first key of each node on the level below, left to right. Consumed.
+   * @param counts	Number of entries under each node in level. Consumed.
+   * @param height	Level of the nodes written first, one above the nodes in level
+   * @param perNode	Most children of a node written here
+   */
+	template <class T> void buildUpperLevels(std::vector< PageKeyPair<T> > &level, std::vector<std::uint64_t> &counts,
+			int height, const size_t perNode);
+
+  /**
+   * Held by inserts that split nodes, so at most one thread at a time changes non-leaf nodes or the root.
+   */
+	std::mutex	structureLatch;
+
+  /**
+   * Advanced under structureLatch when a split starts and again when it ends, so it is odd while one is running
+   * and changes whenever the key range of a leaf may have.
+   */
+	std::atomic<std::uint64_t>	structureVersion;
+
+  /**
+   * Number of inserts and deletes that do not hold structureLatch and are adding to the entry counts on the path to
+   * their leaf. A split or merge waits for it to drop to 0 once it has advanced structureVersion, and no new one
+   * starts after that, so the paths those writers hold stay valid until they are done.
+   */
+	std::atomic<int>	countUpdaters;
+
+  /**
+   * Advance structureVersion and wait until no writer is adding to entry counts. Called with structureLatch held,
+   * before a split or merge changes any node.
+   */
+	void beginStructureChange();
+
+  /**
+   * Nodes write locked by the split or merge running under structureLatch, in the order they were locked.
+   */
+	std::vector<std::uint64_t *>	structureLocks;
+
+  /**
+   * OptimisticLatch::writeLock(), writeUnlock() and writeUnlockObsolete() for code that only runs under
+   * structureLatch, which keep the word in structureLocks for as long as it is locked.
+   */
+	void lockNode(std::uint64_t *word);
+	void unlockNode(std::uint64_t *word);
+	void unlockNodeObsolete(std::uint64_t *word);
+
+  /**
+   * Take word out of structureLocks, if it is there.
+   */
+	void forgetLock(std::uint64_t *word);
+
+  /**
+   * @brief A split or merge, for as long as it is in scope. Made with structureLatch held, it calls
+   * beginStructureChange(); when it goes, however the scope is left, it makes structureVersion even again. Nodes
+   * still in structureLocks by then, which only an exception leaves behind, are unlocked as they are, so that
+   * neither readers nor later writers wait for them forever.
+   */
+	class StructureChange {
+	 public:
+		explicit StructureChange(BTreeIndex &index);
+		~StructureChange();
+
+	 private:
+		BTreeIndex &index;
+
+		StructureChange(const StructureChange &);
+		StructureChange &operator=(const StructureChange &);
+	};
+
+  /**
+   * Start adding to the entry counts on a path found while structureVersion was structure. Called with the leaf
+   * at the end of the path write locked.
+   *
+   * @return False if a split or merge has run or started since, in which case the path may be wrong and the write
+   * has to start over. Otherwise the counts and the leaf are changed and leaveCountUpdate() called.
+   */
+	bool enterCountUpdate(const std::uint64_t structure);
+	void leaveCountUpdate() { this->countUpdaters--; }
+
+  /**
+   * Add delta to the entry count of every child the path went through.
+   */
+	template <class T> void addToPathCounts(const DescentPath &path, const std::int64_t delta);
+
+  /**
+   * Unpin the nodes of a path that findLeafOptimistic() kept pinned. Does nothing if path is NULL.
+   */
+	void releasePath(DescentPath *path, const bool dirty);
+
+  /**
+   * Number of entries in the leaves under a node: the entries the keys of a leaf stand for, the sum of its entry
+   * counts otherwise.
+   */
+	template <class T> std::uint64_t subtreeCount(const PageId pageNo);
+
+  /**
+   * Last leaf an insert descended to, for INTEGER, DOUBLE, STRING and COMPOSITE keys. Only the one for attributeType
+   * is used.
+   */
+	LeafFinger<int>	fingerInt;
+	LeafFinger<double>	fingerDouble;
+	LeafFinger<StringKey>	fingerString;
+	LeafFinger<CompositeKey>	fingerComposite;
+
+  /**
+   * fingerInt, fingerDouble, fingerString or fingerComposite for key type T.
+   */
+	template <class T> LeafFinger<T> &finger();
+
+  /**
+   * Insert the pair into the leaf of the finger if the key is in its range, no split has happened since the finger
+   * was set and the leaf has room.
+   *
+   * @return False if the insert has to descend from the root.
+   */
+	template <class T> bool insertAtFinger(const RIDKeyPair<T> &newPair);
+
+  /**
+   * Point the finger at a leaf, unless another thread is moving it or structure says a split was running.
+   *
+   * @param leafNo		Leaf an insert just went to
+   * @param range			Keys that belong in the leaf, as found by the descent
+   * @param path			Non-leaf nodes the descent went through
+   * @param structure	structureVersion before the descent started
+   */
+	template <class T> void setFinger(const PageId leafNo, const KeyRange<T> &range, const DescentPath &path,
+			const std::uint64_t structure);
+
+  /**
+   * Descend from the root to the leaf where key belongs without locking, validating every node version on the way.
+   *
+   * @param key				Key to search for
+   * @param leafNo		Page number of the leaf returned in this
+   * @param leafPage	The leaf, pinned, returned in this
+   * @param version		Version of the leaf when it was reached, to validate reads from it against
+   * @param range			If not NULL, the keys that belong in the leaf are returned in this
+   * @param path			If not NULL, the non-leaf nodes on the way are returned in this, still pinned
+   * @return False if a concurrent write got in the way. Nothing is left pinned and the caller restarts.
+   */
+	template <class T> bool findLeafOptimistic(const T &key, PageId &leafNo, Page *&leafPage, std::uint64_t &version,
+			KeyRange<T> *range = NULL, DescentPath *path = NULL);
+
+  /**
+   * Descend like findLeafOptimistic(), always taking the first child, or the last one if last is true, to the
+   * first or last leaf of the tree.
+   */
+	template <class T> bool findEdgeLeafOptimistic(const bool last, PageId &leafNo, Page *&leafPage,
+			std::uint64_t &version);
+
+  /**
+   * minKey() if last is false, maxKey() if it is true, with keys of type T.
+   */
+	template <class T> bool edgeEntryTyped(const bool last, void* outKey, RecordId* outRid);
+
+  /**
+   * countRange() with keys read as T.
+   */
+	template <class T> size_t countRangeTyped(const void* lowVal, const Operator lowOp, const void* highVal,
+			const Operator highOp);
+
+  /**
+   * Count the entries whose key is less than key, or no greater than it if inclusive is true, from the entry
+   * counts of the nodes on one path from the root to a leaf, without locking.
+   *
+   * @param rank	The count is returned in this
+   * @return False if a concurrent write got in the way. Nothing is left pinned and the caller restarts.
+   */
+	template <class T> bool rankOptimistic(const T &key, const bool inclusive, std::uint64_t &rank);
+
+  /**
+   * parallelScan() with keys read as T.
+   */
+	template <class T> size_t parallelScanTyped(const void* lowVal, const Operator lowOp, const void* highVal,
+			const Operator highOp, std::vector<RecordId> &outRids, unsigned workers, const bool ordered);
+
+  /**
+   * Find the separator in a node just above the leaves that is nearest to the rank-th entry of the index, going
+   * down the child holding that entry at every level by the entry counts. Call with structureLatch held.
+   *
+   * @param separator	The separator is returned in this
+   * @return False if the root is a leaf, which has no separators.
+   */
+	template <class T> bool separatorNearRank(std::uint64_t rank, T &separator);
+
+  /**
+   * Insert the pair into its leaf under the leaf's latch alone, if the leaf has room.
+   *
+   * @return False if the leaf is full and has to be split.
+   */
+	template <class T> bool insertOptimistic(const RIDKeyPair<T> &newPair);
+
+  /**
+   * insertEntry(), lookup() and insertEntries() with keys read as T. lookupTyped() stops at the first match and
+   * collects nothing if outRids is NULL, which is how containsKey() uses it.
+   */
+	template <class T> void insertEntryTyped(const void* key, const RecordId rid, const char* include);
+	template <class T> size_t lookupTyped(const void* key, std::vector<RecordId> *outRids);
+	template <class T> void insertEntriesTyped(const void* keys, const RecordId* rids, size_t n,
+			const char* includes);
+
+  /**
+   * Insert the first pairs of a sorted run below currPage, as many as belong in the leaf the first one goes to.
+   * Must be called with structureLatch held. A leaf that cannot take them all is split into as many leaves as the
+   * entries need, and a non-leaf that cannot take all the new children it gets is split the same way. Follows the
+   * protocol of insertHelper(): a node that was split is returned still locked and pinned, with newChildren holding
+   * the page number and separator key of each node that now follows it; otherwise currPage is unpinned.
+   *
+   * @param run					Sorted pairs to insert
+   * @param count				Number of pairs in run
+   * @param newChildren	Nodes split off currPage are returned in this, left to right. Empty if there was no split.
+   * @param rightmost		True if currPage is the last node of its level
+   * @return Number of pairs inserted, from the start of run
+   */
+	template <class T> size_t insertRunHelper(Page *currPage, PageId currPageNo, const RIDKeyPair<T> *run, size_t count,
+			std::vector< PageKeyPair<T> > &newChildren, const bool rightmost);
+
+  /**
+   * Get a page for a new node: the first page of the free list if there is one, otherwise a new page of the file.
+   * Must be called with structureLatch held, or while the index is being built. The page is pinned; initLeaf() or
+   * initNonLeaf() make it a node.
+   */
+	void allocNode(PageId &pageNo, Page *&page);
+
+  /**
+   * Put a node that has been taken out of the tree on the free list. The node must be write locked: it is unlocked
+   * as obsolete, so every reader still on it restarts, and unpinned. Must be called with structureLatch held.
+   */
+	void freeNode(const PageId pageNo, Page *page);
+
+  /**
+   * Write freeListHead to the meta page.
+   */
+	void writeFreeListHead();
+
+  /**
+   * True if a node other than the root holding keyCount of occupancy keys has to take entries from a sibling or
+   * be merged with it: when less than a quarter of it is used.
+   */
+	static bool underflows(const int keyCount, const int occupancy) { return keyCount < occupancy / 4; }
+
+  /**
+   * deleteEntry() with the key read as a T.
+   */
+	template <class T> bool deleteEntryTyped(const void* key, const RecordId rid);
+
+  /**
+   * Outcome of deleteOptimistic().
+   */
+	enum DeleteResult
+	{
+		DELETE_DONE,			/* the entry was removed */
+		DELETE_NOT_FOUND,	/* there is no such entry */
+		DELETE_STRUCTURAL	/* the leaf would underflow, or its parent is not on the path the descent took: the
+								   delete has to go through deleteHelper() */
+	};
+
+  /**
+   * Remove the pair from its leaf under the leaf's latch alone, if the leaf does not underflow by it.
+   */
+	template <class T> DeleteResult deleteOptimistic(const RIDKeyPair<T> &pair);
+
+  /**
+   * Remove the pair from the subtree under currPage, rebalancing every child that underflows on the way back up.
+   * Must be called with structureLatch held. currPage is unpinned on return.
+   *
+   * @param underflow	Set to true if currPage underflows after the delete
+   * @return False if the pair is not in the subtree.
+   */
+	template <class T> bool deleteHelper(Page *currPage, PageId currPageNo, const RIDKeyPair<T> &pair, bool &underflow);
+
+  /**
+   * Fix an underflowing child of node: merge it with a neighbour under the same parent if both fit in one node,
+   * otherwise move entries between them until they hold about as many each. Must be called with structureLatch held.
+   *
+   * @param node	Pinned parent of the child
+   * @param child	Index of the child in node->pageNoArray
+   */
+	template <class T> void rebalanceChild(NonLeafNode<T> *node, const int child);
+
+  /**
+   * rebalanceChild() for two leaves of an index with PACKED_LEAVES, locked by the caller.
+   *
+   * @param left	Index in node->pageNoArray of the left leaf
+   * @param merged	Set to true if the right leaf was emptied into the left one and taken out of node
+   */
+	template <class T> void rebalancePacked(NonLeafNode<T> *node, const int left, Page *leftPage, Page *rightPage,
+	                                        bool &merged);
+
+  /**
+   * Sizes of the pieces a node with total entries is cut into when it splits into as many nodes as it takes.
+   * Pieces are as even as possible, except that appends to the right edge of the tree fill every piece but the last
+   * as splits for single appends do.
+   *
+   * @param total			Entries to divide (keys of a leaf, children of a non-leaf)
+   * @param capacity	Most entries one node holds
+   * @param append		True if every new entry goes past the last one of a node on the right edge of the tree
+   */
+	std::vector<int> pieceSizes(const int total, const int capacity, const bool append) const;
+
+	template <class T> void insertHelper(Page *currPage, PageId currPageNo, const RIDKeyPair<T> newPair, PageKeyPair<T> *&newChild,
+			const bool rightmost);
+
+  /**
+   * Number of entries to keep on the left when a node on the right edge of the tree is split by an entry going
+   * past its last one: appendSplitRatio of them, but at least half and never all of them.
+   *
+   * @param total		Entries to divide, including the one being inserted
+   */
+	int appendSplitPoint(const int total) const;
+
+  /**
+   * Add the pages and entries under pageNo to stats, the keys of its leaves to leafKeys, the entries they can hold
+   * to leafSlots and the keys of its non-leaf nodes to nonLeafKeys.
+   */
+	template <class T> void collectStatistics(const PageId pageNo, IndexStatistics &stats, size_t &leafKeys,
+			size_t &leafSlots, size_t &nonLeafKeys);
+
+	template <class T> void insertLeaf(LeafNode<T> *leaf, RIDKeyPair<T> newPair);
+
+  /**
+   * True if a leaf's entries go to posting lists when it fills up: the index has no INCLUDE columns and plain leaves.
+   */
+	bool usesPostings() const { return includeSize == 0 && leafFormat == PLAIN_LEAVES; }
+
+  /**
+   * True if count sorted pairs can be merged into a leaf as it is: a plain leaf needs free slots for them, and a packed
+   * one also needs their keys and page numbers close enough to its own to pack.
+   */
+	template <class T> bool leafHasRoom(const Page *page, const RIDKeyPair<T> *run, const size_t count) const;
+
+  /**
+   * True if n sorted entries fit in one leaf, packed or plain. Only for an index without INCLUDE columns.
+   */
+	template <class T> bool fitsLeaf(const T *keys, const RecordId *rids, const int n) const;
+
+  /**
+   * Make a leaf page hold n sorted entries that fitsLeaf(), packed if the index has PACKED_LEAVES and they pack,
+   * plain otherwise. The version and right sibling of the page are kept.
+   */
+	template <class T> void writeLeaf(Page *page, const T *keys, const RecordId *rids, const int n);
+
+  /**
+   * insertHelper() for a leaf of an index with PACKED_LEAVES that cannot take the pair as it is: its entries and the
+   * pair are written again, in the leaf if they fit in one and split over it and a new leaf otherwise. Follows the
+   * protocol of insertHelper(). The leaf must be write locked.
+   */
+	template <class T> void repackLeaf(Page *page, PageId pageNo, const RIDKeyPair<T> &newPair, PageKeyPair<T> *&newChild);
+
+  /**
+   * INCLUDE bytes of entry i of a leaf.
+   */
+	template <class T> char *includeAt(LeafNode<T> *leaf, const int i) const
+	{
+		return leafIncludes(leaf, leafOccupancy) + i * includeSize;
+	}
+
+  /**
+   * Write pair as entry i of a leaf.
+   */
+	template <class T> void setEntry(LeafNode<T> *leaf, const int i, const RIDKeyPair<T> &pair);
+
+  /**
+   * Move n entries of leaf src from position from, with their INCLUDE bytes, to position to of leaf dst. The leaves
+   * may be the same one and the entries overlap.
+   */
+	template <class T> void moveEntries(LeafNode<T> *dst, const int to, LeafNode<T> *src, const int from, const int n);
+
+  /**
+   * Merge count sorted pairs into a leaf with room for them, from the back so every entry moves once. A new key
+   * goes after the keys already there that are equal to it, as in insertLeaf().
+   */
+	template <class T> void mergeIntoLeaf(LeafNode<T> *leaf, const RIDKeyPair<T> *run, const size_t count);
+
+  /**
+   * Take entry pos out of a leaf, moving the entries after it down.
+   */
+	template <class T> void removeFromLeaf(LeafNode<T> *leaf, const int pos);
+  /**
+   * Turn the runs of equal keys among n sorted entries into posting lists where it pays: runs of POSTING_MIN_RUN
+   * entries or more, and runs whose key already has a posting list with room. The entries left are moved down over
+   * those they replace. Must be called with structureLatch held, or while the index is being built, and only for
+   * an index without INCLUDE columns.
+   *
+   * @return Number of entries left.
+   */
+	template <class T> size_t makePostings(T *keys, RecordId *rids, const size_t n);
+  /**
+   * Write n sorted record ids as a posting list, on pages taken from spare first and on newly allocated ones once
+   * they run out.
+   *
+   * @return First page of the list.
+   */
+	PageId writePosting(const RecordId *rids, const size_t n, std::vector<PageId> &spare);
+  /**
+   * Append the record ids of the posting list ref stands for to out. If latch is not NULL, the leaf holding ref is
+   * being read without locking, and its version is validated before every page number is followed.
+   *
+   * @param latch		NodeHeader::version of the leaf, or NULL if the leaf cannot change
+   * @param version	Version of the leaf its other reads are validated against
+   * @return False if the leaf changed, in which case the reader restarts.
+   */
+	bool readPosting(const RecordId &ref, std::vector<RecordId> &out, const std::uint64_t *latch = NULL,
+			const std::uint64_t version = 0);
+  /**
+   * Take one record id equal to rid out of the posting list ref stands for, and make ref a record id of its own once
+   * only one is left. Reads only the page the id is on. Must be called with structureLatch held and the leaf holding
+   * ref write locked.
+   *
+   * @return False if the list does not hold rid.
+   */
+	bool removeFromPosting(RecordId &ref, const RecordId &rid);
+  /**
+   * Take the pages of the posting list starting at head out of use: onto spare, for writePosting() to use again, or
+   * onto the free list if spare is NULL. Must be called with structureLatch held.
+   */
+	void releasePosting(const PageId head, std::vector<PageId> *spare);
+
+	template <class T> void insertNonLeaf(NonLeafNode<T> *nonLeaf, PageKeyPair<T> *currentChild, const int child,
+			const std::uint64_t childCount, const std::uint64_t newCount);
+
+	template <class T> void rootMods(PageId pageId, PageKeyPair<T> *newChild, int level);
+
+ public:
 
   /**
    * BTreeIndex Constructor. 
 	 * Check to see if the corresponding index file exists. If so, open the file.
 	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * An existing file written in an older format (IndexMetaInfo::formatVersion other than INDEX_FORMAT_VERSION)
+	 * is removed and rebuilt from the base relation.
+	 * By default a new index is bulk loaded: all entries are extracted, sorted and packed into pages bottom-up,
+	 * instead of descending from the root once per record.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
-   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @param buildMode					How a new index file is populated (ignored if the file already exists)
+   * @param fillFactor					Fraction of every page the bulk loader fills, in (0, 1]
+   * @param appendSplitRatio		Fraction of the entries kept on the left when insertEntry() appends past the last key
+   *													of a full node on the right edge of the tree, in [0.5, 1]. Other splits are even.
+   * @param includeColumns			Attributes copied into every leaf entry for index-only scans, in the order their
+   *													bytes are returned. Each one makes the leaves hold fewer entries.
+   * @param leafFormat					How a new index file stores its leaves; an existing file keeps the format it has.
+   *													PACKED_LEAVES needs INTEGER or STRING keys and no INCLUDE columns.
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type, INCLUDE columns etc.) do not match with values received through constructor parameters.
+   * @throws  BadIndexInfoException     If fillFactor is not in (0, 1] or appendSplitRatio is not in [0.5, 1].
+   * @throws  BadIndexInfoException     If there are more than MAX_INCLUDE_COLUMNS INCLUDE columns, or they take more
+   *																		than MAX_INCLUDE_SIZE bytes.
+   * @throws  BadIndexInfoException     If leafFormat is PACKED_LEAVES for an index that does not have INTEGER or
+   *																		STRING keys, or has INCLUDE columns.
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const BuildMode buildMode = BULK_LOAD, const double fillFactor = DEFAULT_FILL_FACTOR,
+						const double appendSplitRatio = DEFAULT_APPEND_SPLIT_RATIO,
+						const std::vector<IncludeColumn> &includeColumns = std::vector<IncludeColumn>(),
+						const LeafFormat leafFormat = PLAIN_LEAVES);
+
+  /**
+   * BTreeIndex Constructor for a key made of several attributes of the record. With more than one key column the
+   * index is COMPOSITE: every key is a CompositeKey holding the columns encoded so that keys compare byte by byte,
+   * and a scan of the leading columns is one range of the tree (see startPrefixScan()). A single key column makes the
+   * same index as the constructor above. The index file is named after the relation and the offset of every column.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param keyColumns					Attributes the key is made of, in the order keys compare on them
+   * @param buildMode					How a new index file is populated (ignored if the file already exists)
+   * @param fillFactor					Fraction of every page the bulk loader fills, in (0, 1]
+   * @param appendSplitRatio		As for the constructor above
+   * @param includeColumns			Attributes copied into every leaf entry for index-only scans
+   * @param leafFormat					How a new index file stores its leaves. PACKED_LEAVES needs a single INTEGER or STRING key column.
+   * @throws  BadIndexInfoException     As for the constructor above, and if the index file exists but was built
+   *																		over other key columns.
+   * @throws  BadIndexInfoException     If there are no key columns or more than MAX_KEY_COLUMNS, one of them is not
+   *																		INTEGER, DOUBLE or STRING, or together they encode to more than COMPOSITESIZE bytes.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const std::vector<KeyColumn> &keyColumns,
+						const BuildMode buildMode = BULK_LOAD, const double fillFactor = DEFAULT_FILL_FACTOR,
+						const double appendSplitRatio = DEFAULT_APPEND_SPLIT_RATIO,
+						const std::vector<IncludeColumn> &includeColumns = std::vector<IncludeColumn>(),
+						const LeafFormat leafFormat = PLAIN_LEAVES);
 	
 
   /**
@@ -333,10 +1897,177 @@ class BTreeIndex {
 	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
 	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
 	 * Make sure to unpin pages as soon as you can.
-   * @param key			Key to insert, pointer to integer/double/char string
+   * @param key			Key to insert, pointer to integer/double/char string/CompositeKey
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @param include	The record's INCLUDE columns, getIncludeSize() bytes as loadIncludes() copies them. Only
+   *								used, and then required, if the index has INCLUDE columns.
+   * @throws  BadIndexInfoException If the index has INCLUDE columns and include is NULL.
+	**/
+	void insertEntry(const void* key, const RecordId rid, const void* include = NULL);
+
+
+  /**
+	 * Check whether any entry has the given key. Safe to call while other threads insert.
+   * @param key			Key to look for, pointer to integer/double/char string/CompositeKey
+   * @return True if the index holds at least one entry with the key.
+	**/
+	bool containsKey(const void* key);
+
+
+  /**
+	 * Find every entry with the given key. Descends from the root once, uses no scan state, throws no exception
+	 * for a missing key and leaves nothing pinned, so it can run next to a scan and while other threads insert.
+   * @param key			Key to look for, pointer to integer/double/char string/CompositeKey
+   * @param outRids	Record IDs of the matching entries are appended to this, in index order
+   * @return Number of matching entries; 0 if there are none.
+	**/
+	size_t lookup(const void* key, std::vector<RecordId> &outRids);
+
+
+  /**
+	 * Find the smallest key in the index by descending the first child of every node, reading one page per level.
+	 * Safe to call while other threads insert, delete or look up keys.
+   * @param outKey	The key is copied here: an int, a double or a StringKey of STRINGSIZE characters
+   * @param outRid	If not NULL, the record ID of the first entry with that key is returned in this
+   * @return False if the index is empty, in which case nothing is written.
+	**/
+	bool minKey(void* outKey, RecordId* outRid = NULL);
+
+
+  /**
+	 * Find the largest key in the index by descending the last child of every node, as minKey() does.
+   * @param outKey	The key is copied here: an int, a double or a StringKey of STRINGSIZE characters
+   * @param outRid	If not NULL, the record ID of the last entry with that key is returned in this
+   * @return False if the index is empty, in which case nothing is written.
+	**/
+	bool maxKey(void* outKey, RecordId* outRid = NULL);
+
+
+  /**
+	 * Delete the entry <key, rid>. A leaf left less than a quarter full takes entries from a neighbour or is merged
+	 * into it, and the same goes on up the tree; pages that leave the tree are reused by later splits. Safe to call
+	 * while other threads insert, delete or look up keys.
+   * @param key			Key of the entry, pointer to integer/double/char string/CompositeKey
+   * @param rid			Record ID of the entry
+   * @return False if the index holds no such entry.
+	**/
+	bool deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Count the entries in a key range, with the same bounds as startScan(), without visiting its leaves: the entry
+	 * counts kept in non-leaf nodes give the number of entries left of each end of the range, found by descending
+	 * from the root once for each end, so the answer takes two page reads per level however many entries match.
+	 * Safe to call while other threads insert or delete; the count is then a snapshot that may miss writes still
+	 * in progress, and is exact once they are done.
+   * @param lowVal	Low value of range, pointer to integer / double / char string / CompositeKey
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string / CompositeKey
+   * @param highOp	High operator (LT/LTE)
+   * @return Number of entries within both bounds; 0 if there are none.
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	size_t countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Scan a large range with several threads. The range is cut into sub-ranges of about the same number of entries
+	 * at separators of the nodes just above the leaves, chosen from the entry counts of non-leaf nodes as countRange()
+	 * uses them, and each sub-range is scanned by its own thread with its own BTreeCursor, all reading leaves through
+	 * the index's BufMgr. A range spanning few leaves gets fewer threads, down to one. Like any scan, it must not
+	 * run while other threads insert.
+   * @param lowVal		Low value of range, pointer to integer / double / char string / CompositeKey
+   * @param lowOp			Low operator (GT/GTE)
+   * @param highVal		High value of range, pointer to integer / double / char string / CompositeKey
+   * @param highOp		High operator (LT/LTE)
+   * @param outRids		Record IDs of the matching entries are appended to this
+   * @param workers		Most threads to use; 0 for one per hardware thread
+   * @param ordered		If true the entries are appended in index order, once every thread is done. If false each
+   *									thread appends its entries a batch at a time as it reads them, so batches of different
+   *									sub-ranges are interleaved.
+   * @return Number of matching entries; 0 if there are none.
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	size_t parallelScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+			std::vector<RecordId> &outRids, const unsigned workers = 0, const bool ordered = true);
+
+
+  /**
+	 * Walk the whole tree and count its pages, entries and used key slots. Takes the latch splits hold, but inserts
+	 * that do not split may still change leaf counts while the walk is running.
+   * @return Height, page counts, entry count and leaf / non-leaf fill factors of the tree.
+	**/
+	IndexStatistics getStatistics();
+
+
+  /**
+	 * Insert a batch of entries. The batch is sorted and the tree walked once in key order: all of its keys that belong
+	 * in a leaf are merged into the leaf while it is pinned, and a node that overflows is split into as many nodes as
+	 * it needs at once, instead of one split per key. Safe to call while other threads insert or look up keys.
+   * @param keys		The n keys of the entries, one after the other: ints, doubles, strings of STRINGSIZE characters or CompositeKeys
+   * @param rids		Record IDs of the entries, in the same order as keys
+   * @param n				Number of entries
+   * @param includes	INCLUDE bytes of the entries, getIncludeSize() each, in the same order as keys. Only used, and
+   *									then required, if the index has INCLUDE columns.
+   * @throws  BadIndexInfoException If the index has INCLUDE columns and includes is NULL.
+	**/
+	void insertEntries(const void* keys, const RecordId* rids, size_t n, const void* includes = NULL);
+
+
+  /**
+	 * Number of bytes the INCLUDE columns take in an entry, which scanNextBatch() returns for each entry; 0 if the
+	 * index has none.
+	**/
+	int getIncludeSize() const { return includeSize; }
+
+
+  /**
+	 * Copy the INCLUDE columns of a record to out, one after the other in the order the constructor was given them:
+	 * the bytes insertEntry() takes for the record.
+   * @param record	The record, as stored in the relation
+   * @param out			Buffer for getIncludeSize() bytes
+	**/
+	void loadIncludes(const char *record, char *out) const;
+
+
+  /**
+	 * Copy the key of a record to out, as insertEntry() takes it: the attribute itself, or for a COMPOSITE index its
+	 * key columns encoded into a CompositeKey.
+   * @param record	The record, as stored in the relation
+   * @param out			Buffer for the key: an int, a double, STRINGSIZE characters or a CompositeKey
+	**/
+	void loadKey(const char *record, void *out) const;
+
+
+  /**
+	 * Build the CompositeKey of the given values of the leading key columns, to look up, insert or bound a scan
+	 * with. The columns that are not given are left at their lowest value, or at their highest if high is true, so
+	 * makeKey(v, n, lo, false) and makeKey(v, n, hi, true) bound every key that starts with the n values. For an
+	 * index that is not COMPOSITE the single value is copied as it is.
+   * @param values			Pointer to the int, double or char string of each of the first numColumns key columns
+   * @param numColumns	Number of values, from 1 to the number of key columns
+   * @param out				Buffer for the key, as loadKey() fills it
+   * @param high				Whether the missing columns sort after every value rather than before
+   * @throws  BadScanParamException If numColumns is not between 1 and the number of key columns.
+	**/
+	void makeKey(const void * const *values, const int numColumns, void *out, const bool high = false) const;
+
+
+  /**
+	 * Begin a scan of every entry whose leading key columns equal the given values, such as all entries with a
+	 * given first column whatever their second one. The entries are one range of the tree, so this is startScan()
+	 * between the lowest and the highest key with that prefix.
+   * @param values			Pointer to the int, double or char string of each of the first numColumns key columns
+   * @param numColumns	Number of values, from 1 to the number of key columns
+   * @param order				ASCENDING or DESCENDING key order
+   * @param limit				Most entries the scan returns, 0 for no limit
+   * @throws  BadScanParamException If numColumns is not between 1 and the number of key columns.
+	 * @throws  NoSuchKeyFoundException If no key starts with the values.
 	**/
-	void insertEntry(const void* key, const RecordId rid);
+	void startPrefixScan(const void * const *values, const int numColumns, const ScanOrder order = ASCENDING,
+			const size_t limit = 0);
 
 
   /**
@@ -346,15 +2077,43 @@ class BTreeIndex {
 	 * If another scan is already executing, that needs to be ended here.
 	 * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
 	 * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
-   * @param lowVal	Low value of range, pointer to integer / double / char string
+	 * A DESCENDING scan starts from the leaf holding the last entry that satisfies them instead and returns entries
+	 * in decreasing key order, so one that is ended early only reads the leaves at the top of the range.
+	 * A scan with a limit completes once it has returned that many entries, without moving on to the next leaf:
+	 * a LIMIT N query reads the leaves its N entries are in and no others.
+   * @param lowVal	Low value of range, pointer to integer / double / char string / CompositeKey
    * @param lowOp		Low operator (GT/GTE)
-   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highVal	High value of range, pointer to integer / double / char string / CompositeKey
    * @param highOp	High operator (LT/LTE)
+   * @param order		ASCENDING to return entries from the low bound up, DESCENDING from the high bound down
+   * @param limit		Most entries the scan returns, 0 for no limit
    * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
    * @throws  BadScanrangeException If lowVal > highval
 	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
 	**/
-	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+			const ScanOrder order = ASCENDING, const size_t limit = 0);
+
+
+  /**
+	 * Begin a scan of several key ranges, or of a list of keys for an IN-list query, in one left-to-right pass instead
+	 * of one startScan() per range. Ranges are taken in order of their low bound. The next range is looked for in the
+	 * current leaf first, and only one that starts past it descends again, from the deepest node on the path to the
+	 * current leaf that holds its start rather than from the root. scanNext() and scanNextBatch() then return the
+	 * entries of every range in increasing key order, each once even where ranges overlap.
+   * @param lowVals		Low value of each range, one after the other: ints, doubles, strings of STRINGSIZE characters or CompositeKeys
+   * @param lowOp			Low operator of every range (GT/GTE)
+   * @param highVals	High value of each range, in the same order as lowVals. Pass lowVals again, with GTE and LTE,
+   *									to scan a list of keys.
+   * @param highOp		High operator of every range (LT/LTE)
+   * @param numRanges	Number of ranges
+   * @param limit			Most entries the scan returns, 0 for no limit
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If the low value of a range is greater than its high value
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree within any of the ranges.
+	**/
+	void startMultiScan(const void* lowVals, const Operator lowOp, const void* highVals, const Operator highOp,
+			const size_t numRanges, const size_t limit = 0);
 
 
   /**
@@ -368,18 +2127,23 @@ class BTreeIndex {
 
 
   /**
-	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
+	 * Fetch up to maxEntries of the next index entries that match the scan, without throwing at the end of the
+	 * scan. See BTreeCursor::scanNextBatch().
+   * @param outRids			Buffer for at least maxEntries record ids
+   * @param outKeys			Buffer for at least maxEntries keys, or NULL if only record ids are wanted
+   * @param maxEntries	Number of entries to fetch at most
+   * @param outIncludes	Buffer for the INCLUDE bytes of at least maxEntries entries, getIncludeSize() each, or NULL
+   * @return Number of entries written. Less than maxEntries once the scan has completed.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
 	**/
-	void endScan();
-
-	void insertHelper(Page *currPage, PageId currPageNo, const RIDKeyPair<int> newPair, PageKeyPair<int> *&newChild, bool isLeaf);
+	size_t scanNextBatch(RecordId *outRids, void *outKeys, const size_t maxEntries, void *outIncludes = NULL);
 
-	void insertLeaf(LeafNodeInt *leaf, RIDKeyPair<int> newPair);
 
-	void insertNonLeaf(NonLeafNodeInt *nonLeaf, PageKeyPair<int> *currentChild);
-
-	void rootMods(PageId pageId, PageKeyPair<int> *newChild);
+  /**
+	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	void endScan();
 
 };
 
@@ -83,6 +83,20 @@ void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
   throw HashNotFoundException(file->filename(), pageNo);
 }
 
+bool BufHashTbl::contains(const File* file, const PageId pageNo) 
+{
+  int index = hash(file, pageNo);
+  hashBucket* tmpBuc = ht[index];
+  while (tmpBuc) {
+    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    {
+      return true;
+    }
+    tmpBuc = tmpBuc->next;
+  }
+  return false;
+}
+
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
   int index = hash(file, pageNo);
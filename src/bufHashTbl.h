@@ -96,6 +96,16 @@ class BufHashTbl
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool, like lookup() but
+   * without throwing when it is not.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+   * @return True if the page entry is in the hash table.
+	 */
+  bool contains(const File* file, const PageId pageNo);
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
@@ -7,6 +7,8 @@
 
 #include <memory>
 #include <iostream>
+#include <thread>
+#include <vector>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
@@ -16,6 +18,36 @@
 
 namespace badgerdb { 
 
+namespace {
+
+/**
+ * A pthread read-write lock held shared for as long as the guard is in scope.
+ */
+class SharedGuard
+{
+ public:
+  explicit SharedGuard(pthread_rwlock_t &lock) : lock(lock) { pthread_rwlock_rdlock(&lock); }
+  ~SharedGuard() { pthread_rwlock_unlock(&lock); }
+
+ private:
+  pthread_rwlock_t &lock;
+};
+
+/**
+ * A pthread read-write lock held exclusive for as long as the guard is in scope.
+ */
+class ExclusiveGuard
+{
+ public:
+  explicit ExclusiveGuard(pthread_rwlock_t &lock) : lock(lock) { pthread_rwlock_wrlock(&lock); }
+  ~ExclusiveGuard() { pthread_rwlock_unlock(&lock); }
+
+ private:
+  pthread_rwlock_t &lock;
+};
+
+}
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
@@ -36,6 +68,13 @@ BufMgr::BufMgr(std::uint32_t bufs)
   hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
 
   clockHand = bufs - 1;
+
+  // frames are only assigned on misses, which would wait behind a steady stream of hits if readers were preferred
+  pthread_rwlockattr_t attr;
+  pthread_rwlockattr_init(&attr);
+  pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+  pthread_rwlock_init(&bufLock, &attr);
+  pthread_rwlockattr_destroy(&attr);
 }
 
 
@@ -53,13 +92,14 @@ BufMgr::~BufMgr() {
 	delete hashTable;
   delete [] bufDescTable;
   delete [] bufPool;
+  pthread_rwlock_destroy(&bufLock);
 }
 
 void BufMgr::allocBuf(FrameId & frame) 
 {
   // perform first part of clock algorithm to search for 
   // open buffer frame
-  // Assumes non-concurrent access to buffer manager
+  // Callers hold bufLock exclusive, so no pin count changes under us
   std::uint32_t numScanned = 0;
   bool found = 0;
 
@@ -69,10 +109,15 @@ void BufMgr::allocBuf(FrameId & frame)
     advanceClock();
     numScanned++;
 
-    // if invalid, use frame
+    // if invalid, use frame, unless a thread that was waiting for a read into it that failed still pins it
     if (! bufDescTable[clockHand].valid)
     {
-      break;
+      if (bufDescTable[clockHand].pinCnt == 0)
+      {
+        found = true;
+        break;
+      }
+      continue;
     }
 
     // is valid, check referenced bit
@@ -107,6 +152,7 @@ void BufMgr::allocBuf(FrameId & frame)
   {
     bufStats.diskwrites++;
     //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
+    std::lock_guard<std::mutex> io(ioLock);
     bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
   }
 
@@ -120,56 +166,129 @@ void BufMgr::allocBuf(FrameId & frame)
 	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  while (true)
+  {
+    // check to see if it is already in the buffer pool, and pin it if so
+    bool hit = false;
+    {
+      SharedGuard guard(bufLock);
+      if (hashTable->contains(file, pageNo))
+      {
+        hashTable->lookup(file, pageNo, frameNo);
+        // set the referenced bit
+        bufDescTable[frameNo].refbit = true;
+        bufDescTable[frameNo].pinCnt++;
+        hit = true;
+      }
+    }
+
+    if (hit)
+    {
+      // the page may still be on its way in from disk
+      while (bufDescTable[frameNo].ioPending)
+      {
+        std::this_thread::yield();
+      }
+      if (bufDescTable[frameNo].valid)
+      {
+        page = &bufPool[frameNo];
+        return;
+      }
+      // the read failed, so drop the pin and try it again, which throws what the read threw
+      SharedGuard guard(bufLock);
+      bufDescTable[frameNo].pinCnt--;
+      continue;
+    }
+
+    //not in the buffer pool, must allocate a new page
+    {
+      ExclusiveGuard guard(bufLock);
+      if (hashTable->contains(file, pageNo))
+      {
+        // another thread read it in while the lock was let go
+        continue;
+      }
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
+      // alloc a new frame
+      allocBuf(frameNo);
+
+      // set up the entry properly, and insert it in the hash table before the page is there
+      bufStats.diskreads++;
+      bufDescTable[frameNo].Set(file, pageNo);
+      bufDescTable[frameNo].ioPending = true;
+      hashTable->insert(file, pageNo, frameNo);
+    }
+
+    // read the page into the new frame, leaving the frame table to other threads
+    try
+    {
+      std::lock_guard<std::mutex> io(ioLock);
+      bufPool[frameNo] = file->readPage(pageNo);
+    }
+    catch(...)
+    {
+      ExclusiveGuard guard(bufLock);
+      hashTable->remove(file, pageNo);
+      bufDescTable[frameNo].file = NULL;
+      bufDescTable[frameNo].pageNo = Page::INVALID_NUMBER;
+      bufDescTable[frameNo].valid = false;
+      bufDescTable[frameNo].pinCnt--;
+      bufDescTable[frameNo].ioPending = false;
+      throw;
+    }
+    bufDescTable[frameNo].ioPending = false;
     page = &bufPool[frameNo];
+    return;
   }
-  catch(const HashNotFoundException &e) //not in the buffer pool, must allocate a new page
-  {
-    // alloc a new frame
-    allocBuf(frameNo);
+}
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+int BufMgr::prefetchPages(File* file, const PageId* pageNos, const int count)
+{
+  std::vector<PageId> missing;
+  {
+    SharedGuard guard(bufLock);
+    for (int i = 0; i < count; i++)
+    {
+      if (!hashTable->contains(file, pageNos[i]))
+      {
+        missing.push_back(pageNos[i]);
+      }
+    }
+  }
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+  // the file is only given a hint, which does not touch its stream, so the lock is not needed for it
+  if (!missing.empty())
+  {
+    file->prefetchPages(&missing[0], (int) missing.size());
   }
+  return (int) missing.size();
 }
 
-
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
+  SharedGuard guard(bufLock);
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
 
   if (dirty == true) bufDescTable[frameNo].dirty = dirty;
 
-  // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+  // make sure the page is actually pinned; other threads may be pinning and unpinning it too
+  int pins = bufDescTable[frameNo].pinCnt;
+  do
   {
-  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
-  }
-  else bufDescTable[frameNo].pinCnt--;
+    if (pins == 0)
+    {
+      throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+    }
+  } while (!bufDescTable[frameNo].pinCnt.compare_exchange_weak(pins, pins - 1));
 }
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  ExclusiveGuard guard(bufLock);
   FrameId frameNo;
 
   // alloc a new frame
@@ -177,7 +296,10 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  {
+    std::lock_guard<std::mutex> io(ioLock);
+    bufPool[frameNo] = file->allocatePage(pageNo);
+  }
   page = &bufPool[frameNo];
 
   // set up the entry properly
@@ -189,6 +311,7 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 
 void BufMgr::flushFile(const File* file) 
 {
+  ExclusiveGuard guard(bufLock);
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
@@ -200,6 +323,7 @@ void BufMgr::flushFile(const File* file)
 	    if (tmpbuf->dirty == true)
 			{
 				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
+				std::lock_guard<std::mutex> io(ioLock);
 				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
 				tmpbuf->dirty = false;
     	}
@@ -214,6 +338,7 @@ void BufMgr::flushFile(const File* file)
 
 void BufMgr::disposePage(File* file, const PageId pageNo)
 {
+  ExclusiveGuard guard(bufLock);
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
@@ -225,11 +350,13 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 	hashTable->remove(file, pageNo);
 
   // deallocate it in the file	
+  std::lock_guard<std::mutex> io(ioLock);
   file->deletePage(pageNo);
 }
 
 void BufMgr::printSelf(void) 
 {
+  SharedGuard guard(bufLock);
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
@@ -10,6 +10,9 @@
 #include "file.h"
 #include "bufHashTbl.h"
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <pthread.h>
 
 namespace badgerdb {
 
@@ -42,14 +45,15 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * Number of times this page has been pinned. Pins are taken and dropped with bufLock held shared, so several
+   * threads may change it at once
 	 */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
 	/**
    * True if page is dirty;  false otherwise
 	 */
-  bool dirty;
+  std::atomic<bool> dirty;
 
 	/**
    * True if page is valid
@@ -59,7 +63,13 @@ class BufDesc {
 	/**
    * Has this buffer frame been reference recently
 	 */
-  bool refbit;
+  std::atomic<bool> refbit;
+
+	/**
+   * True while the page is being read into the frame. The frame is already in the hash table, so other threads can
+   * pin it, but they wait for this to clear before they use the page
+	 */
+  std::atomic<bool> ioPending;
 
 	/**
    * Initialize buffer frame for a new user
@@ -72,6 +82,7 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+    ioPending = false;
   };
 
 	/**
@@ -89,6 +100,7 @@ class BufDesc {
     dirty = false;
     valid = true;
     refbit = true;
+    ioPending = false;
   }
 
   void Print()
@@ -156,7 +168,10 @@ struct BufStats
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file.
+* The public methods may be called from several threads at once; synchronizing access to the contents of a page is up to the caller.
+* Pinning and unpinning a page that is already in the pool only take bufLock shared, and reading a page from its file
+* holds no lock on the frame table at all.
 */
 class BufMgr 
 {
@@ -186,6 +201,19 @@ class BufMgr
 	 */
   BufStats bufStats;
 
+	/**
+   * Guards the frame table. Held shared to look a page up and pin or unpin it, which only changes the frame's
+   * atomic pin count, dirty and reference bits; held exclusive to assign frames to pages or take them away. A pinned
+   * frame is never reassigned, so the contents of a pinned page can be used without holding it.
+	 */
+  pthread_rwlock_t bufLock;
+
+	/**
+   * Serializes the calls made on files, since a File reads and writes through one stream. Taken after bufLock when
+   * both are held; a page is read into its frame holding only this.
+	 */
+  std::mutex ioLock;
+
 	/**
    * Advance clock to next frame in the buffer pool
 	 */
@@ -229,6 +257,18 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Ask for pages of the file to be read from disk in the background, ahead of the readPage() calls for them.
+	 * Pages already in the buffer pool are left out. Nothing is pinned and no frame is allocated: the pages are read
+	 * into the operating system's cache, so a later readPage() of them does not wait for the disk.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers in the file
+	 * @param count		Number of pages
+	 * @return Number of the pages that were not in the buffer pool.
+	 */
+  int prefetchPages(File* file, const PageId* pageNos, const int count);
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
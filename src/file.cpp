@@ -13,6 +13,8 @@
 #include <string>
 #include <cstdio>
 #include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
@@ -64,6 +66,26 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
+void File::prefetchPages(const PageId* page_numbers, const int count) const {
+  // The advice is taken by the file, not the descriptor, so a descriptor of
+  // its own keeps the shared stream out of it.
+  int fd = ::open(filename_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  for (int i = 0; i < count; ++i) {
+    // neighbouring pages go out as one request
+    int run = 1;
+    while (i + run < count && page_numbers[i + run] == page_numbers[i] + run) {
+      ++run;
+    }
+    posix_fadvise(fd, pagePosition(page_numbers[i]), (off_t) run * Page::SIZE,
+                  POSIX_FADV_WILLNEED);
+    i += run - 1;
+  }
+  ::close(fd);
+}
+
 File::File(const std::string& name, const bool create_new) : filename_(name) {
   openIfNeeded(create_new);
 
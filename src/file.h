@@ -164,6 +164,16 @@ class File {
    */
 	PageId getFirstPageNo();
 
+  /**
+   * Tells the operating system that the given pages will be read soon, so it can
+   * start reading them from disk in the background. Only a hint: nothing is read
+   * here, and page numbers are not checked.
+   *
+   * @param page_numbers  Numbers of the pages.
+   * @param count         Number of pages.
+   */
+  void prefetchPages(const PageId* page_numbers, const int count) const;
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -0,0 +1,126 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Order-preserving encodings of keys. Every key type maps to unsigned integers, or to big-endian bytes, that
+ * compare the way the keys do, so that the node search compares integers only: no comparison has to know the type
+ * of the key, branch on the sign of a double or call strncmp.
+ */
+
+/**
+ * An int as an unsigned integer with the same order: the sign bit flipped.
+ */
+inline std::uint32_t normalizeInt(const int value)
+{
+	return (std::uint32_t) value ^ 0x80000000u;
+}
+
+/**
+ * A double as an unsigned integer with the same order: the sign bit of a positive double flipped, every bit of a
+ * negative one, so that the negative ones sort below and in reverse of their magnitude. -0.0 maps as 0.0, which it
+ * equals. NaN has no place in the order.
+ */
+inline std::uint64_t normalizeDouble(const double value)
+{
+	const double d = value == 0.0 ? 0.0 : value;
+	std::uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return (bits >> 63) ? ~bits : bits ^ ((std::uint64_t) 1 << 63);
+}
+
+/**
+ * normalizeDouble() as a signed integer, which the vector compares of x86 take: the bits of a positive double as
+ * they are, those of a negative one with all but the sign flipped. Takes the bits, so that a search can load a double
+ * straight into an integer register.
+ */
+inline std::int64_t normalizeDoubleBits(const std::int64_t bits)
+{
+	return bits ^ ((std::int64_t) ((std::uint64_t) (bits >> 63) >> 1));
+}
+
+/**
+ * The eight bytes at bytes as a big-endian integer, which compares as memcmp compares the bytes.
+ */
+inline std::uint64_t loadBigEndian(const unsigned char *bytes)
+{
+	std::uint64_t word;
+	memcpy(&word, bytes, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
+	return word;
+}
+
+/**
+ * Write the low size bytes of value to out, most significant first.
+ */
+inline void storeBigEndian(std::uint64_t value, const int size, unsigned char *out)
+{
+	for (int i = size - 1; i >= 0; i--)
+	{
+		out[i] = (unsigned char) value;
+		value >>= 8;
+	}
+}
+
+/**
+ * Compare SIZE bytes as memcmp does, eight at a time as big-endian integers. A tail shorter than eight bytes is
+ * compared as the last eight bytes, which overlap bytes already found equal.
+ */
+template <int SIZE>
+inline int compareBytes(const void *a, const void *b)
+{
+	static_assert(SIZE >= 8, "keys are compared a word at a time");
+	const unsigned char *x = (const unsigned char *) a;
+	const unsigned char *y = (const unsigned char *) b;
+	for (int i = 0; i + 8 <= SIZE; i += 8)
+	{
+		std::uint64_t p = loadBigEndian(x + i);
+		std::uint64_t q = loadBigEndian(y + i);
+		if (p != q)
+			return p < q ? -1 : 1;
+	}
+	if (SIZE % 8 != 0)
+	{
+		std::uint64_t p = loadBigEndian(x + SIZE - 8);
+		std::uint64_t q = loadBigEndian(y + SIZE - 8);
+		if (p != q)
+			return p < q ? -1 : 1;
+	}
+	return 0;
+}
+
+/**
+ * Byte-comparable encodings of the three attribute types, as a CompositeKey holds its columns: 4 bytes for an int,
+ * 8 for a double and size for a string, which is its first size characters padded with zeros.
+ */
+inline void encodeInt(const int value, unsigned char *out)
+{
+	storeBigEndian(normalizeInt(value), sizeof(value), out);
+}
+
+inline void encodeDouble(const double value, unsigned char *out)
+{
+	storeBigEndian(normalizeDouble(value), sizeof(value), out);
+}
+
+inline void encodeString(const char *value, const int size, unsigned char *out)
+{
+	size_t length = strnlen(value, size);
+	memcpy(out, value, length);
+	memset(out + length, 0, size - length);
+}
+
+}
@@ -6,10 +6,15 @@
  */
 
 #include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <set>
 #include <stdio.h>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
+#include "recordfetch.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
 #include "exceptions/insufficient_space_exception.h"
@@ -20,6 +25,9 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -66,13 +74,54 @@ BufMgr * bufMgr = new BufMgr(100);
 
 void createRelationForward();
 void createRelationBackward();
-void createRelationRandom();
-void intTests();
+void createRelationRandom(const int distinct = relationSize);
+void intTests(const BuildMode buildMode = BULK_LOAD, const double fillFactor = DEFAULT_FILL_FACTOR);
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void doubleTests(const BuildMode buildMode = BULK_LOAD);
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
+void stringTests(const BuildMode buildMode = BULK_LOAD);
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int cursorCount(BTreeCursor &cursor, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int batchScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int descendingScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int multiScan(BTreeIndex *index, const int *lowVals, Operator lowOp, const int *highVals, Operator highOp, int numRanges,
+		bool batched, size_t limit = 0);
+int parallelScanCheck(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, unsigned workers);
+int fetchCheck(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t maxRids);
+int coveringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, ScanOrder order);
+int prefixScan(BTreeIndex *index, const void * const *values, int numColumns, ScanOrder order,
+		std::vector<RecordId> *outRids = NULL);
 void indexTests();
 void test1();
 void test2();
 void test3();
+void test4();
+void test5();
+void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+void test30();
 void errorTests();
 void deleteRelation();
 
@@ -138,6 +187,33 @@ int main(int argc, char **argv)
 	test1();
 	test2();
 	test3();
+	test4();
+	test5();
+	test6();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
+	test23();
+	test24();
+	test25();
+	test26();
+	test27();
+	test28();
+	test29();
+	test30();
 	errorTests();
 
 	delete bufMgr;
@@ -173,8 +249,1995 @@ void test3()
 	// on attributes of all three types (int, double, string)
 	std::cout << "--------------------" << std::endl;
 	std::cout << "createRelationRandom" << std::endl;
+	createRelationForward();
+	indexTests();
+	deleteRelation();
+}
+
+void test4()
+{
+	// Create a relation with tuples valued 0 to relationSize in random order and bulk load
+	// an integer index over it that leaves half of every page free
+	std::cout << "--------------------" << std::endl;
+	std::cout << "bulkLoadHalfFull" << std::endl;
+	createRelationRandom();
+	intTests(BULK_LOAD, 0.5);
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+	deleteRelation();
+}
+
+void test5()
+{
+	// Create a relation with tuples valued 0 to relationSize in random order and build
+	// the integer index by inserting one entry at a time
+	std::cout << "--------------------" << std::endl;
+	std::cout << "insertBuildRandom" << std::endl;
+	createRelationRandom();
+	intTests(INSERT_BUILD);
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+	deleteRelation();
+}
+
+void test6()
+{
+	// Create an index, then reopen it from its file; then mark the file as written in the
+	// format used before node headers and check that opening it rebuilds the index
+	std::cout << "--------------------" << std::endl;
+	std::cout << "reopenAndRebuildIndex" << std::endl;
+	createRelationForward();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	}
+	intTests();
+	{
+		BlobFile indexFile = BlobFile::open(intIndexName);
+		Page meta = indexFile.readPage(indexFile.getFirstPageNo());
+		reinterpret_cast<IndexMetaInfo*>(&meta)->formatVersion = 0;
+		indexFile.writePage(indexFile.getFirstPageNo(), meta);
+	}
+	intTests();
+	indexTests();
+	deleteRelation();
+}
+
+void test7()
+{
+	// Insert a second copy of every key, shifted up by relationSize, from several threads at once while
+	// other threads look up the original keys; then check every key is found and the usual scans still pass
+	std::cout << "--------------------" << std::endl;
+	std::cout << "concurrentInsertAndLookup" << std::endl;
+	createRelationRandom();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD);
+
+		std::vector<int> keys;
+		std::vector<RecordId> rids;
+		{
+			FileScan fscan(relationName, bufMgr);
+			try
+			{
+				RecordId scanRid;
+				while(1)
+				{
+					fscan.scanNext(scanRid);
+					std::string recordStr = fscan.getRecord();
+					keys.push_back(reinterpret_cast<const RECORD*>(recordStr.c_str())->i + relationSize);
+					rids.push_back(scanRid);
+				}
+			}
+			catch(const EndOfFileException &e)
+			{
+			}
+		}
+
+		const int writers = 4;
+		const int readers = 2;
+		std::atomic<int> found(0);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < writers + readers; t++)
+		{
+			threads.push_back(std::thread([&, t]() {
+				if (t < writers)
+				{
+					for (size_t j = t; j < keys.size(); j += writers)
+						index.insertEntry(&keys[j], rids[j]);
+				}
+				else
+				{
+					for (int key = 0; key < relationSize; key++)
+						if (index.containsKey(&key))
+							found++;
+				}
+			}));
+		}
+		for (size_t t = 0; t < threads.size(); t++)
+			threads[t].join();
+		checkPassFail(found, readers * relationSize)
+
+		int inserted = 0;
+		for (int key = relationSize; key < 2 * relationSize; key++)
+			if (index.containsKey(&key))
+				inserted++;
+		checkPassFail(inserted, relationSize)
+		int absent = 2 * relationSize;
+		checkPassFail(index.containsKey(&absent), false)
+	}
+	intTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+	deleteRelation();
+}
+
+/**
+ * Runs the scan on the cursor to completion and returns the number of entries it produced.
+ */
+int cursorCount(BTreeCursor &cursor, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	RecordId scanRid;
+	int numResults = 0;
+	try
+	{
+		cursor.startScan(&lowVal, lowOp, &highVal, highOp);
+		while(1)
+		{
+			cursor.scanNext(scanRid);
+			numResults++;
+		}
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	cursor.endScan();
+	return numResults;
+}
+
+void test8()
+{
+	// Run a nested loop of two cursors and the index's own scan over one index, then let several
+	// threads scan the whole index at once, each with its own cursor
+	std::cout << "--------------------" << std::endl;
+	std::cout << "independentCursors" << std::endl;
+	createRelationForward();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		BTreeCursor outer(&index);
+		BTreeCursor inner(&index);
+
+		int low = 0, high = 50;
+		int outerCount = 0, innerCount = 0;
+		RecordId outerRid;
+		outer.startScan(&low, GTE, &high, LT);
+		try
+		{
+			while(1)
+			{
+				outer.scanNext(outerRid);
+				outerCount++;
+				innerCount += cursorCount(inner, 1000, GTE, 1100, LT);
+				if (outerCount == 25)
+					checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+		}
+		outer.endScan();
+		checkPassFail(outerCount, 50)
+		checkPassFail(innerCount, 50 * 100)
+
+		const int readers = 4;
+		std::atomic<int> total(0);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < readers; t++)
+		{
+			threads.push_back(std::thread([&]() {
+				BTreeCursor cursor(&index);
+				total += cursorCount(cursor, 0, GTE, relationSize, LT);
+			}));
+		}
+		for (size_t t = 0; t < threads.size(); t++)
+			threads[t].join();
+		checkPassFail(total, readers * relationSize)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+	deleteRelation();
+}
+
+/**
+ * Runs the scan with scanNextBatch in small batches that straddle leaves and returns the number of entries,
+ * or -1 if the keys come back out of order or outside the range.
+ */
+int batchScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	const size_t batchSize = 7;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+	int numResults = 0;
+	int lastKey = lowVal;
+	try
+	{
+		index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+
+	bool ordered = true;
+	size_t count;
+	do
+	{
+		count = index->scanNextBatch(rids, keys, batchSize);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (keys[i] < lastKey || (lowOp == GT && keys[i] == lowVal) || keys[i] > highVal || (highOp == LT && keys[i] == highVal))
+				ordered = false;
+			lastKey = keys[i];
+		}
+		numResults += count;
+	} while (count == batchSize);
+
+	// once a batch comes back short, the scan stays completed
+	if (index->scanNextBatch(rids, NULL, batchSize) != 0)
+		ordered = false;
+	index->endScan();
+	return ordered ? numResults : -1;
+}
+
+/**
+ * Runs the scan in DESCENDING order with scanNextBatch in small batches and returns the number of entries,
+ * or -1 if the keys come back out of order or outside the range.
+ */
+int descendingScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	const size_t batchSize = 7;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+	int numResults = 0;
+	int lastKey = highVal;
+	try
+	{
+		index->startScan(&lowVal, lowOp, &highVal, highOp, DESCENDING);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+
+	bool ordered = true;
+	size_t count;
+	do
+	{
+		count = index->scanNextBatch(rids, keys, batchSize);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (keys[i] > lastKey || (highOp == LT && keys[i] == highVal) || keys[i] < lowVal || (lowOp == GT && keys[i] == lowVal))
+				ordered = false;
+			lastKey = keys[i];
+		}
+		numResults += count;
+	} while (count == batchSize);
+
+	if (index->scanNextBatch(rids, NULL, batchSize) != 0)
+		ordered = false;
+	index->endScan();
+	return ordered ? numResults : -1;
+}
+
+/**
+ * Runs a multi-range scan with scanNext, or with scanNextBatch in small batches, and returns the number of entries,
+ * or -1 if a key comes back twice, out of order or outside every range.
+ */
+int multiScan(BTreeIndex *index, const int *lowVals, Operator lowOp, const int *highVals, Operator highOp, int numRanges,
+		bool batched, size_t limit)
+{
+	const size_t batchSize = 7;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+	int numResults = 0;
+	int lastKey = -1;
+	bool first = true;
+	try
+	{
+		index->startMultiScan(lowVals, lowOp, highVals, highOp, numRanges, limit);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+
+	// scanNext only returns record ids, so its keys are read back from the records
+	bool ordered = true;
+	size_t count;
+	do
+	{
+		if (batched)
+			count = index->scanNextBatch(rids, keys, batchSize);
+		else
+		{
+			count = 0;
+			try
+			{
+				index->scanNext(rids[0]);
+				Page *curPage;
+				bufMgr->readPage(file1, rids[0].page_number, curPage);
+				keys[0] = reinterpret_cast<const RECORD*>(curPage->getRecord(rids[0]).data())->i;
+				bufMgr->unPinPage(file1, rids[0].page_number, false);
+				count = 1;
+			}
+			catch(const IndexScanCompletedException &e)
+			{
+			}
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			bool inRange = false;
+			for (int r = 0; r < numRanges; r++)
+				if ((keys[i] > lowVals[r] || (lowOp == GTE && keys[i] == lowVals[r]))
+						&& (keys[i] < highVals[r] || (highOp == LTE && keys[i] == highVals[r])))
+					inRange = true;
+			if ((!first && keys[i] <= lastKey) || !inRange)
+				ordered = false;
+			lastKey = keys[i];
+			first = false;
+		}
+		numResults += count;
+	} while (count == (batched ? batchSize : 1));
+
+	index->endScan();
+	return ordered ? numResults : -1;
+}
+
+/**
+ * Runs parallelScan in key order and unordered and returns the number of entries, or -1 if the ordered result is not
+ * exactly what a single scan returns or the unordered one does not hold the same record ids.
+ */
+int parallelScanCheck(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, unsigned workers)
+{
+	const size_t batchSize = 7;
+	std::vector<RecordId> expected;
+	try
+	{
+		index->startScan(&lowVal, lowOp, &highVal, highOp);
+		size_t count;
+		do
+		{
+			expected.resize(expected.size() + batchSize);
+			count = index->scanNextBatch(&expected[expected.size() - batchSize], NULL, batchSize);
+			expected.resize(expected.size() - batchSize + count);
+		} while (count == batchSize);
+		index->endScan();
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+	}
+
+	std::vector<RecordId> ordered;
+	std::vector<RecordId> unordered;
+	size_t found = index->parallelScan(&lowVal, lowOp, &highVal, highOp, ordered, workers);
+	index->parallelScan(&lowVal, lowOp, &highVal, highOp, unordered, workers, false);
+	if (found != expected.size() || ordered.size() != expected.size() || unordered.size() != expected.size())
+		return -1;
+
+	std::vector<std::pair<PageId, SlotId> > expectedSet;
+	std::vector<std::pair<PageId, SlotId> > unorderedSet;
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		if (ordered[i].page_number != expected[i].page_number || ordered[i].slot_number != expected[i].slot_number)
+			return -1;
+		expectedSet.push_back(std::make_pair(expected[i].page_number, expected[i].slot_number));
+		unorderedSet.push_back(std::make_pair(unordered[i].page_number, unordered[i].slot_number));
+	}
+	std::sort(expectedSet.begin(), expectedSet.end());
+	std::sort(unorderedSet.begin(), unorderedSet.end());
+	return expectedSet == unorderedSet ? (int) found : -1;
+}
+
+/**
+ * Reads the records of a range scan back through a RecordFetch, keeping at most maxRids record ids, and returns the
+ * number of records whose key is in the range, or -1 if they do not come back in page order, a record is missing or
+ * fetch() does not return them in the order of the scan.
+ */
+int fetchCheck(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t maxRids)
+{
+	const size_t batchSize = 7;
+	std::vector<RecordId> rids;
+	std::vector<int> keys;
+	try
+	{
+		index->startScan(&lowVal, lowOp, &highVal, highOp);
+		size_t count;
+		do
+		{
+			rids.resize(rids.size() + batchSize);
+			keys.resize(keys.size() + batchSize);
+			count = index->scanNextBatch(&rids[rids.size() - batchSize], &keys[keys.size() - batchSize], batchSize);
+			rids.resize(rids.size() - batchSize + count);
+			keys.resize(keys.size() - batchSize + count);
+		} while (count == batchSize);
+		index->endScan();
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+	}
+
+	// a lossy fetch returns every record on the pages, so the range has to be checked again
+	int numResults = 0;
+	bool lossy;
+	{
+		RecordFetch fetch(relationName, bufMgr, maxRids);
+		for (size_t i = 0; i < rids.size(); i++)
+			fetch.add(rids[i]);
+		lossy = fetch.lossy();
+		if (lossy != (rids.size() > maxRids))
+			return -1;
+
+		PageId lastPage = 0;
+		try
+		{
+			RecordId fetchRid;
+			while (1)
+			{
+				fetch.scanNext(fetchRid);
+				if (fetchRid.page_number < lastPage)
+					return -1;
+				lastPage = fetchRid.page_number;
+				int key = reinterpret_cast<const RECORD*>(fetch.getRecord().data())->i;
+				if ((key > lowVal || (lowOp == GTE && key == lowVal)) && (key < highVal || (highOp == LTE && key == highVal)))
+					numResults++;
+				else if (!lossy)
+					return -1;
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+	}
+	if (numResults != (int) rids.size())
+		return -1;
+
+	RecordFetch fetch(relationName, bufMgr);
+	std::vector<std::string> records;
+	if (!rids.empty())
+		fetch.fetch(&rids[0], rids.size(), records);
+	if (records.size() != rids.size())
+		return -1;
+	for (size_t i = 0; i < records.size(); i++)
+		if (reinterpret_cast<const RECORD*>(records[i].data())->i != keys[i])
+			return -1;
+	return numResults;
+}
+
+/**
+ * Runs an index-only scan of an index that INCLUDEs RECORD.d and the first 8 characters of RECORD.s, and returns the
+ * number of entries, or -1 if the INCLUDE bytes of an entry are not those of the record with its key.
+ */
+int coveringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, ScanOrder order)
+{
+	const size_t batchSize = 7;
+	const int includeSize = sizeof(double) + 8;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+	char includes[batchSize * includeSize];
+	int numResults = 0;
+	try
+	{
+		index->startScan(&lowVal, lowOp, &highVal, highOp, order);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+
+	bool matches = true;
+	size_t count;
+	do
+	{
+		count = index->scanNextBatch(rids, keys, batchSize, includes);
+		for (size_t i = 0; i < count; i++)
+		{
+			double d;
+			memcpy(&d, &includes[i * includeSize], sizeof(d));
+			char s[64];
+			sprintf(s, "%05d string record", keys[i]);
+			if (d != keys[i] || memcmp(&includes[i * includeSize + sizeof(d)], s, 8) != 0)
+				matches = false;
+		}
+		numResults += count;
+	} while (count == batchSize);
+
+	index->endScan();
+	return matches ? numResults : -1;
+}
+
+/**
+ * Runs a prefix scan of a COMPOSITE index with scanNextBatch in small batches and returns the number of entries,
+ * or -1 if the keys come back out of order or do not start with the values. The record ids are appended to outRids.
+ */
+int prefixScan(BTreeIndex *index, const void * const *values, int numColumns, ScanOrder order,
+		std::vector<RecordId> *outRids)
+{
+	const size_t batchSize = 7;
+	RecordId rids[batchSize];
+	CompositeKey keys[batchSize];
+	CompositeKey low, high;
+	index->makeKey(values, numColumns, &low, false);
+	index->makeKey(values, numColumns, &high, true);
+	CompositeKey lastKey = order == ASCENDING ? low : high;
+	int numResults = 0;
+	try
+	{
+		index->startPrefixScan(values, numColumns, order);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+
+	bool ordered = true;
+	size_t count;
+	do
+	{
+		count = index->scanNextBatch(rids, keys, batchSize);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (keys[i] < low || keys[i] > high || (order == ASCENDING ? keys[i] < lastKey : keys[i] > lastKey))
+				ordered = false;
+			lastKey = keys[i];
+			if (outRids != NULL)
+				outRids->push_back(rids[i]);
+		}
+		numResults += count;
+	} while (count == batchSize);
+
+	index->endScan();
+	return ordered ? numResults : -1;
+}
+
+void test9()
+{
+	// Run the usual integer scans through scanNextBatch on indexes built both ways
+	std::cout << "--------------------" << std::endl;
+	std::cout << "batchScan" << std::endl;
+	createRelationRandom();
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, (BuildMode) mode);
+			checkPassFail(batchScan(&index,25,GT,40,LT), 14)
+			checkPassFail(batchScan(&index,20,GTE,35,LTE), 16)
+			checkPassFail(batchScan(&index,-3,GT,3,LT), 3)
+			checkPassFail(batchScan(&index,996,GT,1001,LT), 4)
+			checkPassFail(batchScan(&index,0,GT,1,LT), 0)
+			checkPassFail(batchScan(&index,300,GT,400,LT), 99)
+			checkPassFail(batchScan(&index,3000,GTE,4000,LT), 1000)
+			checkPassFail(batchScan(&index,0,GTE,relationSize,LT), relationSize)
+		}
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test10()
+{
+	// Create a relation with tuples valued 0 to relationSize in random order and build the
+	// double and string indexes by inserting one entry at a time
+	std::cout << "--------------------" << std::endl;
+	std::cout << "insertBuildDoubleString" << std::endl;
+	createRelationRandom();
+	doubleTests(INSERT_BUILD);
+	stringTests(INSERT_BUILD);
+	try
+	{
+		File::remove(doubleIndexName);
+		File::remove(stringIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+	deleteRelation();
+}
+
+void test11()
+{
+	// Insert tuples valued 0 to relationSize in increasing order: appends to the last leaf split 90/10
+	// by default and leave nearly full pages, while even splits leave them about half full
+	std::cout << "--------------------" << std::endl;
+	std::cout << "appendSplit" << std::endl;
+	createRelationForward();
+	const double ratios[] = { DEFAULT_APPEND_SPLIT_RATIO, 0.5 };
+	for (int r = 0; r < 2; r++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD,
+					DEFAULT_FILL_FACTOR, ratios[r]);
+			IndexStatistics stats = index.getStatistics();
+			std::cout << "split ratio " << ratios[r] << ": " << stats.leafPages << " leaves, fill factor "
+					<< stats.leafFillFactor << std::endl;
+			checkPassFail(stats.entries, (size_t) relationSize)
+			bool nearlyFull = stats.leafFillFactor > 0.75;
+			bool appendSplit = ratios[r] > 0.5;
+			checkPassFail(nearlyFull, appendSplit)
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		}
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test12()
+{
+	// Insert a second entry for every key, in runs of consecutive keys with the runs in decreasing order, so most
+	// inserts go through the leaf of the previous one and each run starts in a leaf the finger does not cover
+	std::cout << "--------------------" << std::endl;
+	std::cout << "clusteredInserts" << std::endl;
+	createRelationForward();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD);
+		const int runLength = 50;
+		for (int run = relationSize - runLength; run >= 0; run -= runLength)
+		{
+			for (int key = run; key < run + runLength; key++)
+			{
+				RecordId keyRid;
+				keyRid.page_number = 1;
+				keyRid.slot_number = key % 100 + 1;
+				index.insertEntry(&key, keyRid);
+			}
+		}
+		checkPassFail(index.getStatistics().entries, (size_t) 2 * relationSize)
+		checkPassFail(batchScan(&index,25,GT,40,LT), 28)
+		checkPassFail(batchScan(&index,20,GTE,35,LTE), 32)
+		checkPassFail(batchScan(&index,996,GT,1001,LT), 8)
+		checkPassFail(batchScan(&index,0,GTE,relationSize,LT), 2 * relationSize)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void test13()
+{
+	// Bulk load an index with full leaves, then insertEntries() a second entry for every key in random order and
+	// relationSize new keys after them in one batch, so every leaf and the root split into several nodes at once
+	std::cout << "--------------------" << std::endl;
+	std::cout << "insertEntries" << std::endl;
+	createRelationRandom();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD);
+		std::vector<int> keys;
+		std::vector<RecordId> rids;
+		for (int key = 0; key < 2 * relationSize; key++)
+		{
+			RecordId keyRid;
+			keyRid.page_number = 1;
+			keyRid.slot_number = key % 100 + 1;
+			keys.push_back(key % relationSize + (key < relationSize ? 0 : relationSize));
+			rids.push_back(keyRid);
+		}
+		srand(1);
+		std::random_shuffle(keys.begin(), keys.begin() + relationSize);
+		index.insertEntries(&keys[0], &rids[0], keys.size());
+		index.insertEntries(&keys[0], &rids[0], 0);
+
+		int newKey = relationSize + relationSize / 2;
+		checkPassFail(index.getStatistics().entries, (size_t) 3 * relationSize)
+		checkPassFail(index.containsKey(&newKey), true)
+		checkPassFail(batchScan(&index,25,GT,40,LT), 28)
+		checkPassFail(batchScan(&index,996,GT,1001,LT), 8)
+		checkPassFail(batchScan(&index,0,GTE,relationSize,LT), 2 * relationSize)
+		checkPassFail(batchScan(&index,relationSize,GTE,2 * relationSize,LT), relationSize)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void test14()
+{
+	// Point lookups: a hit must return the record of the key, a miss nothing, and a key with enough duplicates
+	// to fill several leaves every one of them
+	std::cout << "--------------------" << std::endl;
+	std::cout << "lookup" << std::endl;
+	createRelationRandom();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD);
+		std::vector<RecordId> rids;
+		int key = 25;
+		checkPassFail(index.lookup(&key, rids), (size_t) 1)
+		Page *curPage;
+		bufMgr->readPage(file1, rids[0].page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[0]).data()));
+		bufMgr->unPinPage(file1, rids[0].page_number, false);
+		checkPassFail(myRec.i, key)
+
+		key = relationSize;
+		checkPassFail(index.lookup(&key, rids), (size_t) 0)
+		checkPassFail(rids.size(), (size_t) 1)
+
+		// a lookup must not disturb a scan running on the same index
+		int low = 0;
+		RecordId scanRid;
+		index.startScan(&low, GTE, &key, LT);
+		key = 30;
+		checkPassFail(index.lookup(&key, rids), (size_t) 1)
+		checkPassFail(rids.size(), (size_t) 2)
+		index.scanNext(scanRid);
+		bufMgr->readPage(file1, scanRid.page_number, curPage);
+		myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+		bufMgr->unPinPage(file1, scanRid.page_number, false);
+		checkPassFail(myRec.i, low)
+		index.endScan();
+
+		const int duplicates = 2000;
+		std::vector<int> keys(duplicates, key);
+		std::vector<RecordId> dupRids(duplicates, rids[0]);
+		index.insertEntries(&keys[0], &dupRids[0], duplicates);
+		rids.clear();
+		checkPassFail(index.lookup(&key, rids), (size_t) duplicates + 1)
+		checkPassFail(index.containsKey(&key), true)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void test15()
+{
+	// Delete nine keys in ten, so leaves underflow and are merged or refilled and the tree gets lower, then put
+	// them back, which must reuse the freed pages before the file grows, and finally delete everything
+	std::cout << "--------------------" << std::endl;
+	std::cout << "deleteEntry" << std::endl;
+	createRelationRandom();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD);
+		std::vector<RecordId> keyRids(relationSize);
+		for (int key = 0; key < relationSize; key++)
+		{
+			std::vector<RecordId> rids;
+			index.lookup(&key, rids);
+			keyRids[key] = rids[0];
+		}
+
+		int deleted = 0;
+		for (int key = 0; key < relationSize; key++)
+			if (key % 10 != 0 && index.deleteEntry(&key, keyRids[key]))
+				deleted++;
+		checkPassFail(deleted, relationSize - relationSize / 10)
+		IndexStatistics stats = index.getStatistics();
+		checkPassFail(stats.entries, (size_t) relationSize / 10)
+		bool freed = stats.freePages > 0;
+		checkPassFail(freed, true)
+		checkPassFail(batchScan(&index,25,GT,40,LT), 1)
+		checkPassFail(batchScan(&index,0,GTE,relationSize,LT), relationSize / 10)
+
+		// a missing key, and a present key with another record id, delete nothing
+		int key = 1;
+		checkPassFail(index.deleteEntry(&key, keyRids[1]), false)
+		key = 10;
+		checkPassFail(index.deleteEntry(&key, keyRids[11]), false)
+		checkPassFail(index.containsKey(&key), true)
+
+		for (key = 0; key < relationSize; key++)
+			if (key % 10 != 0)
+				index.insertEntry(&key, keyRids[key]);
+		stats = index.getStatistics();
+		checkPassFail(stats.entries, (size_t) relationSize)
+		checkPassFail(stats.freePages, (size_t) 0)
+		checkPassFail(batchScan(&index,0,GTE,relationSize,LT), relationSize)
+
+		for (key = relationSize - 1; key >= 0; key--)
+			index.deleteEntry(&key, keyRids[key]);
+		stats = index.getStatistics();
+		checkPassFail(stats.entries, (size_t) 0)
+		checkPassFail(stats.height, 1)
+		key = 0;
+		checkPassFail(index.containsKey(&key), false)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void test16()
+{
+	// The usual integer scans in DESCENDING order on indexes built both ways, then a run of duplicates long enough
+	// that the scan has to step back over several leaves holding nothing but the same key
+	std::cout << "--------------------" << std::endl;
+	std::cout << "descendingScan" << std::endl;
+	createRelationRandom();
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, (BuildMode) mode);
+			checkPassFail(descendingScan(&index,25,GT,40,LT), 14)
+			checkPassFail(descendingScan(&index,20,GTE,35,LTE), 16)
+			checkPassFail(descendingScan(&index,-3,GT,3,LT), 3)
+			checkPassFail(descendingScan(&index,996,GT,1001,LT), 4)
+			checkPassFail(descendingScan(&index,0,GT,1,LT), 0)
+			checkPassFail(descendingScan(&index,300,GT,400,LT), 99)
+			checkPassFail(descendingScan(&index,3000,GTE,4000,LT), 1000)
+			checkPassFail(descendingScan(&index,0,GTE,relationSize,LT), relationSize)
+
+			// the first entry of a descending scan is the last key of the range
+			int low = 0;
+			int high = relationSize;
+			RecordId scanRid;
+			Page *curPage;
+			index.startScan(&low, GTE, &high, LT, DESCENDING);
+			index.scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+			checkPassFail(myRec.i, relationSize - 1)
+			index.endScan();
+
+			const int duplicates = 2000;
+			std::vector<int> keys(duplicates, 30);
+			std::vector<RecordId> dupRids(duplicates, scanRid);
+			index.insertEntries(&keys[0], &dupRids[0], duplicates);
+			checkPassFail(descendingScan(&index,29,GTE,31,LTE), duplicates + 3)
+			checkPassFail(descendingScan(&index,30,GT,40,LT), 9)
+			checkPassFail(descendingScan(&index,20,GT,30,LT), 9)
+		}
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test17()
+{
+	// Scans with a limit, one entry at a time and in batches, in both orders, then minKey() and maxKey() as keys
+	// past either end come and go, and on an empty index
+	std::cout << "--------------------" << std::endl;
+	std::cout << "limit, minKey, maxKey" << std::endl;
+	createRelationRandom();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD);
+		int low = 100;
+		int high = 4000;
+		int count = 0;
+		RecordId rid;
+		index.startScan(&low, GTE, &high, LT, ASCENDING, 10);
+		try
+		{
+			while (true)
+			{
+				index.scanNext(rid);
+				count++;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+		}
+		index.endScan();
+		checkPassFail(count, 10)
+
+		const size_t batchSize = 64;
+		RecordId rids[batchSize];
+		int keys[batchSize];
+		index.startScan(&low, GTE, &high, LT, DESCENDING, 100);
+		size_t got = index.scanNextBatch(rids, keys, batchSize);
+		checkPassFail(got, batchSize)
+		checkPassFail(keys[0], high - 1)
+		got = index.scanNextBatch(rids, keys, batchSize);
+		checkPassFail(got, (size_t) 100 - batchSize)
+		checkPassFail(keys[got - 1], high - 100)
+		checkPassFail(index.scanNextBatch(rids, keys, batchSize), (size_t) 0)
+		index.endScan();
+
+		// a limit larger than the range changes nothing
+		high = low + 5;
+		index.startScan(&low, GTE, &high, LT, ASCENDING, 1000);
+		checkPassFail(index.scanNextBatch(rids, keys, batchSize), (size_t) 5)
+		index.endScan();
+
+		int key;
+		checkPassFail(index.minKey(&key, &rid), true)
+		checkPassFail(key, 0)
+		checkPassFail(index.maxKey(&key), true)
+		checkPassFail(key, relationSize - 1)
+
+		int past[2] = { -7, 3 * relationSize };
+		for (int i = 0; i < 2; i++)
+			index.insertEntry(&past[i], rid);
+		checkPassFail(index.minKey(&key), true)
+		checkPassFail(key, past[0])
+		checkPassFail(index.maxKey(&key), true)
+		checkPassFail(key, past[1])
+		for (int i = 0; i < 2; i++)
+			index.deleteEntry(&past[i], rid);
+		checkPassFail(index.minKey(&key), true)
+		checkPassFail(key, 0)
+
+		std::vector<RecordId> keyRids;
+		for (key = 0; key < relationSize; key++)
+		{
+			keyRids.clear();
+			index.lookup(&key, keyRids);
+			index.deleteEntry(&key, keyRids[0]);
+		}
+		key = 42;
+		checkPassFail(index.maxKey(&key), false)
+		checkPassFail(key, 42)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void test18()
+{
+	// countRange() against the expected sizes of the usual integer ranges on indexes built both ways, then again
+	// once a long run of duplicates has been added and most keys deleted, which splits and merges nodes
+	std::cout << "--------------------" << std::endl;
+	std::cout << "countRange" << std::endl;
+	createRelationRandom();
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, (BuildMode) mode);
+			int low = 25;
+			int high = 40;
+			checkPassFail(index.countRange(&low, GT, &high, LT), (size_t) 14)
+			low = 20;
+			high = 35;
+			checkPassFail(index.countRange(&low, GTE, &high, LTE), (size_t) 16)
+			low = -3;
+			high = 3;
+			checkPassFail(index.countRange(&low, GT, &high, LT), (size_t) 3)
+			low = 996;
+			high = 1001;
+			checkPassFail(index.countRange(&low, GT, &high, LT), (size_t) 4)
+			low = 0;
+			high = 1;
+			checkPassFail(index.countRange(&low, GT, &high, LT), (size_t) 0)
+			low = 3000;
+			high = 4000;
+			checkPassFail(index.countRange(&low, GTE, &high, LT), (size_t) 1000)
+			low = 0;
+			high = relationSize;
+			checkPassFail(index.countRange(&low, GTE, &high, LT), (size_t) relationSize)
+
+			const int duplicates = 2000;
+			std::vector<int> keys(duplicates, 30);
+			std::vector<RecordId> dupRids;
+			index.lookup(&keys[0], dupRids);
+			dupRids.resize(duplicates, dupRids[0]);
+			index.insertEntries(&keys[0], &dupRids[0], duplicates);
+			low = 29;
+			high = 31;
+			checkPassFail(index.countRange(&low, GTE, &high, LTE), (size_t) duplicates + 3)
+			checkPassFail(index.countRange(&keys[0], GTE, &keys[0], LTE), (size_t) duplicates + 1)
+			checkPassFail(index.countRange(&keys[0], GT, &high, LTE), (size_t) 1)
+
+			std::vector<RecordId> keyRids;
+			for (int key = 1000; key < relationSize; key++)
+			{
+				keyRids.clear();
+				index.lookup(&key, keyRids);
+				index.deleteEntry(&key, keyRids[0]);
+			}
+			low = 0;
+			high = relationSize;
+			checkPassFail(index.countRange(&low, GTE, &high, LT), (size_t) 1000 + duplicates)
+			low = 900;
+			checkPassFail(index.countRange(&low, GTE, &high, LT), (size_t) 100)
+			checkPassFail(index.countRange(&low, GTE, &high, LT), (size_t) batchScan(&index,900,GTE,relationSize,LT))
+		}
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test19()
+{
+	// Inserts past the last key into an index whose buffer pool has only the frames a descent pins left, until a
+	// split runs out of frames half way and throws. The index has to stay usable once frames are free again: later
+	// inserts must not wait for the split that failed, and every entry that went in is scanned
+	std::cout << "--------------------" << std::endl;
+	std::cout << "split out of buffer frames" << std::endl;
+	createRelationForward();
+	BufMgr *smallMgr = new BufMgr(20);
+	const std::string scratchName = "relA.scratch";
+	{
+		BTreeIndex index(relationName, intIndexName, smallMgr, offsetof(tuple,i), INTEGER);
+
+		// pin pages of another file until the pool is full, then free the two frames the root and a leaf take
+		PageFile *scratch = new PageFile(scratchName, true);
+		std::vector<PageId> pinned;
+		try
+		{
+			while (true)
+			{
+				PageId pageNo;
+				Page *page;
+				smallMgr->allocPage(scratch, pageNo, page);
+				pinned.push_back(pageNo);
+			}
+		}
+		catch(const BufferExceededException &e)
+		{
+		}
+		for (int i = 0; i < 2; i++)
+		{
+			smallMgr->unPinPage(scratch, pinned.back(), true);
+			pinned.pop_back();
+		}
+
+		RecordId rid;
+		rid.page_number = 1;
+		rid.slot_number = 1;
+		int added = 0;
+		bool thrown = false;
+		for (int key = relationSize; key < 2 * relationSize && !thrown; key++)
+		{
+			try
+			{
+				index.insertEntry(&key, rid);
+				added++;
+			}
+			catch(const BufferExceededException &e)
+			{
+				thrown = true;
+			}
+		}
+		checkPassFail(thrown, true)
+
+		for (size_t i = 0; i < pinned.size(); i++)
+			smallMgr->unPinPage(scratch, pinned[i], true);
+		smallMgr->flushFile(scratch);
+		delete scratch;
+		File::remove(scratchName);
+
+		for (int key = 2 * relationSize; key < 3 * relationSize; key++)
+			index.insertEntry(&key, rid);
+		checkPassFail(intScan(&index,0,GTE,3 * relationSize,LT), 2 * relationSize + added)
+		checkPassFail(index.getStatistics().entries, (size_t) 2 * relationSize + added)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	// the split that failed still pins the pages it had read, of a file that is closed now, so the pool is left as
+	// it is rather than flushed
+	deleteRelation();
+}
+
+void test20()
+{
+	// Multi-range scans through scanNext and scanNextBatch on indexes built both ways: an IN-list with a repeated
+	// key and one missing key, unsorted overlapping ranges, a limit, and ranges where nothing matches
+	std::cout << "--------------------" << std::endl;
+	std::cout << "multiScan" << std::endl;
+	createRelationRandom();
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, (BuildMode) mode);
+			for (int batched = 0; batched <= 1; batched++)
+			{
+				int inList[] = { 4999, 17, 3000, 5, 3001, 17, 6000 };
+				checkPassFail(multiScan(&index, inList, GTE, inList, LTE, 7, batched), 5)
+				checkPassFail(multiScan(&index, inList, GTE, inList, LTE, 7, batched, 3), 3)
+				int lows[] = { 300, 25, 3000, 310 };
+				int highs[] = { 400, 40, 4000, 320 };
+				checkPassFail(multiScan(&index, lows, GT, highs, LT, 4, batched), 14 + 99 + 999)
+				checkPassFail(multiScan(&index, lows, GTE, highs, LTE, 4, batched), 16 + 101 + 1001)
+				int missing[] = { -10, 5000, 6000 };
+				checkPassFail(multiScan(&index, missing, GTE, missing, LTE, 3, batched), 0)
+			}
+
+			int everyTenth[relationSize / 10];
+			for (int i = 0; i < relationSize / 10; i++)
+				everyTenth[i] = relationSize - 10 * (i + 1);
+			checkPassFail(multiScan(&index, everyTenth, GTE, everyTenth, LTE, relationSize / 10, true), relationSize / 10)
+		}
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test21()
+{
+	// parallelScan() against a single scan of the same range on indexes built both ways, with more threads than a
+	// short range has leaves, and once more after a run of duplicates long enough to span leaves has been added
+	std::cout << "--------------------" << std::endl;
+	std::cout << "parallelScan" << std::endl;
+	createRelationRandom();
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, (BuildMode) mode);
+			checkPassFail(parallelScanCheck(&index,25,GT,40,LT,4), 14)
+			checkPassFail(parallelScanCheck(&index,0,GTE,relationSize,LT,4), relationSize)
+			checkPassFail(parallelScanCheck(&index,0,GTE,relationSize,LT,16), relationSize)
+			checkPassFail(parallelScanCheck(&index,1000,GT,4000,LTE,3), 3000)
+			checkPassFail(parallelScanCheck(&index,6000,GT,7000,LT,4), 0)
+
+			const int duplicates = 3000;
+			std::vector<int> keys(duplicates, 2500);
+			std::vector<RecordId> dupRids;
+			index.lookup(&keys[0], dupRids);
+			dupRids.resize(duplicates, dupRids[0]);
+			index.insertEntries(&keys[0], &dupRids[0], duplicates);
+			checkPassFail(parallelScanCheck(&index,0,GTE,relationSize,LT,8), relationSize + duplicates)
+			checkPassFail(parallelScanCheck(&index,2500,GTE,2500,LTE,8), duplicates + 1)
+		}
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test22()
+{
+	// RecordFetch on the records of range scans, keeping the record ids and with so few kept that it falls back to
+	// the bitmap of their pages
+	std::cout << "--------------------" << std::endl;
+	std::cout << "RecordFetch" << std::endl;
+	createRelationRandom();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		for (int lossy = 0; lossy <= 1; lossy++)
+		{
+			size_t maxRids = lossy ? 10 : DEFAULT_FETCH_MAX_RIDS;
+			checkPassFail(fetchCheck(&index,25,GT,40,LT,maxRids), 14)
+			checkPassFail(fetchCheck(&index,1000,GT,4000,LTE,maxRids), 3000)
+			checkPassFail(fetchCheck(&index,0,GTE,relationSize,LT,maxRids), relationSize)
+			checkPassFail(fetchCheck(&index,6000,GT,7000,LT,maxRids), 0)
+		}
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void test23()
+{
+	// Index-only scans of indexes built both ways that INCLUDE RECORD.d and the start of RECORD.s, after inserts that
+	// split leaves and deletes that merge them, in both orders. The file is only opened again with the same columns
+	std::cout << "--------------------" << std::endl;
+	std::cout << "covering index" << std::endl;
+	createRelationRandom();
+	std::vector<IncludeColumn> includes(2);
+	includes[0].byteOffset = offsetof(tuple,d);
+	includes[0].size = sizeof(double);
+	includes[1].byteOffset = offsetof(tuple,s);
+	includes[1].size = 8;
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, (BuildMode) mode,
+					DEFAULT_FILL_FACTOR, DEFAULT_APPEND_SPLIT_RATIO, includes);
+			checkPassFail(index.getIncludeSize(), 16)
+			checkPassFail(coveringScan(&index,25,GT,40,LT,ASCENDING), 14)
+			checkPassFail(coveringScan(&index,0,GTE,relationSize,LT,ASCENDING), relationSize)
+			checkPassFail(coveringScan(&index,1000,GT,4000,LTE,DESCENDING), 3000)
+
+			// entries without INCLUDE bytes are refused
+			std::vector<RecordId> keyRids;
+			for (int key = 0; key < relationSize; key++)
+				index.lookup(&key, keyRids);
+			bool refused = false;
+			try
+			{
+				index.insertEntry(&relationSize, keyRids[0]);
+			}
+			catch(const BadIndexInfoException &e)
+			{
+				refused = true;
+			}
+			checkPassFail(refused, true)
+
+			// new keys one at a time and as a batch, taking their INCLUDE bytes from records made for them
+			const int added = 2000;
+			std::vector<int> batchKeys(added);
+			std::vector<char> batchIncludes(added * index.getIncludeSize());
+			for (int i = 0; i < 2 * added; i++)
+			{
+				int key = relationSize + i;
+				sprintf(record1.s, "%05d string record", key);
+				record1.i = key;
+				record1.d = key;
+				if (i < added)
+				{
+					char include[MAX_INCLUDE_SIZE];
+					index.loadIncludes((const char *) &record1, include);
+					index.insertEntry(&key, keyRids[i], include);
+				}
+				else
+				{
+					batchKeys[i - added] = key;
+					index.loadIncludes((const char *) &record1, &batchIncludes[(i - added) * index.getIncludeSize()]);
+				}
+			}
+			index.insertEntries(&batchKeys[0], &keyRids[0], added, &batchIncludes[0]);
+			checkPassFail(coveringScan(&index,0,GTE,relationSize + 2 * added,LT,ASCENDING), relationSize + 2 * added)
+
+			for (int key = 0; key < relationSize; key++)
+				if (key % 10 != 0)
+					index.deleteEntry(&key, keyRids[key]);
+			checkPassFail(coveringScan(&index,0,GTE,relationSize + 2 * added,LT,ASCENDING), relationSize / 10 + 2 * added)
+			checkPassFail(coveringScan(&index,0,GTE,relationSize + 2 * added,LT,DESCENDING), relationSize / 10 + 2 * added)
+		}
+
+		bool mismatch = false;
+		try
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			mismatch = true;
+		}
+		checkPassFail(mismatch, true)
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test24()
+{
+	// A relation with a thousand records for each of five keys, indexed both ways, so that its entries are kept in
+	// posting lists which every scan, lookup and count has to expand; then more entries for one key, one at a time and
+	// as a batch, and deletes of all of them, before the file is opened again
+	std::cout << "--------------------" << std::endl;
+	std::cout << "posting lists" << std::endl;
+	const int distinct = 5;
+	const int perKey = relationSize / distinct;
+	createRelationRandom(distinct);
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, (BuildMode) mode);
+			IndexStatistics stats = index.getStatistics();
+			checkPassFail(stats.entries, (size_t) relationSize)
+			checkPassFail((stats.postingPages > 0), true)
+			checkPassFail(intScan(&index,1,GTE,3,LTE), 3 * perKey)
+			checkPassFail(batchScan(&index,0,GT,distinct,LT), (distinct - 1) * perKey)
+			checkPassFail(descendingScan(&index,0,GTE,3,LT), 3 * perKey)
+			checkPassFail(parallelScanCheck(&index,0,GTE,distinct,LT,4), relationSize)
+			const int low = 1, high = 3;
+			checkPassFail(index.countRange(&low, GTE, &high, LTE), (size_t) 3 * perKey)
+
+			// each record of the key once
+			int key = 2;
+			std::vector<RecordId> keyRids;
+			checkPassFail(index.lookup(&key, keyRids), (size_t) perKey)
+			std::set<std::pair<PageId, SlotId> > unique;
+			for (size_t i = 0; i < keyRids.size(); i++)
+				unique.insert(std::make_pair(keyRids[i].page_number, keyRids[i].slot_number));
+			checkPassFail(unique.size(), (size_t) perKey)
+			int edgeKey;
+			RecordId edgeRid;
+			index.maxKey(&edgeKey, &edgeRid);
+			checkPassFail((edgeKey == distinct - 1 && edgeRid.slot_number != Page::INVALID_SLOT), true)
+
+			// the key's record ids twice more, one at a time and as a batch
+			std::vector<int> batchKeys(perKey, key);
+			for (int i = 0; i < perKey; i++)
+				index.insertEntry(&key, keyRids[i]);
+			index.insertEntries(&batchKeys[0], &keyRids[0], perKey);
+			std::vector<RecordId> allRids;
+			checkPassFail(index.lookup(&key, allRids), (size_t) 3 * perKey)
+			checkPassFail(batchScan(&index,key,GTE,key,LTE), 3 * perKey)
+			checkPassFail(descendingScan(&index,0,GTE,distinct,LT), relationSize + 2 * perKey)
+			checkPassFail(index.countRange(&key, GTE, &key, LTE), (size_t) 3 * perKey)
+
+			// deleted until none are left: each rid three times, and not a fourth
+			int deleted = 0;
+			for (int round = 0; round < 4; round++)
+				for (int i = 0; i < perKey; i++)
+					deleted += index.deleteEntry(&key, keyRids[i]) ? 1 : 0;
+			checkPassFail(deleted, 3 * perKey)
+			allRids.clear();
+			checkPassFail(index.lookup(&key, allRids), (size_t) 0)
+			checkPassFail(batchScan(&index,0,GTE,distinct,LT), relationSize - perKey)
+			checkPassFail(index.getStatistics().entries, (size_t) (relationSize - perKey))
+		}
+
+		// the posting lists are kept in the file
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail(descendingScan(&index,0,GTE,distinct,LT), relationSize - perKey)
+			checkPassFail(intScan(&index,3,GTE,3,LTE), perKey)
+		}
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test25()
+{
+	// Packed leaves, built both ways, then keys far below and above the leaves' bases and record ids on pages too far
+	// apart to pack, one at a time and as a batch, and deletes that rebalance leaves, before the file is opened again
+	std::cout << "--------------------" << std::endl;
+	std::cout << "packed leaves" << std::endl;
+	createRelationRandom();
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		std::vector<RecordId> keyRids;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, (BuildMode) mode,
+					DEFAULT_FILL_FACTOR, DEFAULT_APPEND_SPLIT_RATIO, std::vector<IncludeColumn>(), PACKED_LEAVES);
+			IndexStatistics stats = index.getStatistics();
+			checkPassFail(stats.entries, (size_t) relationSize)
+			checkPassFail((stats.packedLeafPages > 0), true)
+			checkPassFail((stats.leafPages < (size_t) (relationSize + INTARRAYLEAFSIZE - 1) / INTARRAYLEAFSIZE), true)
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(batchScan(&index,0,GTE,relationSize,LT), relationSize)
+			checkPassFail(descendingScan(&index,1000,GT,4000,LTE), 3000)
+			checkPassFail(parallelScanCheck(&index,0,GTE,relationSize,LT,4), relationSize)
+			const int low = 20, high = 35;
+			checkPassFail(index.countRange(&low, GTE, &high, LTE), (size_t) 16)
+
+			for (int key = 0; key < relationSize; key++)
+				index.lookup(&key, keyRids);
+			checkPassFail(keyRids.size(), (size_t) relationSize)
+			int edgeKey;
+			RecordId edgeRid;
+			index.maxKey(&edgeKey, &edgeRid);
+			checkPassFail((edgeKey == relationSize - 1 && edgeRid.page_number == keyRids.back().page_number
+					&& edgeRid.slot_number == keyRids.back().slot_number), true)
+
+			// keys spaced further apart than a packed leaf reaches, below the first key one at a time and past the
+			// last as a batch, with record ids on pages as far apart
+			const int added = 1000;
+			const int spacing = 100;
+			std::vector<int> batchKeys(added);
+			std::vector<RecordId> farRids(added);
+			for (int i = 0; i < added; i++)
+			{
+				int key = -spacing * (i + 1);
+				farRids[i] = keyRids[i];
+				farRids[i].page_number += (i % 2) * 100000;
+				index.insertEntry(&key, farRids[i]);
+				batchKeys[i] = relationSize + spacing * i;
+			}
+			index.insertEntries(&batchKeys[0], &farRids[0], added);
+			const int lowest = -spacing * added;
+			const int highest = relationSize + spacing * added;
+			checkPassFail(batchScan(&index,lowest,GTE,highest,LT), relationSize + 2 * added)
+			checkPassFail(descendingScan(&index,lowest,GTE,highest,LT), relationSize + 2 * added)
+			checkPassFail(index.getStatistics().entries, (size_t) relationSize + 2 * added)
+			int farKey = -spacing;
+			std::vector<RecordId> farFound;
+			index.lookup(&farKey, farFound);
+			checkPassFail((farFound.size() == 1 && farFound[0].page_number == farRids[0].page_number
+					&& farFound[0].slot_number == farRids[0].slot_number), true)
+			farKey = relationSize + spacing;
+			farFound.clear();
+			index.lookup(&farKey, farFound);
+			checkPassFail((farFound.size() == 1 && farFound[0].page_number == farRids[1].page_number), true)
+
+			for (int key = 0; key < relationSize; key++)
+				if (key % 10 != 0)
+					index.deleteEntry(&key, keyRids[key]);
+			for (int i = 0; i < added; i += 2)
+				index.deleteEntry(&batchKeys[i], farRids[i]);
+			checkPassFail(batchScan(&index,lowest,GTE,highest,LT), relationSize / 10 + added + added / 2)
+			checkPassFail(descendingScan(&index,0,GTE,relationSize,LT), relationSize / 10)
+			checkPassFail(index.getStatistics().entries, (size_t) relationSize / 10 + added + added / 2)
+		}
+
+		// the format is kept in the file
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail((index.getStatistics().packedLeafPages > 0), true)
+			checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize / 10)
+			int key = 0;
+			checkPassFail(index.deleteEntry(&key, keyRids[0]), true)
+			checkPassFail(descendingScan(&index,0,GTE,relationSize,LT), relationSize / 10 - 1)
+		}
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+
+	// only INTEGER and STRING keys pack
+	bool refused = false;
+	try
+	{
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, BULK_LOAD,
+				DEFAULT_FILL_FACTOR, DEFAULT_APPEND_SPLIT_RATIO, std::vector<IncludeColumn>(), PACKED_LEAVES);
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		refused = true;
+	}
+	checkPassFail(refused, true)
+	deleteRelation();
+}
+
+void test26()
+{
+	// A COMPOSITE index on (i, d) of a relation with ten values of i, built both ways: prefix scans of i, ranges of d
+	// within one i, full-key lookups, then keys with negative values of both columns, one at a time and as a batch,
+	// which have to sort below the others and in order among themselves, and deletes, before the file is opened again
+	std::cout << "--------------------" << std::endl;
+	std::cout << "composite keys" << std::endl;
+	const int distinct = 10;
+	createRelationRandom(distinct);
+	std::vector<KeyColumn> columns;
+	columns.push_back(KeyColumn{(int) offsetof(tuple,i), INTEGER});
+	columns.push_back(KeyColumn{(int) offsetof(tuple,d), DOUBLE});
+	std::string compositeIndexName;
+	const double ds[] = { -1e300, -2.5, -1e-300, 0.0, 1e-300, 2.5, 1e300 };
+	const int added = sizeof(ds) / sizeof(ds[0]);
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		std::vector<RecordId> addedRids;
+		{
+			BTreeIndex index(relationName, compositeIndexName, bufMgr, columns, (BuildMode) mode);
+			checkPassFail(index.getStatistics().entries, (size_t) relationSize)
+			int i = 3;
+			double d = 1233;
+			const void *values[] = { &i, &d };
+			checkPassFail(prefixScan(&index, values, 1, ASCENDING), relationSize / distinct)
+			checkPassFail(prefixScan(&index, values, 1, DESCENDING), relationSize / distinct)
+
+			// d from 1233 up within i = 3, and the one entry of (3, 1233)
+			CompositeKey low, high;
+			index.makeKey(values, 2, &low);
+			index.makeKey(values, 1, &high, true);
+			index.startScan(&low, GTE, &high, LTE);
+			int found = 0;
+			try
+			{
+				while (true)
+				{
+					index.scanNext(rid);
+					found++;
+				}
+			}
+			catch(const IndexScanCompletedException &e)
+			{
+			}
+			index.endScan();
+			checkPassFail(found, 377)
+			std::vector<RecordId> keyRids;
+			checkPassFail(index.lookup(&low, keyRids), (size_t) 1)
+			checkPassFail(prefixScan(&index, values, 2, ASCENDING), 1)
+			d = 1234;
+			checkPassFail(index.containsKey(&low), true)
+			index.makeKey(values, 2, &low);
+			checkPassFail(index.containsKey(&low), false)
+
+			// negative values of both columns, -0.0 as 0.0, given out of order: the scan of i = -1 returns them in the
+			// order of d, which the slot numbers of their record ids count from 1
+			const int insertOrder[] = { 3, 6, 0, 5, 1 };
+			i = -1;
+			for (int k = 0; k < 5; k++)
+			{
+				RecordId r = keyRids[0];
+				r.slot_number = insertOrder[k] + 1;
+				d = ds[insertOrder[k]];
+				CompositeKey key;
+				index.makeKey(values, 2, &key);
+				index.insertEntry(&key, r);
+			}
+			CompositeKey batch[2];
+			RecordId batchRids[2] = { keyRids[0], keyRids[0] };
+			const int batchOrder[] = { 4, 2 };
+			for (int k = 0; k < 2; k++)
+			{
+				d = ds[batchOrder[k]];
+				index.makeKey(values, 2, &batch[k]);
+				batchRids[k].slot_number = batchOrder[k] + 1;
+			}
+			index.insertEntries(batch, batchRids, 2);
+			checkPassFail(prefixScan(&index, values, 1, ASCENDING, &addedRids), added)
+			bool inOrder = addedRids.size() == (size_t) added;
+			for (size_t k = 0; inOrder && k < addedRids.size(); k++)
+				inOrder = addedRids[k].slot_number == (SlotId) k + 1;
+			checkPassFail(inOrder, true)
+			d = -0.0;
+			index.makeKey(values, 2, &low);
+			checkPassFail(index.containsKey(&low), true)
+
+			// every key of i = -1 sorts below those of i = 0
+			index.makeKey(values, 1, &low);
+			i = 0;
+			index.makeKey(values, 1, &high, true);
+			checkPassFail(index.countRange(&low, GTE, &high, LTE), (size_t) (added + relationSize / distinct))
+
+			i = -1;
+			d = 2.5;
+			index.makeKey(values, 2, &low);
+			checkPassFail(index.deleteEntry(&low, addedRids[5]), true)
+			checkPassFail(prefixScan(&index, values, 1, DESCENDING), added - 1)
+			checkPassFail(index.getStatistics().entries, (size_t) relationSize + added - 1)
+		}
+
+		// the key columns are kept in the file, and have to match
+		{
+			BTreeIndex index(relationName, compositeIndexName, bufMgr, columns);
+			int i = -1;
+			const void *values[] = { &i };
+			checkPassFail(prefixScan(&index, values, 1, ASCENDING), added - 1)
+			i = 9;
+			checkPassFail(prefixScan(&index, values, 1, ASCENDING), relationSize / distinct)
+		}
+		bool refused = false;
+		try
+		{
+			std::vector<KeyColumn> other(columns);
+			other[1].type = INTEGER;
+			BTreeIndex index(relationName, compositeIndexName, bufMgr, other);
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+		try
+		{
+			File::remove(compositeIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+
+	// a STRING column first: the prefix of one record's string
+	{
+		std::vector<KeyColumn> stringColumns;
+		stringColumns.push_back(KeyColumn{(int) offsetof(tuple,s), STRING});
+		stringColumns.push_back(KeyColumn{(int) offsetof(tuple,i), INTEGER});
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, stringColumns);
+		const char *s = "00042 string record";
+		int i = 42 % distinct;
+		const void *values[] = { s, &i };
+		checkPassFail(prefixScan(&index, values, 1, ASCENDING), 1)
+		checkPassFail(prefixScan(&index, values, 2, DESCENDING), 1)
+		bool refused = false;
+		try
+		{
+			index.startPrefixScan(values, 3);
+		}
+		catch(const BadScanParamException &e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+	}
+	try
+	{
+		File::remove(compositeIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+
+	// keys wider than a CompositeKey
+	bool refused = false;
+	try
+	{
+		std::vector<KeyColumn> wide;
+		wide.push_back(KeyColumn{(int) offsetof(tuple,s), STRING});
+		wide.push_back(KeyColumn{(int) offsetof(tuple,s) + STRINGSIZE, STRING});
+		wide.push_back(KeyColumn{(int) offsetof(tuple,d), DOUBLE});
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, wide);
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		refused = true;
+	}
+	checkPassFail(refused, true)
+	deleteRelation();
+}
+
+void test27()
+{
+	// Keys that compare differently as integers or bytes than a careless normalization would have them: doubles of
+	// both signs and -0.0, which the node search compares as integers, and strings with bytes above 0x7f and ones
+	// that only differ past the first eight characters, which are compared a word at a time
+	std::cout << "--------------------" << std::endl;
+	std::cout << "normalized keys" << std::endl;
+	createRelationForward();
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		{
+			BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, (BuildMode) mode);
+			const double added[] = { 1e300, -2.5, -0.0, -1e300, -1e-300, 2.25 };
+			const int numAdded = sizeof(added) / sizeof(added[0]);
+			RecordId addedRid;
+			addedRid.page_number = 1;
+			for (int i = 0; i < numAdded; i++)
+			{
+				addedRid.slot_number = i + 1;
+				index.insertEntry(&added[i], addedRid);
+			}
+
+			const size_t batchSize = 5;
+			RecordId rids[batchSize];
+			double keys[batchSize];
+			double low = -1e301, high = 1e301, last = low;
+			index.startScan(&low, GTE, &high, LTE);
+			int found = 0;
+			bool ordered = true;
+			size_t count;
+			do
+			{
+				count = index.scanNextBatch(rids, keys, batchSize);
+				for (size_t i = 0; i < count; i++)
+				{
+					ordered = ordered && !(keys[i] < last);
+					last = keys[i];
+				}
+				found += count;
+			} while (count == batchSize);
+			index.endScan();
+			checkPassFail(found, relationSize + numAdded)
+			checkPassFail(ordered, true)
+
+			// -0.0 is 0.0, which the relation has too
+			double zero = -0.0;
+			std::vector<RecordId> zeroRids;
+			checkPassFail(index.lookup(&zero, zeroRids), (size_t) 2)
+			checkPassFail(doubleScan(&index,-0.0,GTE,0.0,LTE), 2)
+			checkPassFail(doubleScan(&index,-3,GT,-1e-301,LT), 2)
+			checkPassFail(doubleScan(&index,2,GT,3,LTE), 2)
+			double edge;
+			index.minKey(&edge);
+			checkPassFail((edge == -1e300), true)
+			index.maxKey(&edge);
+			checkPassFail((edge == 1e300), true)
+		}
+		try
+		{
+			File::remove(doubleIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+
+		{
+			BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, (BuildMode) mode);
+			const char *added[] = { "\xe9t\xe9", "00042 strj", "", "00042 stri\xff" };
+			RecordId addedRid;
+			addedRid.page_number = 1;
+			for (int i = 0; i < 4; i++)
+			{
+				addedRid.slot_number = i + 1;
+				StringKey key;
+				key.set(added[i]);
+				index.insertEntry(key.data, addedRid);
+			}
+			StringKey edge;
+			index.maxKey(&edge);
+			checkPassFail((memcmp(edge.data, "\xe9t\xe9", 4) == 0), true)
+			index.minKey(&edge);
+			checkPassFail((edge.data[0] == 0), true)
+			// "00042 stri" twice, the record's and the one cut at STRINGSIZE characters, then "00042 strj"
+			checkPassFail(stringScan(&index,42,GTE,43,LT), 3)
+			std::vector<RecordId> keyRids;
+			checkPassFail(index.lookup("00042 strj", keyRids), (size_t) 1)
+			checkPassFail(index.lookup("00042 stri", keyRids), (size_t) 2)
+		}
+		try
+		{
+			File::remove(stringIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test28()
+{
+	// Packed STRING leaves, built both ways and against plain ones, then keys that share less of the prefix of the leaf
+	// they go to, or none of it, and a run of one key longer than a plain leaf holds, which packs with the whole key as
+	// its prefix, and deletes that rebalance leaves, before the file is opened again
+	std::cout << "--------------------" << std::endl;
+	std::cout << "prefix truncated string leaves" << std::endl;
 	createRelationRandom();
-	indexTests();
+	const char *added[] = { "", "/", "0", "00", "0000", "00499~", "02", "1", "\x7f" };
+	const int numAdded = sizeof(added) / sizeof(added[0]);
+	const int runLength = 1000;
+	for (int mode = INSERT_BUILD; mode <= BULK_LOAD; mode++)
+	{
+		size_t plainLeaves;
+		{
+			BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, (BuildMode) mode);
+			plainLeaves = index.getStatistics().leafPages;
+		}
+		File::remove(stringIndexName);
+
+		std::vector<RecordId> keyRids;
+		std::vector<RecordId> runRids(runLength);
+		{
+			BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, (BuildMode) mode,
+					DEFAULT_FILL_FACTOR, DEFAULT_APPEND_SPLIT_RATIO, std::vector<IncludeColumn>(), PACKED_LEAVES);
+			IndexStatistics stats = index.getStatistics();
+			checkPassFail(stats.entries, (size_t) relationSize)
+			checkPassFail((stats.packedLeafPages > 0), true)
+			// bulk loading fills each leaf up to what it holds packed, which is more than a plain leaf holds
+			checkPassFail((mode == BULK_LOAD ? stats.leafPages < plainLeaves : stats.leafPages <= plainLeaves), true)
+			checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+			checkPassFail(stringScan(&index,0,GTE,relationSize,LT), relationSize)
+			for (int key = 0; key < relationSize; key++)
+			{
+				char s[64];
+				sprintf(s, "%05d string record", key);
+				index.lookup(s, keyRids);
+			}
+			checkPassFail(keyRids.size(), (size_t) relationSize)
+
+			RecordId addedRid;
+			addedRid.page_number = 1;
+			for (int i = 0; i < numAdded; i++)
+			{
+				addedRid.slot_number = i + 1;
+				StringKey key;
+				key.set(added[i]);
+				index.insertEntry(key.data, addedRid);
+			}
+			std::vector<StringKey> runKeys(runLength);
+			for (int i = 0; i < runLength; i++)
+			{
+				runKeys[i].set("zzzzzzzzzz");
+				runRids[i].page_number = 2;
+				runRids[i].slot_number = i + 1;
+			}
+			index.insertEntries(&runKeys[0], &runRids[0], runLength);
+
+			checkPassFail(index.getStatistics().entries, (size_t) relationSize + numAdded + runLength)
+			checkPassFail(stringScan(&index,0,GTE,relationSize,LT), relationSize + 2)
+			std::vector<RecordId> found;
+			for (int i = 0; i < numAdded; i++)
+			{
+				StringKey key;
+				key.set(added[i]);
+				found.clear();
+				checkPassFail((index.lookup(key.data, found) == 1 && found[0].slot_number == i + 1), true)
+			}
+			found.clear();
+			checkPassFail(index.lookup(runKeys[0].data, found), (size_t) runLength)
+			StringKey edge;
+			index.maxKey(&edge);
+			checkPassFail((edge.data[0] == '\x7f'), true)
+			index.minKey(&edge);
+			checkPassFail((edge.data[0] == 0), true)
+
+			for (int key = 0; key < relationSize; key++)
+				if (key % 10 != 0)
+				{
+					char s[64];
+					sprintf(s, "%05d string record", key);
+					index.deleteEntry(s, keyRids[key]);
+				}
+			for (int i = 0; i < runLength; i += 2)
+				index.deleteEntry(runKeys[i].data, runRids[i]);
+			checkPassFail(stringScan(&index,0,GTE,relationSize,LT), relationSize / 10 + 2)
+			checkPassFail(index.getStatistics().entries, (size_t) relationSize / 10 + numAdded + runLength / 2)
+			found.clear();
+			checkPassFail(index.lookup(runKeys[0].data, found), (size_t) runLength / 2)
+		}
+
+		// the format is kept in the file
+		{
+			BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+			checkPassFail((index.getStatistics().packedLeafPages > 0), true)
+			checkPassFail(stringScan(&index,0,GTE,relationSize,LT), relationSize / 10 + 2)
+			checkPassFail(index.deleteEntry("00000 stri", keyRids[0]), true)
+			checkPassFail(stringScan(&index,0,GTE,relationSize,LT), relationSize / 10 + 1)
+		}
+		try
+		{
+			File::remove(stringIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
+
+void test29()
+{
+	// An index over a relation whose name is longer than the meta page keeps, which only keeps its start, is opened
+	// again
+	std::cout << "--------------------" << std::endl;
+	std::cout << "long relation name" << std::endl;
+	const std::string longName = "relA.with.a.long.relation.name";
+	const int numRecords = 50;
+	std::string longIndexName;
+	{
+		PageFile longFile = PageFile::create(longName);
+		PageId pageNo;
+		Page page = longFile.allocatePage(pageNo);
+		for (int i = 0; i < numRecords; i++)
+		{
+			sprintf(record1.s, "%05d string record", i);
+			record1.i = i;
+			record1.d = (double) i;
+			page.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+		}
+		longFile.writePage(pageNo, page);
+	}
+	{
+		BTreeIndex index(longName, longIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getStatistics().entries, (size_t) numRecords)
+	}
+	bool reopened = true;
+	try
+	{
+		BTreeIndex index(longName, longIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		int key = numRecords / 2;
+		std::vector<RecordId> keyRids;
+		checkPassFail(index.lookup(&key, keyRids), (size_t) 1)
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		reopened = false;
+	}
+	checkPassFail(reopened, true)
+	File::remove(longIndexName);
+	File::remove(longName);
+}
+
+void test30()
+{
+	// Several threads look keys up in an index many times bigger than its buffer pool, so most descents read pages
+	// from disk and evict others while the remaining threads pin and unpin theirs. Threads go round in pairs that
+	// start at the same key, so one of a pair often wants a page the other is still reading in
+	std::cout << "--------------------" << std::endl;
+	std::cout << "concurrent lookups through a small buffer pool" << std::endl;
+	createRelationForward();
+	BufMgr *smallMgr = new BufMgr(40);
+	const int numKeys = 20 * relationSize;
+	{
+		BTreeIndex index(relationName, intIndexName, smallMgr, offsetof(tuple,i), INTEGER);
+		RecordId rid;
+		rid.page_number = 1;
+		rid.slot_number = 1;
+		for (int key = relationSize; key < numKeys; key++)
+			index.insertEntry(&key, rid);
+
+		const int readers = 4;
+		std::atomic<int> found(0);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < readers; t++)
+		{
+			threads.push_back(std::thread([&, t]() {
+				const int start = (t / 2) * (numKeys / 2);
+				for (int j = 0; j < numKeys; j++)
+				{
+					int key = (start + j) % numKeys;
+					if (index.containsKey(&key))
+						found++;
+				}
+			}));
+		}
+		for (size_t t = 0; t < threads.size(); t++)
+			threads[t].join();
+		checkPassFail(found, readers * numKeys)
+		checkPassFail(intScan(&index,0,GTE,numKeys,LT), numKeys)
+	}
+	delete smallMgr;
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
 	deleteRelation();
 }
 
@@ -279,7 +2342,7 @@ void createRelationBackward()
 // createRelationRandom
 // -----------------------------------------------------------------------------
 
-void createRelationRandom()
+void createRelationRandom(const int distinct)
 {
   // destroy any old copies of relation file
 	try
@@ -312,7 +2375,7 @@ void createRelationRandom()
     pos = random() % (relationSize-i);
     val = intvec[pos];
     sprintf(record1.s, "%05d string record", val);
-    record1.i = val;
+    record1.i = val % distinct;
     record1.d = val;
 
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
@@ -347,9 +2410,13 @@ void createRelationRandom()
 void indexTests()
 {
   intTests();
+  doubleTests();
+  stringTests();
 	try
 	{
 		File::remove(intIndexName);
+		File::remove(doubleIndexName);
+		File::remove(stringIndexName);
 	}
   catch(const FileNotFoundException &e)
   {
@@ -360,10 +2427,10 @@ void indexTests()
 // intTests
 // -----------------------------------------------------------------------------
 
-void intTests()
+void intTests(const BuildMode buildMode, const double fillFactor)
 {
   std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, buildMode, fillFactor);
 
 	// run some tests
 	checkPassFail(intScan(&index,25,GT,40,LT), 14)
@@ -434,6 +2501,168 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 	return numResults;
 }
 
+// -----------------------------------------------------------------------------
+// doubleTests
+// -----------------------------------------------------------------------------
+
+void doubleTests(const BuildMode buildMode)
+{
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, buildMode);
+
+	// run some tests
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
+	checkPassFail(doubleScan(&index,300,GT,400,LT), 99)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+}
+
+int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( numResults < 5 )
+			{
+				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void stringTests(const BuildMode buildMode)
+{
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, buildMode);
+
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+}
+
+int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  // string keys are the first STRINGSIZE characters of the formatted record
+  char lowValStr[100];
+  sprintf(lowValStr,"%05d string record",lowVal);
+  char highValStr[100];
+  sprintf(highValStr,"%05d string record",highVal);
+
+  int numResults = 0;
+
+	try
+	{
+  	index->startScan(lowValStr, lowOp, highValStr, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( numResults < 5 )
+			{
+				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+	return numResults;
+}
+
 // -----------------------------------------------------------------------------
 // errorTests
 // -----------------------------------------------------------------------------
@@ -0,0 +1,610 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "node_search.h"
+#include "key_normalize.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NODE_SEARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace badgerdb
+{
+
+/**
+ * Binary search stops narrowing once the remaining range is this small, and the vector kernels
+ * compare every key left in it: one AVX2 compare or two SSE2 compares replace the last three
+ * dependent binary search steps.
+ */
+static const int SIMD_WINDOW = 8;
+
+static_assert(sizeof(RecordId) == 8, "the vector kernels decode record ids as a page number and a slot word");
+
+/**
+ * Packed leaf deltas are narrowed down to a window of this many, which one AVX2 compare or two SSE2 compares of
+ * 16-bit lanes cover.
+ */
+static const int SIMD_WINDOW_U16 = 16;
+
+/**
+ * True if k sorts before the position being searched for: k < key for a lower bound, k <= key for an upper bound.
+ */
+template <class K, bool UPPER>
+static inline bool before(const K k, const K key)
+{
+	return UPPER ? k <= key : k < key;
+}
+
+/**
+ * Narrows [keys, keys + count] down to a range of at most window keys that still contains the bound.
+ * The ternary compiles to a conditional move, so there is no branch to mispredict.
+ */
+template <class K, bool UPPER>
+static inline const K *narrow(const K *keys, int &len, const K key, const int window)
+{
+	const K *first = keys;
+	while (len > window)
+	{
+		int half = len / 2;
+		first = before<K, UPPER>(first[half], key) ? first + half : first;
+		len -= half;
+	}
+	return first;
+}
+
+template <class K, bool UPPER>
+static int linearBound(const K *keys, const int count, const K key)
+{
+	int i = 0;
+	while (i < count && before<K, UPPER>(keys[i], key))
+	{
+		i++;
+	}
+	return i;
+}
+
+template <class K, bool UPPER>
+static int binaryBound(const K *keys, const int count, const K key)
+{
+	int len = count;
+	const K *first = narrow<K, UPPER>(keys, len, key, 1);
+	return (int) (first - keys) + (len == 1 && before<K, UPPER>(first[0], key) ? 1 : 0);
+}
+
+#ifdef NODE_SEARCH_X86
+
+template <bool UPPER>
+__attribute__((target("sse2")))
+static int sse2Bound(const int *keys, const int count, const int key)
+{
+	int len = count;
+	const int *first = narrow<int, UPPER>(keys, len, key, SIMD_WINDOW);
+
+	const __m128i probe = _mm_set1_epi32(key);
+	int found = 0;
+	int i = 0;
+	for (; i + 4 <= len; i += 4)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *) (first + i));
+		if (UPPER)
+		{
+			__m128i greater = _mm_cmpgt_epi32(block, probe);
+			found += 4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(greater)));
+		}
+		else
+		{
+			__m128i less = _mm_cmplt_epi32(block, probe);
+			found += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
+		}
+	}
+	for (; i < len; i++)
+	{
+		found += before<int, UPPER>(first[i], key) ? 1 : 0;
+	}
+	return (int) (first - keys) + found;
+}
+
+template <bool UPPER>
+__attribute__((target("avx2")))
+static int avx2Bound(const int *keys, const int count, const int key)
+{
+	int len = count;
+	const int *first = narrow<int, UPPER>(keys, len, key, SIMD_WINDOW);
+
+	const __m256i probe = _mm256_set1_epi32(key);
+	int found = 0;
+	int i = 0;
+	for (; i + 8 <= len; i += 8)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i *) (first + i));
+		if (UPPER)
+		{
+			__m256i greater = _mm256_cmpgt_epi32(block, probe);
+			found += 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(greater)));
+		}
+		else
+		{
+			__m256i less = _mm256_cmpgt_epi32(probe, block);
+			found += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+		}
+	}
+	for (; i < len; i++)
+	{
+		found += before<int, UPPER>(first[i], key) ? 1 : 0;
+	}
+	return (int) (first - keys) + found;
+}
+
+/**
+ * The binary search narrows with double compares, which order the keys as their normalizeDoubleBits() integers do
+ * as long as none is -0.0. Every lane of the window is normalized before it is compared: its bits less the sign are
+ * flipped where the sign is set, which a signed compare with zero picks out, as AVX2 has no 64-bit arithmetic shift.
+ */
+template <bool UPPER>
+__attribute__((target("avx2")))
+static int avx2BoundDouble(const double *keys, const int count, const double key)
+{
+	int len = count;
+	const double *first = narrow<double, UPPER>(keys, len, key, SIMD_WINDOW);
+
+	std::int64_t bits;
+	memcpy(&bits, &key, sizeof(bits));
+	const __m256i probe = _mm256_set1_epi64x(normalizeDoubleBits(bits));
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i magnitude = _mm256_set1_epi64x(INT64_MAX);
+	int found = 0;
+	int i = 0;
+	for (; i + 4 <= len; i += 4)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i *) (first + i));
+		block = _mm256_xor_si256(block, _mm256_and_si256(_mm256_cmpgt_epi64(zero, block), magnitude));
+		if (UPPER)
+		{
+			__m256i greater = _mm256_cmpgt_epi64(block, probe);
+			found += 4 - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(greater)));
+		}
+		else
+		{
+			__m256i less = _mm256_cmpgt_epi64(probe, block);
+			found += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(less)));
+		}
+	}
+	for (; i < len; i++)
+	{
+		found += before<double, UPPER>(first[i], key) ? 1 : 0;
+	}
+	return (int) (first - keys) + found;
+}
+
+template <bool UPPER>
+__attribute__((target("sse2")))
+static int sse2BoundU16(const std::uint16_t *keys, const int count, const std::uint16_t key)
+{
+	int len = count;
+	const std::uint16_t *first = narrow<std::uint16_t, UPPER>(keys, len, key, SIMD_WINDOW_U16);
+
+	/// SSE2 only compares signed 16-bit lanes, so the top bit of both sides is flipped to keep the unsigned order
+	const __m128i flip = _mm_set1_epi16((short) 0x8000);
+	const __m128i probe = _mm_xor_si128(_mm_set1_epi16((short) key), flip);
+	int found = 0;
+	int i = 0;
+	for (; i + 8 <= len; i += 8)
+	{
+		__m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (first + i)), flip);
+		/// the byte mask has two bits for every 16-bit lane
+		if (UPPER)
+		{
+			__m128i greater = _mm_cmpgt_epi16(block, probe);
+			found += 8 - __builtin_popcount(_mm_movemask_epi8(greater)) / 2;
+		}
+		else
+		{
+			__m128i less = _mm_cmplt_epi16(block, probe);
+			found += __builtin_popcount(_mm_movemask_epi8(less)) / 2;
+		}
+	}
+	for (; i < len; i++)
+	{
+		found += before<std::uint16_t, UPPER>(first[i], key) ? 1 : 0;
+	}
+	return (int) (first - keys) + found;
+}
+
+template <bool UPPER>
+__attribute__((target("avx2")))
+static int avx2BoundU16(const std::uint16_t *keys, const int count, const std::uint16_t key)
+{
+	int len = count;
+	const std::uint16_t *first = narrow<std::uint16_t, UPPER>(keys, len, key, SIMD_WINDOW_U16);
+
+	const __m256i flip = _mm256_set1_epi16((short) 0x8000);
+	const __m256i probe = _mm256_xor_si256(_mm256_set1_epi16((short) key), flip);
+	int found = 0;
+	int i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		__m256i block = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (first + i)), flip);
+		if (UPPER)
+		{
+			__m256i greater = _mm256_cmpgt_epi16(block, probe);
+			found += 16 - __builtin_popcount(_mm256_movemask_epi8(greater)) / 2;
+		}
+		else
+		{
+			__m256i less = _mm256_cmpgt_epi16(probe, block);
+			found += __builtin_popcount(_mm256_movemask_epi8(less)) / 2;
+		}
+	}
+	for (; i < len; i++)
+	{
+		found += before<std::uint16_t, UPPER>(first[i], key) ? 1 : 0;
+	}
+	return (int) (first - keys) + found;
+}
+
+/**
+ * Widens eight deltas at a time to 32 bits by interleaving them with zeros, and adds the base.
+ */
+__attribute__((target("sse2")))
+static void sse2DecodeDeltas(const std::uint16_t *deltas, const int count, const int base, int *out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i offset = _mm_set1_epi32(base);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *) (deltas + i));
+		_mm_storeu_si128((__m128i *) (out + i), _mm_add_epi32(_mm_unpacklo_epi16(block, zero), offset));
+		_mm_storeu_si128((__m128i *) (out + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(block, zero), offset));
+	}
+	for (; i < count; i++)
+	{
+		out[i] = (int) ((unsigned) base + deltas[i]);
+	}
+}
+
+__attribute__((target("avx2")))
+static void avx2DecodeDeltas(const std::uint16_t *deltas, const int count, const int base, int *out)
+{
+	const __m256i offset = _mm256_set1_epi32(base);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i block = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (deltas + i)));
+		_mm256_storeu_si256((__m256i *) (out + i), _mm256_add_epi32(block, offset));
+	}
+	for (; i < count; i++)
+	{
+		out[i] = (int) ((unsigned) base + deltas[i]);
+	}
+}
+
+/**
+ * A RecordId is its page number followed by its slot number and zero padding, so interleaving 32-bit page numbers
+ * with zero-extended slot numbers lays out whole record ids.
+ */
+__attribute__((target("sse2")))
+static void sse2DecodeRids(const std::uint16_t *pageDeltas, const std::uint16_t *slots, const int count,
+		const PageId pageBase, RecordId *out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i offset = _mm_set1_epi32((int) pageBase);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i pages = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (pageDeltas + i)), zero);
+		pages = _mm_add_epi32(pages, offset);
+		__m128i slotWords = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (slots + i)), zero);
+		_mm_storeu_si128((__m128i *) (out + i), _mm_unpacklo_epi32(pages, slotWords));
+		_mm_storeu_si128((__m128i *) (out + i + 2), _mm_unpackhi_epi32(pages, slotWords));
+	}
+	for (; i < count; i++)
+	{
+		out[i].page_number = pageBase + pageDeltas[i];
+		out[i].slot_number = slots[i];
+		out[i].padding = 0;
+	}
+}
+
+/**
+ * The 256-bit unpacks work within each 128-bit half, so the two halves are put back in order after them.
+ */
+__attribute__((target("avx2")))
+static void avx2DecodeRids(const std::uint16_t *pageDeltas, const std::uint16_t *slots, const int count,
+		const PageId pageBase, RecordId *out)
+{
+	const __m256i offset = _mm256_set1_epi32((int) pageBase);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i pages = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (pageDeltas + i)));
+		pages = _mm256_add_epi32(pages, offset);
+		__m256i slotWords = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (slots + i)));
+		__m256i low = _mm256_unpacklo_epi32(pages, slotWords);
+		__m256i high = _mm256_unpackhi_epi32(pages, slotWords);
+		_mm256_storeu_si256((__m256i *) (out + i), _mm256_permute2x128_si256(low, high, 0x20));
+		_mm256_storeu_si256((__m256i *) (out + i + 4), _mm256_permute2x128_si256(low, high, 0x31));
+	}
+	for (; i < count; i++)
+	{
+		out[i].page_number = pageBase + pageDeltas[i];
+		out[i].slot_number = slots[i];
+		out[i].padding = 0;
+	}
+}
+
+#endif
+
+static void scalarDecodeDeltas(const std::uint16_t *deltas, const int count, const int base, int *out)
+{
+	for (int i = 0; i < count; i++)
+	{
+		out[i] = (int) ((unsigned) base + deltas[i]);
+	}
+}
+
+static void scalarDecodeRids(const std::uint16_t *pageDeltas, const std::uint16_t *slots, const int count,
+		const PageId pageBase, RecordId *out)
+{
+	for (int i = 0; i < count; i++)
+	{
+		out[i].page_number = pageBase + pageDeltas[i];
+		out[i].slot_number = slots[i];
+		out[i].padding = 0;
+	}
+}
+
+typedef int (*BoundFunction)(const int *, const int, const int);
+typedef int (*BoundDoubleFunction)(const double *, const int, const double);
+typedef int (*BoundU16Function)(const std::uint16_t *, const int, const std::uint16_t);
+typedef void (*DecodeDeltasFunction)(const std::uint16_t *, const int, const int, int *);
+typedef void (*DecodeRidsFunction)(const std::uint16_t *, const std::uint16_t *, const int, const PageId, RecordId *);
+
+/**
+ * Returns the implementation of the given kernel, falling back to the binary search if the
+ * kernel is not available on this platform.
+ */
+template <bool UPPER>
+static BoundFunction boundFunction(const SearchKernel kernel)
+{
+	switch (kernel)
+	{
+		case SEARCH_LINEAR:
+			return linearBound<int, UPPER>;
+#ifdef NODE_SEARCH_X86
+		case SEARCH_SSE2:
+			return sse2Bound<UPPER>;
+		case SEARCH_AVX2:
+			return avx2Bound<UPPER>;
+#endif
+		default:
+			return binaryBound<int, UPPER>;
+	}
+}
+
+template <bool UPPER>
+static BoundDoubleFunction boundDoubleFunction(const SearchKernel kernel)
+{
+	switch (kernel)
+	{
+		case SEARCH_LINEAR:
+			return linearBound<double, UPPER>;
+#ifdef NODE_SEARCH_X86
+		case SEARCH_AVX2:
+			return avx2BoundDouble<UPPER>;
+#endif
+		default:
+			return binaryBound<double, UPPER>;
+	}
+}
+
+template <bool UPPER>
+static BoundU16Function boundU16Function(const SearchKernel kernel)
+{
+	switch (kernel)
+	{
+		case SEARCH_LINEAR:
+			return linearBound<std::uint16_t, UPPER>;
+#ifdef NODE_SEARCH_X86
+		case SEARCH_SSE2:
+			return sse2BoundU16<UPPER>;
+		case SEARCH_AVX2:
+			return avx2BoundU16<UPPER>;
+#endif
+		default:
+			return binaryBound<std::uint16_t, UPPER>;
+	}
+}
+
+/**
+ * The linear and binary kernels have nothing to search when decoding, and decode one entry at a time.
+ */
+static DecodeDeltasFunction decodeDeltasFunction(const SearchKernel kernel)
+{
+	switch (kernel)
+	{
+#ifdef NODE_SEARCH_X86
+		case SEARCH_SSE2:
+			return sse2DecodeDeltas;
+		case SEARCH_AVX2:
+			return avx2DecodeDeltas;
+#endif
+		default:
+			return scalarDecodeDeltas;
+	}
+}
+
+static DecodeRidsFunction decodeRidsFunction(const SearchKernel kernel)
+{
+	switch (kernel)
+	{
+#ifdef NODE_SEARCH_X86
+		case SEARCH_SSE2:
+			return sse2DecodeRids;
+		case SEARCH_AVX2:
+			return avx2DecodeRids;
+#endif
+		default:
+			return scalarDecodeRids;
+	}
+}
+
+bool searchKernelSupported(const SearchKernel kernel)
+{
+	switch (kernel)
+	{
+		case SEARCH_LINEAR:
+		case SEARCH_BINARY:
+			return true;
+#ifdef NODE_SEARCH_X86
+		case SEARCH_SSE2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("sse2");
+		case SEARCH_AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return false;
+	}
+}
+
+/**
+ * Picks the widest kernel the CPU supports.
+ */
+static SearchKernel detectSearchKernel()
+{
+	if (searchKernelSupported(SEARCH_AVX2))
+		return SEARCH_AVX2;
+	if (searchKernelSupported(SEARCH_SSE2))
+		return SEARCH_SSE2;
+	return SEARCH_BINARY;
+}
+
+static const SearchKernel activeKernel = detectSearchKernel();
+static const BoundFunction activeLowerBound = boundFunction<false>(activeKernel);
+static const BoundFunction activeUpperBound = boundFunction<true>(activeKernel);
+static const BoundDoubleFunction activeLowerBoundDouble = boundDoubleFunction<false>(activeKernel);
+static const BoundDoubleFunction activeUpperBoundDouble = boundDoubleFunction<true>(activeKernel);
+static const BoundU16Function activeLowerBoundU16 = boundU16Function<false>(activeKernel);
+static const BoundU16Function activeUpperBoundU16 = boundU16Function<true>(activeKernel);
+static const DecodeDeltasFunction activeDecodeDeltas = decodeDeltasFunction(activeKernel);
+static const DecodeRidsFunction activeDecodeRids = decodeRidsFunction(activeKernel);
+
+int lowerBoundInt(const int *keys, const int count, const int key)
+{
+	return activeLowerBound(keys, count, key);
+}
+
+int upperBoundInt(const int *keys, const int count, const int key)
+{
+	return activeUpperBound(keys, count, key);
+}
+
+int lowerBoundInt(const int *keys, const int count, const int key, const SearchKernel kernel)
+{
+	return boundFunction<false>(kernel)(keys, count, key);
+}
+
+int upperBoundInt(const int *keys, const int count, const int key, const SearchKernel kernel)
+{
+	return boundFunction<true>(kernel)(keys, count, key);
+}
+
+/**
+ * A key of -0.0 is searched for as 0.0, which the keys of a node hold instead.
+ */
+static inline double canonical(const double key)
+{
+	return key == 0.0 ? 0.0 : key;
+}
+
+int lowerBoundDouble(const double *keys, const int count, const double key)
+{
+	return activeLowerBoundDouble(keys, count, canonical(key));
+}
+
+int upperBoundDouble(const double *keys, const int count, const double key)
+{
+	return activeUpperBoundDouble(keys, count, canonical(key));
+}
+
+int lowerBoundDouble(const double *keys, const int count, const double key, const SearchKernel kernel)
+{
+	return boundDoubleFunction<false>(kernel)(keys, count, canonical(key));
+}
+
+int upperBoundDouble(const double *keys, const int count, const double key, const SearchKernel kernel)
+{
+	return boundDoubleFunction<true>(kernel)(keys, count, canonical(key));
+}
+
+int lowerBoundU16(const std::uint16_t *deltas, const int count, const std::uint16_t key)
+{
+	return activeLowerBoundU16(deltas, count, key);
+}
+
+int upperBoundU16(const std::uint16_t *deltas, const int count, const std::uint16_t key)
+{
+	return activeUpperBoundU16(deltas, count, key);
+}
+
+int lowerBoundU16(const std::uint16_t *deltas, const int count, const std::uint16_t key, const SearchKernel kernel)
+{
+	return boundU16Function<false>(kernel)(deltas, count, key);
+}
+
+int upperBoundU16(const std::uint16_t *deltas, const int count, const std::uint16_t key, const SearchKernel kernel)
+{
+	return boundU16Function<true>(kernel)(deltas, count, key);
+}
+
+void decodeDeltas(const std::uint16_t *deltas, const int count, const int base, int *out)
+{
+	activeDecodeDeltas(deltas, count, base, out);
+}
+
+void decodeRids(const std::uint16_t *pageDeltas, const std::uint16_t *slots, const int count, const PageId pageBase,
+		RecordId *out)
+{
+	activeDecodeRids(pageDeltas, slots, count, pageBase, out);
+}
+
+void decodeDeltas(const std::uint16_t *deltas, const int count, const int base, int *out, const SearchKernel kernel)
+{
+	decodeDeltasFunction(kernel)(deltas, count, base, out);
+}
+
+void decodeRids(const std::uint16_t *pageDeltas, const std::uint16_t *slots, const int count, const PageId pageBase,
+		RecordId *out, const SearchKernel kernel)
+{
+	decodeRidsFunction(kernel)(pageDeltas, slots, count, pageBase, out);
+}
+
+SearchKernel activeSearchKernel()
+{
+	return activeKernel;
+}
+
+const char *searchKernelName(const SearchKernel kernel)
+{
+	switch (kernel)
+	{
+		case SEARCH_LINEAR:
+			return "linear";
+		case SEARCH_BINARY:
+			return "binary";
+		case SEARCH_SSE2:
+			return "sse2";
+		case SEARCH_AVX2:
+			return "avx2";
+	}
+	return "unknown";
+}
+
+}
@@ -0,0 +1,186 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "types.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Implementations of the key search inside a B+Tree node, and of the decoding of packed leaves.
+ */
+enum SearchKernel
+{
+	SEARCH_LINEAR,	/* plain scan over every key */
+	SEARCH_BINARY,	/* branch-free binary search */
+	SEARCH_SSE2,	/* binary search down to a small window, then 4-wide compares */
+	SEARCH_AVX2		/* binary search down to a small window, then 8-wide compares */
+};
+
+/**
+ * Position of the first key that is greater than or equal to key in the sorted array keys[0..count).
+ * Uses the fastest kernel supported by the CPU, chosen once at startup.
+ *
+ * @param keys		Sorted keys
+ * @param count		Number of keys in the array
+ * @param key		Key to search for
+ * @return Index in [0, count]
+ */
+int lowerBoundInt(const int *keys, const int count, const int key);
+
+/**
+ * Position of the first key that is strictly greater than key in the sorted array keys[0..count).
+ * Uses the fastest kernel supported by the CPU, chosen once at startup.
+ *
+ * @param keys		Sorted keys
+ * @param count		Number of keys in the array
+ * @param key		Key to search for
+ * @return Index in [0, count]
+ */
+int upperBoundInt(const int *keys, const int count, const int key);
+
+/**
+ * lowerBoundInt() using the given kernel, which must be supported by the CPU.
+ */
+int lowerBoundInt(const int *keys, const int count, const int key, const SearchKernel kernel);
+
+/**
+ * upperBoundInt() using the given kernel, which must be supported by the CPU.
+ */
+int upperBoundInt(const int *keys, const int count, const int key, const SearchKernel kernel);
+
+/**
+ * Position of the first key that is greater than or equal to key in the sorted array keys[0..count) of doubles,
+ * none of them -0.0. Uses the kernel of lowerBoundInt() widened to 64-bit lanes, whose vector compares take the
+ * doubles as the integers normalizeDoubleBits() maps them to; SSE2 has no 64-bit compare, so its kernel is the
+ * binary search.
+ */
+int lowerBoundDouble(const double *keys, const int count, const double key);
+
+/**
+ * Position of the first key that is strictly greater than key in the sorted array keys[0..count) of doubles.
+ */
+int upperBoundDouble(const double *keys, const int count, const double key);
+
+/**
+ * lowerBoundDouble() / upperBoundDouble() using the given kernel, which must be supported by the CPU.
+ */
+int lowerBoundDouble(const double *keys, const int count, const double key, const SearchKernel kernel);
+int upperBoundDouble(const double *keys, const int count, const double key, const SearchKernel kernel);
+
+/**
+ * Position of the first key that is greater than or equal to key in the sorted array keys[0..count), for any
+ * key type with operator<. A branch-free binary search; int and double keys use lowerBoundInt() and
+ * lowerBoundDouble() instead.
+ */
+template <class T>
+int lowerBound(const T *keys, const int count, const T &key)
+{
+	const T *first = keys;
+	int len = count;
+	while (len > 1)
+	{
+		int half = len / 2;
+		first = (first[half] < key) ? first + half : first;
+		len -= half;
+	}
+	return (int) (first - keys) + (len == 1 && first[0] < key ? 1 : 0);
+}
+
+/**
+ * Position of the first key that is strictly greater than key in the sorted array keys[0..count), for any
+ * key type with operator<. A branch-free binary search; int and double keys use upperBoundInt() and
+ * upperBoundDouble() instead.
+ */
+template <class T>
+int upperBound(const T *keys, const int count, const T &key)
+{
+	const T *first = keys;
+	int len = count;
+	while (len > 1)
+	{
+		int half = len / 2;
+		first = !(key < first[half]) ? first + half : first;
+		len -= half;
+	}
+	return (int) (first - keys) + (len == 1 && !(key < first[0]) ? 1 : 0);
+}
+
+inline int lowerBound(const int *keys, const int count, const int &key)
+{
+	return lowerBoundInt(keys, count, key);
+}
+
+inline int upperBound(const int *keys, const int count, const int &key)
+{
+	return upperBoundInt(keys, count, key);
+}
+
+inline int lowerBound(const double *keys, const int count, const double &key)
+{
+	return lowerBoundDouble(keys, count, key);
+}
+
+inline int upperBound(const double *keys, const int count, const double &key)
+{
+	return upperBoundDouble(keys, count, key);
+}
+
+/**
+ * Position of the first delta that is greater than or equal to key in the sorted array deltas[0..count) of 16-bit
+ * unsigned key deltas, as a packed leaf stores them. Uses the same kernel as lowerBoundInt().
+ */
+int lowerBoundU16(const std::uint16_t *deltas, const int count, const std::uint16_t key);
+
+/**
+ * Position of the first delta that is strictly greater than key in the sorted array deltas[0..count).
+ */
+int upperBoundU16(const std::uint16_t *deltas, const int count, const std::uint16_t key);
+
+/**
+ * lowerBoundU16() / upperBoundU16() using the given kernel, which must be supported by the CPU.
+ */
+int lowerBoundU16(const std::uint16_t *deltas, const int count, const std::uint16_t key, const SearchKernel kernel);
+int upperBoundU16(const std::uint16_t *deltas, const int count, const std::uint16_t key, const SearchKernel kernel);
+
+/**
+ * Decode count keys of a packed leaf: out[i] = base + deltas[i].
+ */
+void decodeDeltas(const std::uint16_t *deltas, const int count, const int base, int *out);
+
+/**
+ * Decode count record ids of a packed leaf: page base + pageDeltas[i] and slot slots[i], with zero padding.
+ */
+void decodeRids(const std::uint16_t *pageDeltas, const std::uint16_t *slots, const int count, const PageId pageBase,
+		RecordId *out);
+
+/**
+ * decodeDeltas() / decodeRids() using the given kernel, which must be supported by the CPU.
+ */
+void decodeDeltas(const std::uint16_t *deltas, const int count, const int base, int *out, const SearchKernel kernel);
+void decodeRids(const std::uint16_t *pageDeltas, const std::uint16_t *slots, const int count, const PageId pageBase,
+		RecordId *out, const SearchKernel kernel);
+
+/**
+ * Returns true if the CPU this process runs on can execute the given kernel.
+ */
+bool searchKernelSupported(const SearchKernel kernel);
+
+/**
+ * Returns the kernel used by lowerBoundInt() / upperBoundInt() and the other searches.
+ */
+SearchKernel activeSearchKernel();
+
+/**
+ * Returns a printable name for the given kernel.
+ */
+const char *searchKernelName(const SearchKernel kernel);
+
+}
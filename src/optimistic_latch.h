@@ -0,0 +1,110 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Optimistic lock coupling on a version word stored inside a page.
+ *
+ * Readers never write to the word: they remember its value before reading a node and check it is unchanged
+ * afterwards, restarting their operation if it moved. Writers set the locked bit with a compare and swap, and
+ * unlocking advances the version, which invalidates every read that overlapped the write. Bit 0 marks a node
+ * that has been taken out of the tree.
+ *
+ * All functions work on a plain std::uint64_t so the word can live in a struct cast from page memory.
+ */
+class OptimisticLatch
+{
+ public:
+	static const std::uint64_t OBSOLETE_BIT = 1;
+	static const std::uint64_t LOCKED_BIT = 2;
+
+	/**
+	 * Number of times a reader re-reads a locked word before giving up and restarting its operation.
+	 */
+	static const int SPIN_LIMIT = 64;
+
+	/**
+	 * Starts an optimistic read of the node guarded by word.
+	 *
+	 * @param word		Version word of the node
+	 * @param version	The version to validate against once the read is done is returned in this
+	 * @return False if the node is locked or obsolete and the operation has to restart
+	 */
+	static bool readLock(const std::uint64_t *word, std::uint64_t &version)
+	{
+		for (int spins = 0; ; spins++)
+		{
+			version = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+			if (!(version & LOCKED_BIT))
+				return !(version & OBSOLETE_BIT);
+			if (spins == SPIN_LIMIT)
+				return false;
+			std::this_thread::yield();
+		}
+	}
+
+	/**
+	 * Checks that nothing was written to the node since readLock() returned version, so that everything read
+	 * from it in between is consistent.
+	 */
+	static bool validate(const std::uint64_t *word, const std::uint64_t version)
+	{
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		return __atomic_load_n(word, __ATOMIC_RELAXED) == version;
+	}
+
+	/**
+	 * Turns an optimistic read into a write lock, provided nothing was written to the node since readLock().
+	 *
+	 * @return False if the node changed and the operation has to restart
+	 */
+	static bool upgradeToWriteLock(std::uint64_t *word, const std::uint64_t version)
+	{
+		std::uint64_t expected = version;
+		return __atomic_compare_exchange_n(word, &expected, version | LOCKED_BIT, false,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+	}
+
+	/**
+	 * Waits until the node is unlocked and locks it for writing.
+	 */
+	static void writeLock(std::uint64_t *word)
+	{
+		while (true)
+		{
+			std::uint64_t version = __atomic_load_n(word, __ATOMIC_RELAXED);
+			if (!(version & LOCKED_BIT) && upgradeToWriteLock(word, version))
+				return;
+			std::this_thread::yield();
+		}
+	}
+
+	/**
+	 * Releases a write lock. Adding the locked bit again carries it into the version counter.
+	 */
+	static void writeUnlock(std::uint64_t *word)
+	{
+		__atomic_fetch_add(word, LOCKED_BIT, __ATOMIC_RELEASE);
+	}
+
+	/**
+	 * Releases a write lock on a node that has been taken out of the tree, so every later readLock() fails.
+	 */
+	static void writeUnlockObsolete(std::uint64_t *word)
+	{
+		__atomic_fetch_add(word, LOCKED_BIT | OBSOLETE_BIT, __ATOMIC_RELEASE);
+	}
+};
+
+}
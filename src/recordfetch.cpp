@@ -0,0 +1,209 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "recordfetch.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
+
+namespace badgerdb {
+
+static bool pageOrder(const RecordId &a, const RecordId &b)
+{
+  return a.page_number < b.page_number || (a.page_number == b.page_number && a.slot_number < b.slot_number);
+}
+
+RecordFetch::RecordFetch(const std::string &name, BufMgr *bufferMgr, const size_t maxRidsParm)
+{
+  file = new PageFile(name, false);	//dont create new file
+	bufMgr = bufferMgr;
+  maxRids = maxRidsParm;
+  isLossy = false;
+  scanning = false;
+  next = 0;
+  curPage = NULL;
+  curPageNo = Page::INVALID_NUMBER;
+}
+
+RecordFetch::~RecordFetch()
+{
+  if (curPage != NULL)
+  {
+    bufMgr->unPinPage(file, curPageNo, false);
+    curPage = NULL;
+  }
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+void RecordFetch::add(const RecordId &rid)
+{
+  add(&rid, 1);
+}
+
+void RecordFetch::add(const RecordId *ridsParm, const size_t count)
+{
+  if (scanning)
+  {
+    throw BadScanParamException();
+  }
+
+  if (!isLossy)
+  {
+    rids.insert(rids.end(), ridsParm, ridsParm + count);
+    if (rids.size() > maxRids)
+    {
+      makeLossy();
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    PageId pageNo = ridsParm[i].page_number;
+    if (pageNo / 64 >= pageBits.size())
+    {
+      pageBits.resize(pageNo / 64 + 1, 0);
+    }
+    pageBits[pageNo / 64] |= (std::uint64_t) 1 << (pageNo % 64);
+  }
+}
+
+void RecordFetch::makeLossy()
+{
+  isLossy = true;
+  std::vector<RecordId> kept;
+  kept.swap(rids);
+  add(&kept[0], kept.size());
+}
+
+void RecordFetch::scanNext(RecordId& outRid)
+{
+  if (!scanning)
+  {
+    // the first call puts the ids in page order, with each id once
+    scanning = true;
+    next = 0;
+    if (!isLossy)
+    {
+      std::sort(rids.begin(), rids.end(), pageOrder);
+      rids.erase(std::unique(rids.begin(), rids.end(),
+          [](const RecordId &a, const RecordId &b) { return a.page_number == b.page_number && a.slot_number == b.slot_number; }),
+          rids.end());
+    }
+  }
+
+  if (isLossy)
+  {
+    if (!nextLossyRecord(outRid))
+    {
+      throw EndOfFileException();
+    }
+    curRid = outRid;
+    return;
+  }
+
+  if (next == rids.size())
+  {
+    if (curPage != NULL)
+    {
+      bufMgr->unPinPage(file, curPageNo, false);
+      curPage = NULL;
+    }
+    throw EndOfFileException();
+  }
+
+  // the page stays pinned for all of its ids, which follow each other
+  curRid = rids[next++];
+  if (curPage == NULL || curPageNo != curRid.page_number)
+  {
+    if (curPage != NULL)
+    {
+      bufMgr->unPinPage(file, curPageNo, false);
+    }
+    curPageNo = curRid.page_number;
+    bufMgr->readPage(file, curPageNo, curPage);
+  }
+  outRid = curRid;
+}
+
+bool RecordFetch::nextLossyRecord(RecordId &outRid)
+{
+  // every record on a marked page is returned, as the bitmap does not say which of them were added
+  if (curPage != NULL)
+  {
+    pageRecordIter++;
+    if (pageRecordIter != curPage->end())
+    {
+      outRid = pageRecordIter.getCurrentRecord();
+      return true;
+    }
+    bufMgr->unPinPage(file, curPageNo, false);
+    curPage = NULL;
+  }
+
+  while (next < pageBits.size() * 64)
+  {
+    PageId pageNo = next++;
+    if (pageBits[pageNo / 64] == 0)
+    {
+      // skip to the start of the next word
+      next = (pageNo / 64 + 1) * 64;
+      continue;
+    }
+    if (!(pageBits[pageNo / 64] & ((std::uint64_t) 1 << (pageNo % 64))))
+    {
+      continue;
+    }
+
+    curPageNo = pageNo;
+    bufMgr->readPage(file, curPageNo, curPage);
+    pageRecordIter = curPage->begin();
+    if (pageRecordIter != curPage->end())
+    {
+      outRid = pageRecordIter.getCurrentRecord();
+      return true;
+    }
+    bufMgr->unPinPage(file, curPageNo, false);
+    curPage = NULL;
+  }
+  return false;
+}
+
+std::string RecordFetch::getRecord()
+{
+  return isLossy ? *pageRecordIter : curPage->getRecord(curRid);
+}
+
+void RecordFetch::fetch(const RecordId *ridsParm, const size_t count, std::vector<std::string> &outRecords)
+{
+  // visit the ids in page order, and put each record where its id is
+  std::vector<size_t> order(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(),
+      [ridsParm](size_t a, size_t b) { return pageOrder(ridsParm[a], ridsParm[b]); });
+
+  size_t start = outRecords.size();
+  outRecords.resize(start + count);
+  size_t i = 0;
+  while (i < count)
+  {
+    PageId pageNo = ridsParm[order[i]].page_number;
+    Page *page;
+    bufMgr->readPage(file, pageNo, page);
+    for (; i < count && ridsParm[order[i]].page_number == pageNo; i++)
+    {
+      outRecords[start + order[i]] = page->getRecord(ridsParm[order[i]]);
+    }
+    bufMgr->unPinPage(file, pageNo, false);
+  }
+}
+
+}
@@ -0,0 +1,127 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "types.h"
+#include "page.h"
+#include "buffer.h"
+#include "page_iterator.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Record ids a RecordFetch keeps one by one before it falls back to a bitmap of their pages.
+ */
+const size_t DEFAULT_FETCH_MAX_RIDS = 1 << 20;
+
+/**
+ * @brief This class is used to fetch the records of a set of record ids, such as those an index scan returns, from
+ * their relation. An index returns record ids in key order, which visits the same relation page again for every
+ * record on it; RecordFetch reads the records in page order instead, so that each page is read and pinned once.
+ *
+ * Record ids are collected with add() and their records read back with scanNext() and getRecord(), in page order.
+ * Once more ids are added than the fetch keeps, it only remembers which pages they were on, in a bitmap with a bit
+ * per page, and scanNext() returns every record on those pages: lossy() then turns true, and the caller has to
+ * check each record against its scan's predicate again. fetch() reads the records of a batch of ids in the order of
+ * the ids instead, still reading each page once.
+ */
+class RecordFetch
+{
+ public:
+
+  RecordFetch(const std::string &name, BufMgr *bufMgr, const size_t maxRids = DEFAULT_FETCH_MAX_RIDS);
+
+  ~RecordFetch();
+
+  //add the record id of a record to fetch; ids may be added in any order, and more than once
+  void add(const RecordId &rid);
+
+  //add count record ids
+  void add(const RecordId *rids, const size_t count);
+
+  //return RecordId of next record to fetch, in page order; throws EndOfFileException after the last one
+  void scanNext(RecordId& outRid);
+
+  //read current record
+  std::string getRecord();
+
+  //true if the ids were replaced by a bitmap of their pages, so scanNext() returns every record on those pages
+  bool lossy() const { return isLossy; }
+
+  //append the records of count record ids to outRecords in the order of the ids, reading each page once
+  void fetch(const RecordId *rids, const size_t count, std::vector<std::string> &outRecords);
+
+ private:
+  /**
+   * Switch from keeping record ids to the bitmap of their pages.
+   */
+  void makeLossy();
+
+  /**
+   * Move to the next record of the current lossy page, or to the first record of the next page in the bitmap.
+   */
+  bool nextLossyRecord(RecordId &outRid);
+
+  /**
+   * Relation file the records are read from.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance used to read pages into the buffer pool.
+   */
+	BufMgr				*bufMgr;
+
+  /**
+   * Most record ids kept before switching to the page bitmap.
+   */
+  size_t        maxRids;
+
+  /**
+   * Record ids added, sorted by page and slot when scanNext() first runs.
+   */
+  std::vector<RecordId>  rids;
+
+  /**
+   * Bit p % 64 of word p / 64 is set if a record id on page p was added. Used once isLossy is true.
+   */
+  std::vector<std::uint64_t>  pageBits;
+
+  /**
+   * True once the record ids have been replaced by pageBits.
+   */
+  bool          isLossy;
+
+  /**
+   * True once scanNext() has started; no more ids may be added.
+   */
+  bool          scanning;
+
+  /**
+   * Index in rids of the next id to return, or page number whose bit scanNext() looks at next once lossy.
+   */
+  size_t        next;
+
+  /**
+   * Current page, pinned, and its page number; NULL before the first record and after the last.
+   */
+  Page*         curPage;
+  PageId        curPageNo;
+
+  /**
+   * Current record id, and the record on a lossy page it came from.
+   */
+  RecordId      curRid;
+  PageIterator  pageRecordIter;
+};
+
+}